@@ -0,0 +1,362 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file archive.c
+ * @brief Indexed archive of raw Bayer frames read through mmap, used in
+ * place of the emulated camera on the host.
+ */
+
+#include "archive.h"
+#include "recorder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+/*! @brief Size of a raw frame in bytes. */
+#define RAW_FRAME_SIZE (OSC_CAM_MAX_IMAGE_WIDTH*OSC_CAM_MAX_IMAGE_HEIGHT)
+
+/*! @brief The archive replayed instead of the camera. */
+static struct ARCHIVE source;
+/*! @brief Index of the next frame of source. */
+static uint32 nSourceFrame = 0;
+/*! @brief The replay clock; the frames are delivered with the spacing
+ * they were recorded with. */
+static struct
+{
+	/*! @brief Whether the first frame was delivered. */
+	bool bStarted;
+	/*! @brief When the next frame is due (monotonic micro seconds). */
+	uint64 nDue;
+	/*! @brief GPIO inputs recorded with the last frame delivered. */
+	uint8 gpioIn;
+} replay;
+
+/*********************************************************************//*!
+ * @brief The monotonic clock in micro seconds.
+ *//*********************************************************************/
+static uint64 ArchiveClock()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+/*********************************************************************//*!
+ * @brief Time from a frame to the next one as recorded.
+ *
+ * Frames without a capture time, the wrap of the archive and gaps
+ * between concatenated recordings are spaced by a frame period.
+ *//*********************************************************************/
+static uint32 ArchiveFrameSpacing(const struct ARC_INDEX_ENTRY *pEntry, const struct ARC_INDEX_ENTRY *pNext)
+{
+	const uint32 dt = pNext->nTimeMicroSecs - pEntry->nTimeMicroSecs;
+
+	if (pEntry->nTimeMicroSecs == 0 || pNext->nTimeMicroSecs == 0 || dt == 0 || dt > ARC_MAX_GAP_US)
+	{
+		return FRAME_PERIOD_US;
+	}
+	return dt;
+}
+
+OSC_ERR ArchiveOpen(struct ARCHIVE *pArc, const char *strFile)
+{
+	struct stat st;
+	uint32 n, frameSize;
+	int fd;
+
+	memset(pArc, 0, sizeof(struct ARCHIVE));
+	fd = open(strFile, O_RDONLY);
+	if (fd < 0)
+	{
+		OscLog(ERROR, "%s: Unable to open %s!\n", __func__, strFile);
+		return -EUNABLE_TO_OPEN_FILE;
+	}
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct ARC_HEADER))
+	{
+		close(fd);
+		OscLog(ERROR, "%s: %s is no archive!\n", __func__, strFile);
+		return -EFILE_PARSING_ERROR;
+	}
+	/* A private mapping keeps accidental writes to the frames out of the
+	 * file. */
+	pArc->size = st.st_size;
+	pArc->pMap = mmap(NULL, pArc->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (pArc->pMap == MAP_FAILED)
+	{
+		pArc->pMap = NULL;
+		OscLog(ERROR, "%s: Unable to map %s!\n", __func__, strFile);
+		return -EUNABLE_TO_OPEN_FILE;
+	}
+	madvise(pArc->pMap, pArc->size, MADV_SEQUENTIAL);
+
+	pArc->pHeader = (const struct ARC_HEADER*)pArc->pMap;
+	pArc->pIndex = (const struct ARC_INDEX_ENTRY*)(pArc->pMap + sizeof(struct ARC_HEADER));
+	frameSize = pArc->pHeader->width*pArc->pHeader->height;
+	if (pArc->pHeader->magic != ARC_MAGIC || pArc->pHeader->version != ARC_VERSION ||
+			pArc->pHeader->width != OSC_CAM_MAX_IMAGE_WIDTH || pArc->pHeader->height != OSC_CAM_MAX_IMAGE_HEIGHT ||
+			pArc->pHeader->nFrames == 0 ||
+			sizeof(struct ARC_HEADER) + (size_t)pArc->pHeader->nFrames*sizeof(struct ARC_INDEX_ENTRY) > pArc->size)
+	{
+		ArchiveClose(pArc);
+		OscLog(ERROR, "%s: %s is no archive of camera frames!\n", __func__, strFile);
+		return -EFILE_PARSING_ERROR;
+	}
+	for (n = 0; n < pArc->pHeader->nFrames; n++)
+	{
+		if ((size_t)pArc->pIndex[n].offset + frameSize > pArc->size)
+		{
+			ArchiveClose(pArc);
+			OscLog(ERROR, "%s: %s is truncated!\n", __func__, strFile);
+			return -EFILE_PARSING_ERROR;
+		}
+	}
+	return SUCCESS;
+}
+
+void ArchiveClose(struct ARCHIVE *pArc)
+{
+	if (pArc->pMap != NULL)
+	{
+		munmap(pArc->pMap, pArc->size);
+	}
+	memset(pArc, 0, sizeof(struct ARCHIVE));
+}
+
+uint8 *ArchiveFrame(const struct ARCHIVE *pArc, uint32 n, const struct ARC_INDEX_ENTRY **ppEntry)
+{
+	const struct ARC_INDEX_ENTRY *pEntry = &pArc->pIndex[n % pArc->pHeader->nFrames];
+
+	if (ppEntry != NULL)
+	{
+		*ppEntry = pEntry;
+	}
+	return pArc->pMap + pEntry->offset;
+}
+
+OSC_ERR ArchiveSetSource(const char *strFile)
+{
+#if !defined(OSC_HOST)
+	OscLog(ERROR, "%s: archives replace the camera only on the host!\n", __func__);
+	return -EINVALID_PARAMETER;
+#else
+	nSourceFrame = 0;
+	memset(&replay, 0, sizeof(replay));
+	return ArchiveOpen(&source, strFile);
+#endif
+}
+
+bool ArchiveIsSource()
+{
+	return source.pMap != NULL;
+}
+
+OSC_ERR ArchiveReadPicture(uint8 **ppRaw, const struct ARC_INDEX_ENTRY **ppEntry)
+{
+	const struct ARC_INDEX_ENTRY *pEntry, *pNext;
+	uint64 now = ArchiveClock();
+
+	if (!replay.bStarted)
+	{
+		replay.nDue = now;
+		replay.bStarted = TRUE;
+	}
+	if (now < replay.nDue)
+	{
+		/* Wait like the camera does, so the caller serves its requests in
+		 * the meantime. */
+		usleep(replay.nDue - now < ARC_POLL_US ? replay.nDue - now : ARC_POLL_US);
+		if (ArchiveClock() < replay.nDue)
+		{
+			return -ETIMEOUT;
+		}
+	}
+
+	*ppRaw = ArchiveFrame(&source, nSourceFrame, &pEntry);
+	ArchiveFrame(&source, ++nSourceFrame, &pNext);
+	/* The next frame is due relative to this one's due time, so a late
+	 * delivery does not stretch the replay. */
+	replay.nDue += ArchiveFrameSpacing(pEntry, pNext);
+	replay.gpioIn = pEntry->gpioIn;
+	if (ppEntry != NULL)
+	{
+		*ppEntry = pEntry;
+	}
+	return SUCCESS;
+}
+
+OSC_ERR ArchiveGpioRead(enum EnGpios gpio, bool *pbLevel)
+{
+	switch (gpio)
+	{
+	case GPIO_IN1:
+		*pbLevel = (replay.gpioIn & 1) != 0;
+		return SUCCESS;
+	case GPIO_IN2:
+		*pbLevel = (replay.gpioIn & 2) != 0;
+		return SUCCESS;
+	default:
+		return -EINVALID_PARAMETER;
+	}
+}
+
+/*********************************************************************//*!
+ * @brief Append a frame to an archive being written and fill in its
+ * index entry.
+ *//*********************************************************************/
+static OSC_ERR ArchiveAppend(FILE *pFile, struct ARC_INDEX_ENTRY *pEntry, uint32 *pOffset, const uint8 *pRaw)
+{
+	pEntry->offset = *pOffset;
+	if (fseek(pFile, *pOffset, SEEK_SET) != 0 || fwrite(pRaw, RAW_FRAME_SIZE, 1, pFile) != 1)
+	{
+		return -EFILE_ERROR;
+	}
+	*pOffset += RAW_FRAME_SIZE;
+	return SUCCESS;
+}
+
+/*********************************************************************//*!
+ * @brief Count the frames of an input file of the converter.
+ *
+ * @return Number of frames, 0 if the file is no black-box recording (a
+ * BMP file then).
+ *//*********************************************************************/
+static uint32 ArchiveCountRecording(const char *strIn)
+{
+	struct REC_FILE_HEADER header;
+	FILE *pIn = fopen(strIn, "rb");
+	uint32 nFrames = 0;
+
+	if (pIn == NULL)
+	{
+		return 0;
+	}
+	if (fread(&header, sizeof(header), 1, pIn) == 1 && header.magic == REC_MAGIC &&
+			header.width == OSC_CAM_MAX_IMAGE_WIDTH && header.height == OSC_CAM_MAX_IMAGE_HEIGHT)
+	{
+		nFrames = header.nFrames;
+	}
+	fclose(pIn);
+	return nFrames;
+}
+
+OSC_ERR ArchiveConvert(const char *strOut, int nIn, const char * const strIn[])
+{
+	struct ARC_HEADER header;
+	struct ARC_INDEX_ENTRY *pIndex;
+	struct REC_FRAME_HEADER recFrame;
+	struct OSC_PICTURE pic;
+	uint8 *pRaw;
+	FILE *pOut, *pIn;
+	uint32 nFrames = 0, nFrame = 0, offset, n;
+	int i;
+	OSC_ERR err = SUCCESS;
+
+	/* The index precedes the frames, so the frames are counted first. */
+	for (i = 0; i < nIn; i++)
+	{
+		n = ArchiveCountRecording(strIn[i]);
+		nFrames += n > 0 ? n : 1;
+	}
+
+	pIndex = (struct ARC_INDEX_ENTRY*)calloc(nFrames, sizeof(struct ARC_INDEX_ENTRY));
+	pRaw = (uint8*)malloc(RAW_FRAME_SIZE);
+	if (pIndex == NULL || pRaw == NULL)
+	{
+		free(pIndex);
+		free(pRaw);
+		return -EOUT_OF_MEMORY;
+	}
+	pOut = fopen(strOut, "wb");
+	if (pOut == NULL)
+	{
+		free(pIndex);
+		free(pRaw);
+		OscLog(ERROR, "%s: Unable to open %s!\n", __func__, strOut);
+		return -EUNABLE_TO_OPEN_FILE;
+	}
+
+	offset = sizeof(struct ARC_HEADER) + nFrames*sizeof(struct ARC_INDEX_ENTRY);
+	offset = (offset + ARC_FRAME_ALIGN - 1)/ARC_FRAME_ALIGN*ARC_FRAME_ALIGN;
+
+	for (i = 0; i < nIn && err == SUCCESS; i++)
+	{
+		n = ArchiveCountRecording(strIn[i]);
+		if (n == 0)
+		{
+			/* A BMP file holds one raw frame without a capture time; the
+			 * replay spaces such frames by a frame period. */
+			pic.width = OSC_CAM_MAX_IMAGE_WIDTH;
+			pic.height = OSC_CAM_MAX_IMAGE_HEIGHT;
+			pic.type = OSC_PICTURE_GREYSCALE;
+			pic.data = pRaw;
+			err = OscBmpRead(&pic, strIn[i]);
+			if (err != SUCCESS)
+			{
+				OscLog(ERROR, "%s: Unable to read %s!\n", __func__, strIn[i]);
+				break;
+			}
+			err = ArchiveAppend(pOut, &pIndex[nFrame++], &offset, pRaw);
+			continue;
+		}
+
+		/* A black-box recording keeps the metadata of its frames. */
+		pIn = fopen(strIn[i], "rb");
+		if (pIn == NULL || fseek(pIn, sizeof(struct REC_FILE_HEADER), SEEK_SET) != 0)
+		{
+			err = -EUNABLE_TO_OPEN_FILE;
+		}
+		for (; n > 0 && err == SUCCESS; n--)
+		{
+			if (fread(&recFrame, sizeof(recFrame), 1, pIn) != 1 || fread(pRaw, RAW_FRAME_SIZE, 1, pIn) != 1)
+			{
+				OscLog(ERROR, "%s: %s is truncated!\n", __func__, strIn[i]);
+				err = -EFILE_ERROR;
+				break;
+			}
+			pIndex[nFrame].nTimeMicroSecs = recFrame.nTimeMicroSecs;
+			pIndex[nFrame].nStepCounter = recFrame.nStepCounter;
+			pIndex[nFrame].nShutterWidth = recFrame.nShutterWidth;
+			pIndex[nFrame].gpioIn = recFrame.gpioIn;
+			err = ArchiveAppend(pOut, &pIndex[nFrame++], &offset, pRaw);
+		}
+		if (pIn != NULL)
+		{
+			fclose(pIn);
+		}
+	}
+
+	if (err == SUCCESS)
+	{
+		memset(&header, 0, sizeof(header));
+		header.magic = ARC_MAGIC;
+		header.version = ARC_VERSION;
+		header.width = OSC_CAM_MAX_IMAGE_WIDTH;
+		header.height = OSC_CAM_MAX_IMAGE_HEIGHT;
+		header.nFrames = nFrame;
+		if (fseek(pOut, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, pOut) != 1 ||
+				fwrite(pIndex, sizeof(struct ARC_INDEX_ENTRY), nFrames, pOut) != nFrames)
+		{
+			err = -EFILE_ERROR;
+		}
+	}
+	if (fclose(pOut) != 0 && err == SUCCESS)
+	{
+		err = -EFILE_ERROR;
+	}
+	if (err != SUCCESS)
+	{
+		OscLog(ERROR, "%s: Error writing %s!\n", __func__, strOut);
+	}
+	free(pIndex);
+	free(pRaw);
+	return err;
+}
@@ -0,0 +1,156 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file archive.h
+ * @brief Indexed archive of raw Bayer frames read through mmap, used in
+ * place of the emulated camera on the host.
+ *
+ * An archive consists of a struct ARC_HEADER, the index (one struct
+ * ARC_INDEX_ENTRY per frame) and the raw frames of width*height bytes
+ * each, starting at a page boundary. Replaying it costs no decoding and
+ * no copy: the frames are processed straight from the mapping.
+ */
+#ifndef ARCHIVE_H_
+#define ARCHIVE_H_
+
+#include "template.h"
+
+/*! @brief Identifies an archive. */
+#define ARC_MAGIC 0x43524146 /* "FARC" */
+/*! @brief Version of the archive layout. */
+#define ARC_VERSION 1
+/*! @brief Alignment of the first frame in the file. */
+#define ARC_FRAME_ALIGN 4096
+/*! @brief Longest gap between the capture times of two frames that is
+ * replayed; a longer one separates two recordings. */
+#define ARC_MAX_GAP_US 1000000
+/*! @brief Longest wait for the next frame of a replay before the caller
+ * gets the control back. */
+#define ARC_POLL_US 4000
+
+/*! @brief Header of an archive. */
+struct ARC_HEADER
+{
+	/*! @brief ARC_MAGIC. */
+	uint32 magic;
+	/*! @brief ARC_VERSION. */
+	uint16 version;
+	/*! @brief Reserved, zero. */
+	uint16 reserved;
+	/*! @brief Width of the raw frames. */
+	uint16 width;
+	/*! @brief Height of the raw frames. */
+	uint16 height;
+	/*! @brief Number of frames. */
+	uint32 nFrames;
+};
+
+/*! @brief Index entry of a frame. */
+struct ARC_INDEX_ENTRY
+{
+	/*! @brief Offset of the raw frame in the file. */
+	uint32 offset;
+	/*! @brief Time of the capture in micro seconds (wraps around); 0 if
+	 * unknown. */
+	uint32 nTimeMicroSecs;
+	/*! @brief Step counter of the frame; 0 if unknown. */
+	uint32 nStepCounter;
+	/*! @brief Shutter width in micro seconds; 0 if unknown. */
+	uint32 nShutterWidth;
+	/*! @brief State of the GPIO inputs, bit n for input n + 1. */
+	uint8 gpioIn;
+	/*! @brief Reserved, zero. */
+	uint8 reserved[3];
+};
+
+/*! @brief An archive opened for reading. */
+struct ARCHIVE
+{
+	/*! @brief The mapping of the whole file; NULL if not open. */
+	uint8 *pMap;
+	/*! @brief Size of the mapping. */
+	size_t size;
+	/*! @brief The header at the start of the mapping. */
+	const struct ARC_HEADER *pHeader;
+	/*! @brief The index following the header. */
+	const struct ARC_INDEX_ENTRY *pIndex;
+};
+
+/*********************************************************************//*!
+ * @brief Map an archive and check its header and index.
+ *
+ * @param pArc Receives the archive.
+ * @param strFile Name of the archive.
+ * @return SUCCESS, -EUNABLE_TO_OPEN_FILE or -EFILE_PARSING_ERROR.
+ *//*********************************************************************/
+OSC_ERR ArchiveOpen(struct ARCHIVE *pArc, const char *strFile);
+
+/*********************************************************************//*!
+ * @brief Unmap an archive.
+ *//*********************************************************************/
+void ArchiveClose(struct ARCHIVE *pArc);
+
+/*********************************************************************//*!
+ * @brief Get a frame of an archive.
+ *
+ * The frame is mapped copy-on-write, writing to it does not change the
+ * file.
+ *
+ * @param pArc The archive.
+ * @param n Index of the frame (modulo the number of frames).
+ * @param ppEntry Receives the index entry of the frame if not NULL.
+ * @return The raw frame.
+ *//*********************************************************************/
+uint8 *ArchiveFrame(const struct ARCHIVE *pArc, uint32 n, const struct ARC_INDEX_ENTRY **ppEntry);
+
+/*********************************************************************//*!
+ * @brief Replay an archive in a loop instead of capturing from the
+ * camera (host only); call before StateControl().
+ *
+ * @param strFile Name of the archive.
+ * @return SUCCESS or an appropriate error code.
+ *//*********************************************************************/
+OSC_ERR ArchiveSetSource(const char *strFile);
+
+/*********************************************************************//*!
+ * @brief Whether the frames are taken from an archive.
+ *//*********************************************************************/
+bool ArchiveIsSource();
+
+/*********************************************************************//*!
+ * @brief Get the next frame of the archive set as source; takes the
+ * place of OscCamReadPicture().
+ *
+ * The frames are paced by their recorded capture times (c.f.
+ * ARC_MAX_GAP_US); a frame is delivered when it is due.
+ *
+ * @param ppRaw Receives the raw frame.
+ * @param ppEntry Receives the index entry of the frame if not NULL.
+ * @return SUCCESS or -ETIMEOUT if the next frame is not due yet.
+ *//*********************************************************************/
+OSC_ERR ArchiveReadPicture(uint8 **ppRaw, const struct ARC_INDEX_ENTRY **ppEntry);
+
+/*********************************************************************//*!
+ * @brief Read a GPIO input as recorded with the last frame replayed;
+ * takes the place of OscGpioRead() while an archive is the source.
+ *
+ * @param gpio The input.
+ * @param pbLevel Receives the level of the input.
+ * @return SUCCESS or -EINVALID_PARAMETER if gpio is no input.
+ *//*********************************************************************/
+OSC_ERR ArchiveGpioRead(enum EnGpios gpio, bool *pbLevel);
+
+/*********************************************************************//*!
+ * @brief Write an archive from BMP files (8 bit raw Bayer images as
+ * used by the camera emulation) and black-box recordings.
+ *
+ * @param strOut Name of the archive.
+ * @param nIn Number of input files.
+ * @param strIn Names of the input files.
+ * @return SUCCESS or an appropriate error code.
+ *//*********************************************************************/
+OSC_ERR ArchiveConvert(const char *strOut, int nIn, const char * const strIn[]);
+
+#endif /*ARCHIVE_H_*/
@@ -0,0 +1,452 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file band.c
+ * @brief Change detection and labeling of one frame split into
+ * horizontal bands processed by a pool of threads (host only).
+ */
+
+#include "band.h"
+#include "kernels.h"
+#include "morph.h"
+#include <pthread.h>
+
+/*! @brief Most runs a row of a half size mask can have. */
+#define BAND_RUNS_PER_ROW ((OSC_CAM_MAX_IMAGE_WIDTH/2 + 1)/2)
+/*! @brief Runs of the whole mask in the worst case. */
+#define BAND_MAX_RUNS (BAND_RUNS_PER_ROW*(OSC_CAM_MAX_IMAGE_HEIGHT/2))
+
+/*! @brief Runs found in one band. The runs of a band are stored from the
+ * index of its first row times BAND_RUNS_PER_ROW on, so every band
+ * writes its own part of the pool and all runs are in raster order. */
+struct BAND
+{
+	/*! @brief Rows [rowStart, rowEnd) of the band. */
+	uint16 rowStart, rowEnd;
+	/*! @brief Runs [first, end) of the band. */
+	uint32 first, end;
+	/*! @brief Runs of the first row are [first, firstRowEnd). */
+	uint32 firstRowEnd;
+	/*! @brief Runs of the last row are [lastRowStart, end). */
+	uint32 lastRowStart;
+};
+
+/*! @brief The job the bands are processed with. */
+typedef void (*BAND_JOB)(uint8 nBand, void *pArg);
+
+/*! @brief The thread pool and the shared state of a frame. */
+static struct
+{
+	/*! @brief Threads including the caller. */
+	uint8 nThreads;
+	pthread_t threads[MAX_BAND_THREADS];
+	/*! @brief Protects the fields below. */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	/*! @brief Incremented with every new job. */
+	uint32 generation;
+	/*! @brief Bands not finished yet. */
+	uint8 nPending;
+	/*! @brief Number of bands of the current job. */
+	uint8 nBands;
+	BAND_JOB job;
+	void *pArg;
+	/*! @brief The neighbourhood of OscVisLabelBinary() has been probed. */
+	bool bProbed;
+	/*! @brief OscVisLabelBinary() joins diagonal neighbours. */
+	bool bDiagonal;
+} pool = { 1, {}, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+/*! @brief The bands of the current frame. */
+static struct BAND bands[MAX_BAND_THREADS];
+/*! @brief All runs of the current frame. */
+static struct OSC_VIS_REGIONS_RUN runs[BAND_MAX_RUNS];
+/*! @brief Union-find forest over the runs; the root of a set is always
+ * its first run in raster order. */
+static uint32 parent[BAND_MAX_RUNS];
+/*! @brief Object index of the runs that are roots. */
+static uint16 objectOf[BAND_MAX_RUNS];
+
+/*********************************************************************//*!
+ * @brief Body of a pool thread; runs band nThread of every job.
+ *//*********************************************************************/
+static void *BandWorker(void *pArg)
+{
+	const uint8 nThread = (uint8)(long)pArg;
+	uint32 generation = 0;
+
+	pthread_mutex_lock(&pool.mutex);
+	while (TRUE)
+	{
+		while (pool.generation == generation)
+			pthread_cond_wait(&pool.cond, &pool.mutex);
+		generation = pool.generation;
+		if (nThread < pool.nBands)
+		{
+			pthread_mutex_unlock(&pool.mutex);
+			pool.job(nThread, pool.pArg);
+			pthread_mutex_lock(&pool.mutex);
+			if (--pool.nPending == 0)
+				pthread_cond_broadcast(&pool.cond);
+		}
+	}
+	return NULL;
+}
+
+/*********************************************************************//*!
+ * @brief Process nBands bands with a job, band 0 in the calling thread,
+ * and wait for all of them.
+ *//*********************************************************************/
+static void RunBands(BAND_JOB job, void *pArg, uint8 nBands)
+{
+	pthread_mutex_lock(&pool.mutex);
+	pool.job = job;
+	pool.pArg = pArg;
+	pool.nBands = nBands;
+	pool.nPending = nBands - 1;
+	pool.generation++;
+	pthread_cond_broadcast(&pool.cond);
+	pthread_mutex_unlock(&pool.mutex);
+
+	job(0, pArg);
+
+	pthread_mutex_lock(&pool.mutex);
+	while (pool.nPending > 0)
+		pthread_cond_wait(&pool.cond, &pool.mutex);
+	pthread_mutex_unlock(&pool.mutex);
+}
+
+/*********************************************************************//*!
+ * @brief Find out whether OscVisLabelBinary() joins two pixels touching
+ * only at a corner, so the bands label with the same neighbourhood.
+ *//*********************************************************************/
+static OSC_ERR ProbeConnectivity(void)
+{
+	static uint8 probe[2*2] = { 1, 0, 0, 1 };
+	static struct OSC_VIS_REGIONS probeRegions;
+	struct OSC_PICTURE pic;
+	OSC_ERR err;
+
+	pic.data = probe;
+	pic.width = 2;
+	pic.height = 2;
+	pic.type = OSC_PICTURE_BINARY;
+	err = OscVisLabelBinary(&pic, &probeRegions);
+	if (err != SUCCESS)
+	{
+		OscLog(ERROR, "%s: cannot label the probe!\n", __func__);
+		return err;
+	}
+	pool.bDiagonal = probeRegions.noOfObjects == 1;
+	pool.bProbed = TRUE;
+	return SUCCESS;
+}
+
+OSC_ERR BandInit(uint8 nThreads)
+{
+	OSC_ERR err;
+	long i;
+
+	if (nThreads < 1 || nThreads > MAX_BAND_THREADS)
+		return -EINVALID_PARAMETER;
+	if (!pool.bProbed)
+	{
+		err = ProbeConnectivity();
+		if (err != SUCCESS)
+			return err;
+	}
+	for (i = pool.nThreads; i < nThreads; i++)
+	{
+		if (pthread_create(&pool.threads[i], NULL, BandWorker, (void*)i) != 0)
+		{
+			OscLog(ERROR, "%s: cannot start band thread %ld!\n", __func__, i);
+			return -EOUT_OF_MEMORY;
+		}
+		pool.nThreads = i + 1;
+	}
+	return SUCCESS;
+}
+
+/*********************************************************************//*!
+ * @brief Split height rows into nBands bands of nearly equal size.
+ *//*********************************************************************/
+static uint8 SplitBands(uint16 height, uint8 nBands)
+{
+	uint8 b;
+
+	if (nBands > pool.nThreads)
+		nBands = pool.nThreads;
+	if (nBands > height)
+		nBands = height;
+	for (b = 0; b < nBands; b++)
+	{
+		bands[b].rowStart = (uint32)height*b/nBands;
+		bands[b].rowEnd = (uint32)height*(b + 1)/nBands;
+	}
+	return nBands;
+}
+
+/*! @brief Arguments of the change detection job. */
+struct CHANGE_DETECTION_ARGS
+{
+	const uint8 *pImg, *pBg;
+	int width, height, threshold;
+	bool bPlanar;
+	uint8 *pMask;
+};
+
+static void ChangeDetectionJob(uint8 nBand, void *pArg)
+{
+	const struct CHANGE_DETECTION_ARGS *pArgs = (const struct CHANGE_DETECTION_ARGS*)pArg;
+
+	ChangeDetectionRows(pArgs->pImg, pArgs->pBg, pArgs->width, pArgs->height, pArgs->bPlanar,
+			bands[nBand].rowStart, bands[nBand].rowEnd, pArgs->threshold, pArgs->pMask);
+}
+
+void ChangeDetectionBanded(const uint8 *pImg, const uint8 *pBg, int width, int height, bool bPlanar,
+		uint8 nBands, uint8 *pMask)
+{
+	struct CHANGE_DETECTION_ARGS args;
+
+	/* The threshold is read here, the workers do not see the data of
+	 * this lane. */
+	args.pImg = pImg;
+	args.pBg = pBg;
+	args.width = width;
+	args.height = height;
+	args.threshold = NUM_COLORS*data.ipc.state.nThreshold;
+	args.bPlanar = bPlanar;
+	args.pMask = pMask;
+
+	RunBands(ChangeDetectionJob, &args, SplitBands(height, nBands));
+}
+
+/*********************************************************************//*!
+ * @brief Root of the set of a run.
+ *//*********************************************************************/
+static inline uint32 Find(uint32 i)
+{
+	while (parent[i] != i)
+	{
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+/*********************************************************************//*!
+ * @brief Join the sets of two runs; the smaller root wins.
+ *//*********************************************************************/
+static inline void Union(uint32 a, uint32 b)
+{
+	a = Find(a);
+	b = Find(b);
+	if (a < b)
+		parent[b] = a;
+	else if (b < a)
+		parent[a] = b;
+}
+
+/*********************************************************************//*!
+ * @brief Whether two runs of adjacent rows touch.
+ *//*********************************************************************/
+static inline bool RunsTouch(const struct OSC_VIS_REGIONS_RUN *pA, const struct OSC_VIS_REGIONS_RUN *pB)
+{
+	if (pool.bDiagonal)
+		return pA->startColumn <= pB->endColumn && pB->startColumn <= pA->endColumn;
+	return pA->startColumn < pB->endColumn && pB->startColumn < pA->endColumn;
+}
+
+/*********************************************************************//*!
+ * @brief Join the runs [a, aEnd) of a row with the touching runs
+ * [b, bEnd) of the row below; both lists are sorted by column.
+ *//*********************************************************************/
+static void JoinRows(uint32 a, uint32 aEnd, uint32 b, uint32 bEnd)
+{
+	while (a < aEnd && b < bEnd)
+	{
+		if (RunsTouch(&runs[a], &runs[b]))
+			Union(a, b);
+		/* Advance the run ending first; it cannot touch anything further
+		 * right. */
+		if (runs[a].endColumn < runs[b].endColumn)
+			a++;
+		else
+			b++;
+	}
+}
+
+/*! @brief Arguments of the labeling job. */
+struct LABEL_ARGS
+{
+	const uint8 *pMask;
+	/*! @brief The mask packed (c.f. CleanupMask()) or NULL. */
+	const uint32 *pPacked;
+	uint16 width;
+};
+
+/*********************************************************************//*!
+ * @brief Append the runs of a byte mask row starting at run n.
+ * @return The run after the last one appended.
+ *//*********************************************************************/
+static uint32 RowRuns(const uint8 *pRow, uint16 width, uint16 row, uint32 n)
+{
+	uint16 col;
+
+	for (col = 0; col < width; col++)
+	{
+		if (pRow[col])
+		{
+			runs[n].row = row;
+			runs[n].startColumn = col;
+			while (col < width && pRow[col])
+				col++;
+			runs[n].endColumn = col;
+			parent[n] = n;
+			n++;
+		}
+	}
+	return n;
+}
+
+/*********************************************************************//*!
+ * @brief Append the runs of a packed mask row starting at run n.
+ *
+ * The run boundaries are found a word at a time by counting the
+ * trailing zeros of the word, or of its complement inside a run.
+ * @return The run after the last one appended.
+ *//*********************************************************************/
+static uint32 PackedRowRuns(const uint32 *pRow, uint16 width, uint16 row, uint32 n)
+{
+	const uint16 nWords = (width + 31)/32;
+	bool bInRun = FALSE;
+	uint16 w;
+
+	for (w = 0; w < nWords; w++)
+	{
+		const uint32 bits = pRow[w];
+		uint32 pos = 0;
+
+		while (pos < 32)
+		{
+			/* The bits still to look at which end the current state. */
+			const uint32 edges = (bInRun ? ~bits : bits) & (0xffffffffu << pos);
+
+			if (edges == 0)
+				break;
+			pos = __builtin_ctz(edges);
+			if (bInRun)
+			{
+				runs[n].endColumn = 32*w + pos;
+				parent[n] = n;
+				n++;
+			}
+			else
+			{
+				runs[n].row = row;
+				runs[n].startColumn = 32*w + pos;
+			}
+			bInRun = !bInRun;
+		}
+	}
+	if (bInRun)
+	{
+		/* The bits beyond the width are 0, so the run ends at the border. */
+		runs[n].endColumn = width;
+		parent[n] = n;
+		n++;
+	}
+	return n;
+}
+
+static void LabelJob(uint8 nBand, void *pArg)
+{
+	const struct LABEL_ARGS *pArgs = (const struct LABEL_ARGS*)pArg;
+	struct BAND *pBand = &bands[nBand];
+	uint32 n = pBand->rowStart*BAND_RUNS_PER_ROW;
+	uint32 prevStart = n, prevEnd = n;
+	uint16 row;
+
+	pBand->first = n;
+	for (row = pBand->rowStart; row < pBand->rowEnd; row++)
+	{
+		const uint32 rowStart = n;
+
+		if (pArgs->pPacked != NULL)
+			n = PackedRowRuns(&pArgs->pPacked[(uint32)row*MORPH_MAX_WORDS], pArgs->width, row, n);
+		else
+			n = RowRuns(&pArgs->pMask[(uint32)row*pArgs->width], pArgs->width, row, n);
+		if (row == pBand->rowStart)
+			pBand->firstRowEnd = n;
+		else
+			JoinRows(prevStart, prevEnd, rowStart, n);
+		prevStart = rowStart;
+		prevEnd = n;
+	}
+	pBand->lastRowStart = prevStart;
+	pBand->end = n;
+}
+
+OSC_ERR LabelBinaryBanded(struct OSC_PICTURE *pPic, struct OSC_VIS_REGIONS *regions, uint8 nBands,
+		const uint32 *pPacked)
+{
+	const uint16 maxObjects = sizeof(regions->objects)/sizeof(regions->objects[0]);
+	struct LABEL_ARGS args;
+	OSC_ERR err = SUCCESS;
+	uint32 i, nRuns = 0;
+	uint16 nObjects = 0;
+	uint8 b;
+
+	args.pMask = (const uint8*)pPic->data;
+	args.pPacked = pPacked;
+	args.width = pPic->width;
+
+	nBands = SplitBands(pPic->height, nBands);
+	RunBands(LabelJob, &args, nBands);
+
+	/* Join across the seams. */
+	for (b = 1; b < nBands; b++)
+	{
+		JoinRows(bands[b - 1].lastRowStart, bands[b - 1].end, bands[b].first, bands[b].firstRowEnd);
+	}
+
+	/* Collect the objects in raster order of their first runs. */
+	for (b = 0; b < nBands && err == SUCCESS; b++)
+	{
+		for (i = bands[b].first; i < bands[b].end; i++)
+		{
+			const uint32 root = Find(i);
+			struct OSC_VIS_REGIONS_OBJECT *pObject;
+
+			if (root == i)
+			{
+				if (nObjects == maxObjects)
+				{
+					err = -EBUFFER_TOO_SMALL;
+					break;
+				}
+				objectOf[i] = nObjects;
+				pObject = &regions->objects[nObjects];
+				pObject->root = &runs[i];
+				nObjects++;
+			}
+			else
+			{
+				pObject = &regions->objects[objectOf[root]];
+				pObject->last->next = &runs[i];
+			}
+			/* Fill the run completely like OscVisLabelBinary() does; the
+			 * pool holds the runs of the previous frame. */
+			runs[i].next = NULL;
+			runs[i].label = objectOf[root];
+			runs[i].parent = &runs[root];
+			pObject->last = &runs[i];
+			nRuns++;
+		}
+	}
+	regions->noOfObjects = nObjects;
+	regions->noOfRuns = nRuns;
+	return err;
+}
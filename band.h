@@ -0,0 +1,67 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file band.h
+ * @brief Change detection and labeling of one frame split into
+ * horizontal bands processed by a pool of threads (host only).
+ *
+ * Every band finds its runs and joins the runs of its own rows. The runs
+ * touching across the seams between the bands are joined afterwards, and
+ * the regions are collected in raster order like OscVisLabelBinary()
+ * does. The neighbourhood is not configured but probed from
+ * OscVisLabelBinary() itself, so both label the same regions.
+ *
+ * There is one pool and one set of runs, so only the camera lane uses
+ * the bands.
+ */
+#ifndef BAND_H_
+#define BAND_H_
+
+#include "template.h"
+
+/*********************************************************************//*!
+ * @brief Start the threads of the pool.
+ *
+ * Only the threads missing are started, so the pool grows when it is
+ * called again with more; it never shrinks.
+ *
+ * @param nThreads Number of threads the frames are split among,
+ * including the calling one (1 ... MAX_BAND_THREADS).
+ * @return SUCCESS or an appropriate error code.
+ *//*********************************************************************/
+OSC_ERR BandInit(uint8 nThreads);
+
+/*********************************************************************//*!
+ * @brief Change detection with the image split into bands.
+ *
+ * @param pImg The current image.
+ * @param pBg The background image.
+ * @param width Width of the images.
+ * @param height Height of the images.
+ * @param bPlanar Whether the images are planar or interleaved.
+ * @param nBands Number of bands (at most the threads of the pool).
+ * @param pMask Receives the binary mask.
+ *//*********************************************************************/
+void ChangeDetectionBanded(const uint8 *pImg, const uint8 *pBg, int width, int height, bool bPlanar,
+		uint8 nBands, uint8 *pMask);
+
+/*********************************************************************//*!
+ * @brief Label a binary image with the image split into bands.
+ *
+ * Replaces OscVisLabelBinary(); the runs are taken from a pool of this
+ * module and stay valid until the next call.
+ *
+ * @param pPic The binary image.
+ * @param regions Receives the regions.
+ * @param nBands Number of bands (at most the threads of the pool).
+ * @param pPacked The same image packed as returned by CleanupMask(); the
+ * runs are then taken from it a word at a time. NULL to use pPic.
+ * @return SUCCESS or -EBUFFER_TOO_SMALL if there are more regions than
+ * regions can hold.
+ *//*********************************************************************/
+OSC_ERR LabelBinaryBanded(struct OSC_PICTURE *pPic, struct OSC_VIS_REGIONS *regions, uint8 nBands,
+		const uint32 *pPacked);
+
+#endif /*BAND_H_*/
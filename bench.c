@@ -0,0 +1,314 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file bench.c
+ * @brief Benchmarks of the processing kernels on a synthetic frame.
+ *
+ * Started with the command line option -b instead of the state machine.
+ * Every kernel is run BENCH_REPETITIONS times and the mean time per call
+ * is logged.
+ */
+
+#include "template.h"
+#include "debayer.h"
+#include "band.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*! @brief Number of calls per measured kernel. */
+#define BENCH_REPETITIONS 50
+
+/*! @brief Threshold for change detection, as set at start up. */
+#define BENCH_THRESHOLD 30
+
+/*! @brief Number of pixels of a half size image. */
+#define BENCH_PIX ((OSC_CAM_MAX_IMAGE_WIDTH/2)*(OSC_CAM_MAX_IMAGE_HEIGHT/2))
+
+/*! @brief Images in both layouts; independent of PLANAR_COLORS so both
+ * can be compared in the same build. */
+static uint8 benchImg[2][3*BENCH_PIX];
+/*! @brief Background images in both layouts. */
+static uint8 benchBg[2][3*BENCH_PIX];
+
+/*! @brief Index of the interleaved images in benchImg and benchBg. */
+#define BENCH_INTERLEAVED 0
+/*! @brief Index of the planar images in benchImg and benchBg. */
+#define BENCH_PLANAR 1
+
+/*! @brief Luminance images of the two debayering implementations. */
+static uint8 benchLuma[2][BENCH_PIX];
+/*! @brief Colour image of the reference the debayering is checked with. */
+static uint8 benchRef[3*BENCH_PIX];
+/*! @brief White balance gains of blue, green and red the debayering is
+ * measured with. */
+static const uint16 benchGains[3] = { 300, DEBAYER_GAIN_ONE, 420 };
+
+static void BenchDebayerFramework(void)
+{
+	OscVisDebayerHalfSize(data.u8FrameBuffers[0], OSC_CAM_MAX_IMAGE_WIDTH, OSC_CAM_MAX_IMAGE_HEIGHT, ROW_RGRG, benchRef);
+}
+
+static void BenchDebayerGreyscaleFramework(void)
+{
+	OscVisDebayerGreyscaleHalfSize(data.u8FrameBuffers[0], OSC_CAM_MAX_IMAGE_WIDTH, OSC_CAM_MAX_IMAGE_HEIGHT, ROW_RGRG, benchLuma[0]);
+}
+
+static void BenchDebayerScalar(void)
+{
+	DebayerHalfSizeScalar(data.u8FrameBuffers[0], OSC_CAM_MAX_IMAGE_WIDTH, OSC_CAM_MAX_IMAGE_HEIGHT, ROW_RGRG,
+			DEBAYER_BGR, NULL, benchImg[BENCH_INTERLEAVED], NULL);
+}
+
+static void BenchDebayerInterleaved(void)
+{
+	DebayerHalfSize(data.u8FrameBuffers[0], OSC_CAM_MAX_IMAGE_WIDTH, OSC_CAM_MAX_IMAGE_HEIGHT, ROW_RGRG,
+			DEBAYER_BGR, NULL, benchImg[BENCH_INTERLEAVED], NULL);
+}
+
+static void BenchDebayerPlanar(void)
+{
+	DebayerHalfSize(data.u8FrameBuffers[0], OSC_CAM_MAX_IMAGE_WIDTH, OSC_CAM_MAX_IMAGE_HEIGHT, ROW_RGRG,
+			DEBAYER_BGR_PLANAR, NULL, benchImg[BENCH_PLANAR], NULL);
+}
+
+static void BenchDebayerLuma(void)
+{
+	DebayerHalfSize(data.u8FrameBuffers[0], OSC_CAM_MAX_IMAGE_WIDTH, OSC_CAM_MAX_IMAGE_HEIGHT, ROW_RGRG,
+			DEBAYER_LUMA, NULL, NULL, benchLuma[0]);
+}
+
+static void BenchDebayerLumaColor(void)
+{
+	DebayerHalfSize(data.u8FrameBuffers[0], OSC_CAM_MAX_IMAGE_WIDTH, OSC_CAM_MAX_IMAGE_HEIGHT, ROW_RGRG,
+			DEBAYER_LUMA_BGR, NULL, benchImg[BENCH_INTERLEAVED], benchLuma[0]);
+}
+
+static void BenchDebayerGains(void)
+{
+	DebayerHalfSize(data.u8FrameBuffers[0], OSC_CAM_MAX_IMAGE_WIDTH, OSC_CAM_MAX_IMAGE_HEIGHT, ROW_RGRG,
+			DEBAYER_BGR, benchGains, benchImg[BENCH_INTERLEAVED], NULL);
+}
+
+/*********************************************************************//*!
+ * @brief Check DebayerHalfSizeScalar() against the framework and
+ * DebayerHalfSize() against DebayerHalfSizeScalar() for all Bayer orders
+ * and outputs, with and without gains.
+ *//*********************************************************************/
+static void BenchDebayerCheck(void)
+{
+	static const enum EnBayerOrder orders[] = { ROW_RGRG, ROW_BGBG, ROW_GRGR, ROW_GBGB };
+	const uint8 *pRaw = data.u8FrameBuffers[0];
+	int o, out, g;
+	bool bSame = TRUE;
+
+	for (o = 0; o < 4; o++)
+	{
+		OscVisDebayerHalfSize((uint8*)pRaw, OSC_CAM_MAX_IMAGE_WIDTH, OSC_CAM_MAX_IMAGE_HEIGHT, orders[o], benchRef);
+		DebayerHalfSizeScalar(pRaw, OSC_CAM_MAX_IMAGE_WIDTH, OSC_CAM_MAX_IMAGE_HEIGHT, orders[o],
+				DEBAYER_BGR, NULL, benchImg[BENCH_INTERLEAVED], NULL);
+		OscLog(INFO, "debayer order %d against framework: %s\n", orders[o],
+				memcmp(benchRef, benchImg[BENCH_INTERLEAVED], sizeof(benchRef)) == 0 ? "identical" : "DIFFERENT");
+
+		for (out = DEBAYER_BGR; out <= DEBAYER_LUMA_BGR_PLANAR; out++)
+		{
+			for (g = 0; g < 2; g++)
+			{
+				const uint16 *pGains = g ? benchGains : NULL;
+
+				memset(benchImg, 0, sizeof(benchImg));
+				memset(benchLuma, 0, sizeof(benchLuma));
+				DebayerHalfSizeScalar(pRaw, OSC_CAM_MAX_IMAGE_WIDTH, OSC_CAM_MAX_IMAGE_HEIGHT, orders[o],
+						out, pGains, benchImg[0], benchLuma[0]);
+				DebayerHalfSize(pRaw, OSC_CAM_MAX_IMAGE_WIDTH, OSC_CAM_MAX_IMAGE_HEIGHT, orders[o],
+						out, pGains, benchImg[1], benchLuma[1]);
+				if (memcmp(benchImg[0], benchImg[1], sizeof(benchImg[0])) != 0
+						|| memcmp(benchLuma[0], benchLuma[1], sizeof(benchLuma[0])) != 0)
+				{
+					OscLog(INFO, "debayer order %d output %d gains %d: DIFFERENT from scalar\n", orders[o], out, g);
+					bSame = FALSE;
+				}
+			}
+		}
+	}
+	OscLog(INFO, "debayer against scalar reference: %s\n", bSame ? "identical" : "DIFFERENT");
+}
+
+static void BenchChangeDetectionGeneric(void)
+{
+	ChangeDetectionGeneric(&data, benchImg[BENCH_INTERLEAVED], benchBg[BENCH_INTERLEAVED], OSC_CAM_MAX_IMAGE_WIDTH/2, OSC_CAM_MAX_IMAGE_HEIGHT/2);
+}
+
+static void BenchChangeDetectionPlanarGeneric(void)
+{
+	ChangeDetectionPlanarGeneric(&data, benchImg[BENCH_PLANAR], benchBg[BENCH_PLANAR], OSC_CAM_MAX_IMAGE_WIDTH/2, OSC_CAM_MAX_IMAGE_HEIGHT/2);
+}
+
+static void BenchChangeDetectionInterleaved(void)
+{
+	ChangeDetection(&data, benchImg[BENCH_INTERLEAVED], benchBg[BENCH_INTERLEAVED], OSC_CAM_MAX_IMAGE_WIDTH/2, OSC_CAM_MAX_IMAGE_HEIGHT/2);
+}
+
+static void BenchChangeDetectionPlanar(void)
+{
+	ChangeDetectionPlanar(&data, benchImg[BENCH_PLANAR], benchBg[BENCH_PLANAR], OSC_CAM_MAX_IMAGE_WIDTH/2, OSC_CAM_MAX_IMAGE_HEIGHT/2);
+}
+
+/*! @brief Number of rectangles in the mask the labeling is measured
+ * with. */
+#define BENCH_BLOBS 200
+
+/*! @brief Mask the labeling is measured with. */
+static uint8 benchMask[BENCH_PIX];
+/*! @brief Regions of the reference labeling and of the banded one. */
+static struct OSC_VIS_REGIONS benchRegions[2];
+
+/*********************************************************************//*!
+ * @brief Whether two labelings found the same regions with the same runs
+ * in the same order.
+ *//*********************************************************************/
+static bool SameRegions(const struct OSC_VIS_REGIONS *pA, const struct OSC_VIS_REGIONS *pB)
+{
+	uint16 o;
+
+	if (pA->noOfObjects != pB->noOfObjects)
+		return FALSE;
+	for (o = 0; o < pA->noOfObjects; o++)
+	{
+		const struct OSC_VIS_REGIONS_RUN *pRunA = pA->objects[o].root;
+		const struct OSC_VIS_REGIONS_RUN *pRunB = pB->objects[o].root;
+
+		while (pRunA != 0 && pRunB != 0)
+		{
+			if (pRunA->row != pRunB->row || pRunA->startColumn != pRunB->startColumn
+					|| pRunA->endColumn != pRunB->endColumn)
+				return FALSE;
+			pRunA = pRunA->next;
+			pRunB = pRunB->next;
+		}
+		if (pRunA != pRunB)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/*********************************************************************//*!
+ * @brief Measure change detection and labeling split among 1 ...
+ * MAX_BAND_THREADS threads and check the regions against
+ * OscVisLabelBinary().
+ *//*********************************************************************/
+static void BenchBands(void)
+{
+	struct OSC_PICTURE pic;
+	uint32 i, start, time1 = 0;
+	uint8 nThreads;
+
+	/* Overlapping rectangles of random size, so regions span the seams. */
+	memset(benchMask, 0, sizeof(benchMask));
+	for (i = 0; i < BENCH_BLOBS; i++)
+	{
+		const uint16 w = 2 + rand() % 30, h = 2 + rand() % 30;
+		const uint16 x0 = rand() % (OSC_CAM_MAX_IMAGE_WIDTH/2 - w);
+		const uint16 y0 = rand() % (OSC_CAM_MAX_IMAGE_HEIGHT/2 - h);
+		uint16 x, y;
+
+		for (y = y0; y < y0 + h; y++)
+			for (x = x0; x < x0 + w; x++)
+				benchMask[y*(OSC_CAM_MAX_IMAGE_WIDTH/2) + x] = 1;
+	}
+	pic.data = benchMask;
+	pic.width = OSC_CAM_MAX_IMAGE_WIDTH/2;
+	pic.height = OSC_CAM_MAX_IMAGE_HEIGHT/2;
+	pic.type = OSC_PICTURE_BINARY;
+	OscVisLabelBinary(&pic, &benchRegions[0]);
+
+	for (nThreads = 1; nThreads <= MAX_BAND_THREADS; nThreads++)
+	{
+		uint32 time;
+		bool bSame;
+
+		LabelBinaryBanded(&pic, &benchRegions[1], nThreads, NULL);
+		bSame = SameRegions(&benchRegions[0], &benchRegions[1]);
+
+		start = OscSupCycGet();
+		for (i = 0; i < BENCH_REPETITIONS; i++)
+		{
+			ChangeDetectionBanded(benchImg[BENCH_INTERLEAVED], benchBg[BENCH_INTERLEAVED],
+					OSC_CAM_MAX_IMAGE_WIDTH/2, OSC_CAM_MAX_IMAGE_HEIGHT/2, FALSE, nThreads, ImgData(&data, PROCESSFRAME0));
+			LabelBinaryBanded(&pic, &benchRegions[1], nThreads, NULL);
+		}
+		time = OscSupCycToMicroSecs(OscSupCycGet() - start)/BENCH_REPETITIONS;
+		if (nThreads == 1)
+			time1 = time;
+		OscLog(INFO, "bands %d threads %8u us  speedup %3u%%  regions %s\n", nThreads, time,
+				time > 0 ? 100*time1/time : 0, bSame ? "identical" : "DIFFERENT");
+	}
+}
+
+/*! @brief A measured kernel. */
+struct BENCHMARK {
+	/*! @brief Name printed in the log. */
+	const char *strName;
+	/*! @brief The kernel with its arguments bound. */
+	void (*pFn)(void);
+};
+
+/*! @brief All benchmarks, in the order they are run. */
+static const struct BENCHMARK benchmarks[] = {
+	{ "debayer framework", BenchDebayerFramework },
+	{ "debayer greyscale framework", BenchDebayerGreyscaleFramework },
+	{ "debayer scalar", BenchDebayerScalar },
+	{ "debayer interleaved", BenchDebayerInterleaved },
+	{ "debayer planar", BenchDebayerPlanar },
+	{ "debayer luma", BenchDebayerLuma },
+	{ "debayer luma and interleaved", BenchDebayerLumaColor },
+	{ "debayer interleaved with gains", BenchDebayerGains },
+	{ "change detection generic", BenchChangeDetectionGeneric },
+	{ "change detection interleaved", BenchChangeDetectionInterleaved },
+	{ "change detection planar generic", BenchChangeDetectionPlanarGeneric },
+	{ "change detection planar", BenchChangeDetectionPlanar }
+};
+
+void RunBenchmarks()
+{
+	uint32 i, n;
+
+	/* Synthetic raw frame; the background is the debayered first frame
+	 * so change detection sees noise only. */
+	for (i = 0; i < OSC_CAM_MAX_IMAGE_WIDTH*OSC_CAM_MAX_IMAGE_HEIGHT; i++)
+	{
+		data.u8FrameBuffers[0][i] = rand();
+	}
+	ImgSetGeometry(&data, PROCESSFRAME0, OSC_CAM_MAX_IMAGE_WIDTH/2, OSC_CAM_MAX_IMAGE_HEIGHT/2);
+	data.ipc.state.nThreshold = BENCH_THRESHOLD;
+	BenchDebayerInterleaved();
+	BenchDebayerPlanar();
+	memcpy(benchBg, benchImg, sizeof(benchBg));
+	for (i = 0; i < OSC_CAM_MAX_IMAGE_WIDTH*OSC_CAM_MAX_IMAGE_HEIGHT; i++)
+	{
+		data.u8FrameBuffers[0][i] = rand();
+	}
+
+	for (n = 0; n < sizeof(benchmarks)/sizeof(benchmarks[0]); n++)
+	{
+		uint32 start;
+
+		/* Warm the caches. */
+		benchmarks[n].pFn();
+		start = OscSupCycGet();
+		for (i = 0; i < BENCH_REPETITIONS; i++)
+		{
+			benchmarks[n].pFn();
+		}
+		OscLog(INFO, "%-32s %8u us\n", benchmarks[n].strName,
+				OscSupCycToMicroSecs(OscSupCycGet() - start)/BENCH_REPETITIONS);
+	}
+
+	BenchDebayerCheck();
+
+	if (BandInit(MAX_BAND_THREADS) == SUCCESS)
+	{
+		BenchBands();
+	}
+}
@@ -13,8 +13,12 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <stdarg.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
 
 #include "cgi.h"
+#include "fcgi.h"
 
 #include <time.h>
 
@@ -27,9 +31,46 @@ struct ARGUMENT args[] =
 {
 	{ "exposureTime", INT_ARG, &cgi.args.nExposureTime, &cgi.args.bExposureTime_supplied },
 	{ "Threshold", INT_ARG, &cgi.args.nThreshold, &cgi.args.bThreshold_supplied },
-	{ "ImageType", INT_ARG, &cgi.args.nImageType, &cgi.args.bImageType_supplied }
+	{ "DetectLevel", INT_ARG, &cgi.args.nDetectLevel, &cgi.args.bDetectLevel_supplied },
+	{ "MorphOp", INT_ARG, &cgi.args.nMorphOp, &cgi.args.bMorphOp_supplied },
+	{ "MinArea", INT_ARG, &cgi.args.nMinArea, &cgi.args.bMinArea_supplied },
+	{ "BandThreads", INT_ARG, &cgi.args.nBandThreads, &cgi.args.bBandThreads_supplied },
+	{ "AutoExposure", INT_ARG, &cgi.args.nAutoExposure, &cgi.args.bAutoExposure_supplied },
+	{ "Record", INT_ARG, &cgi.args.nRecord, &cgi.args.bRecord_supplied },
+	{ "EjectDistance", INT_ARG, &cgi.args.nEjectDistance, &cgi.args.bEjectDistance_supplied },
+	{ "Stats", INT_ARG, &cgi.args.nStats, &cgi.args.bStats_supplied },
+	{ "Wait", INT_ARG, &cgi.args.nWait, &cgi.args.bWait_supplied },
+	{ "RoiX", INT_ARG, &cgi.args.nRoiX, &cgi.args.bRoiX_supplied },
+	{ "RoiY", INT_ARG, &cgi.args.nRoiY, &cgi.args.bRoiY_supplied },
+	{ "RoiWidth", INT_ARG, &cgi.args.nRoiWidth, &cgi.args.bRoiWidth_supplied },
+	{ "RoiHeight", INT_ARG, &cgi.args.nRoiHeight, &cgi.args.bRoiHeight_supplied },
+	{ "ImageType", INT_ARG, &cgi.args.nImageType, &cgi.args.bImageType_supplied },
+	{ "Snapshot", INT_ARG, &cgi.args.nSnapshot, &cgi.args.bSnapshot_supplied },
+	{ "Seq", INT_ARG, &cgi.args.nSeq, &cgi.args.bSeq_supplied }
 };
 
+/*********************************************************************//*!
+ * @brief Append to the answer of the current request (cgi.strResponse);
+ * an answer too long is cut.
+ *//*********************************************************************/
+static void CgiPrintf(const char *strFormat, ...)
+{
+	va_list ap;
+	int n;
+
+	va_start(ap, strFormat);
+	n = vsnprintf(cgi.strResponse + cgi.nResponseLen, sizeof(cgi.strResponse) - cgi.nResponseLen, strFormat, ap);
+	va_end(ap);
+	if (n > 0)
+	{
+		cgi.nResponseLen += n;
+		if (cgi.nResponseLen >= sizeof(cgi.strResponse))
+		{
+			cgi.nResponseLen = sizeof(cgi.strResponse) - 1;
+		}
+	}
+}
+
 /*! @brief Strips whiltespace from the beginning and the end of a string and returns the new beginning of the string. Be advised, that the original string gets mangled! */
 char * strtrim(char * str) {
 	char * end = strchr(str, 0) - 1;
@@ -46,19 +87,18 @@ char * strtrim(char * str) {
 }
 
 /*********************************************************************//*!
- * @brief Split the supplied URI string into arguments and parse them.
+ * @brief Split the argument string (cgi.strArgumentsRaw) into arguments
+ * and parse them.
  *
  * Matches the argument string with the arguments list (args) and fills in
  * their values. Unknown arguments provoke an error, but missing
  * arguments are just ignored.
  *
- * @param strSrc The argument string.
- * @param srcLen The length of the argument string.
  * @return SUCCESS or an appropriate error code otherwise
  *//*********************************************************************/
 static OSC_ERR CGIParseArguments()
 {
-	char buffer[1024];
+	char *buffer, *next;
 
 	/* Intialize all arguments as 'not supplied' */
 	for (int i = 0; i < sizeof args / sizeof (struct ARGUMENT); i += 1)
@@ -66,9 +106,19 @@ static OSC_ERR CGIParseArguments()
 		*args[i].pbSupplied = false;
 	}
 
-	while (fgets (buffer, sizeof buffer, stdin)) {
+	/* One argument per line. */
+	strcpy(cgi.strArgumentsTemp, cgi.strArgumentsRaw);
+	for (buffer = cgi.strArgumentsTemp; *buffer != 0; buffer = next) {
 		struct ARGUMENT *pArg = NULL;
-		char * key, * value = strchr(buffer, ':');
+		char * key, * value;
+
+		next = strchr(buffer, '\n');
+		if (next != NULL) {
+			*next++ = 0;
+		} else {
+			next = strchr(buffer, 0);
+		}
+		value = strchr(buffer, ':');
 
 		if (value == NULL) {
 			OscLog(ERROR, "%s: Invalid line: \"%s\"\n", __func__, buffer);
@@ -126,6 +176,100 @@ static OSC_ERR CGIParseArguments()
 	return SUCCESS;
 }
 
+/*********************************************************************//*!
+ * @brief Write an image of half the camera resolution to the RAM file
+ * system where it can be picked up by the webserver on request from the
+ * browser.
+ *
+ * The image is written to a temporary file that replaces strFile, so
+ * the web server never serves it half written.
+ *//*********************************************************************/
+static OSC_ERR WriteImage(uint8 *pImg, const char *strFile)
+{
+	struct OSC_PICTURE pic;
+	char strTmpFile[64];
+	OSC_ERR err;
+
+	pic.width = OSC_CAM_MAX_IMAGE_WIDTH/2;
+	pic.height = OSC_CAM_MAX_IMAGE_HEIGHT/2;
+#if NUM_COLORS == 1
+	pic.type = OSC_PICTURE_GREYSCALE;
+#else
+	pic.type = OSC_PICTURE_BGR_24;
+#endif
+	pic.data = (void*)pImg;
+
+	snprintf(strTmpFile, sizeof(strTmpFile), "%s.tmp", strFile);
+	err = OscBmpWrite(&pic, strTmpFile);
+	if (err == SUCCESS && rename(strTmpFile, strFile) != 0)
+	{
+		OscLog(ERROR, "CGI: Unable to replace %s!\n", strFile);
+		err = -EFILE_ERROR;
+	}
+	return err;
+}
+
+/*********************************************************************//*!
+ * @brief Fetch the image type and frame named by the arguments Snapshot
+ * and Seq.
+ *
+ * The application answers in any state, so the request is not repeated;
+ * before the first frame there is no image (cgi.bSnapshotValid stays
+ * FALSE). Each frame gets a file of its own (c.f. SNAPSHOT_FN), which is
+ * written once for all clients asking for it.
+ *
+ * @return SUCCESS, -EINVALID_PARAMETER for an image type that has no
+ * snapshot, -ENO_MSG_AVAIL for a frame named by Seq that is no longer
+ * kept or an appropriate error code otherwise
+ *//*********************************************************************/
+static OSC_ERR QuerySnapshot()
+{
+	OSC_ERR err;
+	char strFile[64];
+	uint32 *pFileSeq;
+	const uint32 seq = cgi.args.bSeq_supplied ? cgi.args.nSeq : 0;
+
+	if (cgi.args.nSnapshot < 0 || cgi.args.nSnapshot >= SNAPSHOT_NUM_TYPES)
+	{
+		OscLog(ERROR, "CGI: No snapshot of image type %d!\n", cgi.args.nSnapshot);
+		return -EINVALID_PARAMETER;
+	}
+	err = OscIpcGetParam(cgi.ipcChan, &cgi.snapshot, SNAPSHOT_PARAM_ID(cgi.args.nSnapshot, seq), sizeof(struct SNAPSHOT));
+	if (err == -ENEGATIVE_ACKNOWLEDGE)
+	{
+		if (seq == 0)
+		{
+			OscLog(DEBUG, "CGI: No frame processed yet!\n");
+			return SUCCESS;
+		}
+		/* Asking again does not bring the frame back. */
+		OscLog(DEBUG, "CGI: Frame %u is no longer kept!\n", (unsigned int)seq);
+		return -ENO_MSG_AVAIL;
+	}
+	if (err != SUCCESS)
+	{
+		OscLog(DEBUG, "CGI: Getting a snapshot failed! (%d)\n", err);
+		return err;
+	}
+
+	pFileSeq = &cgi.nSnapshotFileSeq[cgi.snapshot.nImageType][cgi.snapshot.nSeq % SNAPSHOT_FILES];
+	snprintf(cgi.strSnapshotFile, sizeof(cgi.strSnapshotFile), SNAPSHOT_FN,
+			(int)cgi.snapshot.nImageType, (unsigned int)(cgi.snapshot.nSeq % SNAPSHOT_FILES));
+	if (*pFileSeq != cgi.snapshot.nSeq)
+	{
+		snprintf(strFile, sizeof(strFile), SNAPSHOT_DIR "%s", cgi.strSnapshotFile);
+		err = WriteImage(cgi.snapshot.data, strFile);
+		if (err != SUCCESS)
+		{
+			*pFileSeq = 0;
+			return err;
+		}
+		*pFileSeq = cgi.snapshot.nSeq;
+	}
+	cgi.bSnapshotValid = TRUE;
+	return SUCCESS;
+}
+
 /*********************************************************************//*!
  * @brief Query the current state of the application and see what else
  * we need to get from it
@@ -138,7 +282,6 @@ static OSC_ERR CGIParseArguments()
 static OSC_ERR QueryApp()
 {
 	OSC_ERR err;
-	struct OSC_PICTURE pic;
 
 	/* First, get the current state of the algorithm. */
 	err = OscIpcGetParam(cgi.ipcChan, &cgi.appState, GET_APP_STATE, sizeof(struct APPLICATION_STATE));
@@ -149,34 +292,39 @@ static OSC_ERR QueryApp()
 		return err;
 	}
 
+	if (cgi.appState.nLanes > 0)
+	{
+		err = OscIpcGetParam(cgi.ipcChan, &cgi.lanesInfo, GET_LANE_STATS, sizeof(struct LANES_INFO));
+		if (err != SUCCESS)
+		{
+			OscLog(DEBUG, "CGI: Getting the lanes failed! (%d)\n", err);
+			return err;
+		}
+	}
+
 	switch(cgi.appState.enAppMode)
 	{
 	case APP_OFF:
 		/* Algorithm is off, nothing else to do. */
 		break;
 	case APP_CAPTURE_ON:
+		/* A snapshot names its image type itself and does not depend on
+		 * the state of the application. */
+		if (cgi.args.bSnapshot_supplied)
+		{
+			return QuerySnapshot();
+		}
 		if (cgi.appState.bNewImageReady)
 		{
 			/* If there is a new image ready, request it from the application. */
-			err = OscIpcGetParam(cgi.ipcChan, cgi.imgBuf, GET_NEW_IMG, NUM_COLORS*OSC_CAM_MAX_IMAGE_WIDTH/2*OSC_CAM_MAX_IMAGE_HEIGHT/2);
+			err = OscIpcGetParam(cgi.ipcChan, cgi.snapshot.data, GET_NEW_IMG, sizeof(cgi.snapshot.data));
 			if (err != SUCCESS)
 			{
 				OscLog(DEBUG, "CGI: Getting new image failed! (%d)\n", err);
 				return err;
 			}
 
-			/* Write the image to the RAM file system where it can be picked
-			 * up by the webserver on request from the browser. */
-			pic.width = OSC_CAM_MAX_IMAGE_WIDTH/2;
-			pic.height = OSC_CAM_MAX_IMAGE_HEIGHT/2;
-#if NUM_COLORS == 1
-			pic.type = OSC_PICTURE_GREYSCALE;
-#else
-			pic.type = OSC_PICTURE_BGR_24;
-#endif
-			pic.data = (void*)cgi.imgBuf;
-
-			return OscBmpWrite(&pic, IMG_FN);
+			return WriteImage(cgi.snapshot.data, IMG_FN);
 		}
 		break;
 	default:
@@ -217,6 +365,92 @@ static OSC_ERR SetOptions()
 		}
 	}
 
+	if (pArgs->bDetectLevel_supplied)
+	{
+		err = OscIpcSetParam(cgi.ipcChan, &pArgs->nDetectLevel, SET_DETECT_LEVEL, sizeof(pArgs->nDetectLevel));
+		if (err != SUCCESS)
+		{
+			OscLog(DEBUG, "CGI: Error setting option! (%d)\n", err);
+			return err;
+		}
+	}
+
+	if (pArgs->bMorphOp_supplied)
+	{
+		err = OscIpcSetParam(cgi.ipcChan, &pArgs->nMorphOp, SET_MORPH_OP, sizeof(pArgs->nMorphOp));
+		if (err != SUCCESS)
+		{
+			OscLog(DEBUG, "CGI: Error setting option! (%d)\n", err);
+			return err;
+		}
+	}
+
+	if (pArgs->bMinArea_supplied)
+	{
+		err = OscIpcSetParam(cgi.ipcChan, &pArgs->nMinArea, SET_MIN_AREA, sizeof(pArgs->nMinArea));
+		if (err != SUCCESS)
+		{
+			OscLog(DEBUG, "CGI: Error setting option! (%d)\n", err);
+			return err;
+		}
+	}
+
+	if (pArgs->bRoiX_supplied || pArgs->bRoiY_supplied || pArgs->bRoiWidth_supplied || pArgs->bRoiHeight_supplied)
+	{
+		/* Missing coordinates are taken as zero. */
+		struct IMG_RECT roi;
+		roi.xPos = pArgs->bRoiX_supplied ? pArgs->nRoiX : 0;
+		roi.yPos = pArgs->bRoiY_supplied ? pArgs->nRoiY : 0;
+		roi.width = pArgs->bRoiWidth_supplied ? pArgs->nRoiWidth : 0;
+		roi.height = pArgs->bRoiHeight_supplied ? pArgs->nRoiHeight : 0;
+		err = OscIpcSetParam(cgi.ipcChan, &roi, SET_ROI, sizeof(roi));
+		if (err != SUCCESS)
+		{
+			OscLog(DEBUG, "CGI: Error setting option! (%d)\n", err);
+			return err;
+		}
+	}
+
+	if (pArgs->bBandThreads_supplied)
+	{
+		err = OscIpcSetParam(cgi.ipcChan, &pArgs->nBandThreads, SET_BAND_THREADS, sizeof(pArgs->nBandThreads));
+		if (err != SUCCESS)
+		{
+			OscLog(DEBUG, "CGI: Error setting option! (%d)\n", err);
+			return err;
+		}
+	}
+
+	if (pArgs->bAutoExposure_supplied)
+	{
+		err = OscIpcSetParam(cgi.ipcChan, &pArgs->nAutoExposure, SET_AUTO_EXPOSURE, sizeof(pArgs->nAutoExposure));
+		if (err != SUCCESS)
+		{
+			OscLog(DEBUG, "CGI: Error setting option! (%d)\n", err);
+			return err;
+		}
+	}
+
+	if (pArgs->bEjectDistance_supplied)
+	{
+		err = OscIpcSetParam(cgi.ipcChan, &pArgs->nEjectDistance, SET_EJECT_DISTANCE, sizeof(pArgs->nEjectDistance));
+		if (err != SUCCESS)
+		{
+			OscLog(DEBUG, "CGI: Error setting option! (%d)\n", err);
+			return err;
+		}
+	}
+
+	if (pArgs->bRecord_supplied && pArgs->nRecord != 0)
+	{
+		err = OscIpcSetParam(cgi.ipcChan, &pArgs->nRecord, TRIGGER_RECORDING, sizeof(pArgs->nRecord));
+		if (err != SUCCESS)
+		{
+			OscLog(DEBUG, "CGI: Error setting option! (%d)\n", err);
+			return err;
+		}
+	}
+
 	if (pArgs->bExposureTime_supplied)
 	{
 		err = OscIpcSetParam(cgi.ipcChan, &pArgs->nExposureTime, SET_EXPOSURE_TIME, sizeof(pArgs->nExposureTime));
@@ -237,27 +471,459 @@ static OSC_ERR SetOptions()
 static void FormCGIResponse()
 {
 	struct APPLICATION_STATE  *pAppState = &cgi.appState;
+	int i;
 
 	/* Header */
-	printf("Content-type: text/plain\n\n" );
+	CgiPrintf("Content-type: text/plain\n\n" );
+
+	CgiPrintf("imgTS: %u\n", (unsigned int)pAppState->imageTimeStamp);
+	CgiPrintf("exposureTime: %d\n", pAppState->nExposureTime);
+	CgiPrintf("AutoExposure: %d\n", pAppState->bAutoExposure);
+	CgiPrintf("ShutterWidth: %d\n", pAppState->nShutterWidth);
+	CgiPrintf("Brightness: %d\n", pAppState->nBrightness);
+	CgiPrintf("Threshold: %d\n", pAppState->nThreshold);
+	CgiPrintf("DetectLevel: %d\n", pAppState->nDetectLevel);
+	CgiPrintf("MorphOp: %d\n", pAppState->nMorphOp);
+	CgiPrintf("MinArea: %d\n", pAppState->nMinArea);
+	CgiPrintf("BandThreads: %d\n", pAppState->nBandThreads);
+	CgiPrintf("RoiForeground: %u\n", pAppState->nRoiForeground);
+#if NUM_COLORS == 1
+	CgiPrintf("RoiMean: %d\n", pAppState->nRoiMean[0]);
+#else
+	CgiPrintf("RoiMean: %d %d %d\n", pAppState->nRoiMean[0], pAppState->nRoiMean[1], pAppState->nRoiMean[2]);
+#endif
+	CgiPrintf("Stepcounter: %d\n", pAppState->nStepCounter);
+	CgiPrintf("FrameSeq: %u\n", pAppState->nFrameSeq);
+	if (cgi.bSnapshotValid)
+	{
+		CgiPrintf("SnapshotSeq: %u\n", (unsigned int)cgi.snapshot.nSeq);
+		CgiPrintf("SnapshotType: %u\n", (unsigned int)cgi.snapshot.nImageType);
+		CgiPrintf("SnapshotStep: %u\n", (unsigned int)cgi.snapshot.nStepCounter);
+		CgiPrintf("SnapshotFile: %s\n", cgi.strSnapshotFile);
+	}
+	CgiPrintf("DroppedFrames: %u\n", pAppState->nDroppedFrames);
+	CgiPrintf("SkippedFrames: %u\n", pAppState->nSkippedFrames);
+	CgiPrintf("IdleFrames: %u\n", pAppState->nIdleFrames);
+	CgiPrintf("Lateness: %d\n", pAppState->nLateness);
+	CgiPrintf("MaxLateness: %d\n", pAppState->nMaxLateness);
+	CgiPrintf("ProcessTime: %u\n", pAppState->nProcessTime);
+	CgiPrintf("BeltPosition: %u\n", pAppState->nBeltPosition);
+	CgiPrintf("EncoderMaxRate: %u\n", pAppState->nEncoderMaxRate);
+	CgiPrintf("EjectDistance: %u\n", pAppState->nEjectDistance);
+	CgiPrintf("width: %d\n", OSC_CAM_MAX_IMAGE_WIDTH/2);
+	CgiPrintf("height: %d\n", OSC_CAM_MAX_IMAGE_HEIGHT/2);
+	CgiPrintf("ImageType: %u\n", pAppState->nImageType);
+	CgiPrintf("ObjectClass: %d\n", pAppState->nObjectClass);
+	CgiPrintf("Recordings: %u %u %d\n", pAppState->nRecordings, pAppState->nRecordingsMissed, pAppState->bRecorderBusy);
+	CgiPrintf("Lanes: %u\n", pAppState->nLanes);
+	for (i = 0; i < cgi.lanesInfo.nLanes; i++)
+	{
+		const struct LANE_STATS *pLane = &cgi.lanesInfo.lanes[i];
+		CgiPrintf("Lane%d: %d %u %u %u %u %d %d\n", i + 1, pLane->bRunning,
+				pLane->nFrames, pLane->nFramesPerSecond, pLane->nProcessTime,
+				pLane->nMaxProcessTime, pLane->bForeground, pLane->nObjectClass);
+	}
 
-	printf("imgTS: %u\n", (unsigned int)pAppState->imageTimeStamp);
-	printf("exposureTime: %d\n", pAppState->nExposureTime);
-	printf("Threshold: %d\n", pAppState->nThreshold);
-	printf("Stepcounter: %d\n", pAppState->nStepCounter);
-	printf("width: %d\n", OSC_CAM_MAX_IMAGE_WIDTH/2);
-	printf("height: %d\n", OSC_CAM_MAX_IMAGE_HEIGHT/2);
-	printf("ImageType: %u\n", pAppState->nImageType);
+}
 
-	fflush(stdout);
+/*********************************************************************//*!
+ * @brief Print the production counters of one second (or the totals).
+ *//*********************************************************************/
+static void PrintStatsSecond(const char *strName, const struct STATS_SECOND *pSecond)
+{
+	int i;
+
+	CgiPrintf("%s: %u %u", strName, pSecond->nSecond, pSecond->nFrames);
+	for (i = 0; i <= OBJ_CLASS_OTHER; i++)
+	{
+		CgiPrintf(" %u", pSecond->nObjects[i]);
+	}
+	CgiPrintf(" %u %u %u %u %u\n", pSecond->nEjections, pSecond->nEjectionsDropped,
+			pSecond->nRegions, pSecond->nForegroundPermille, pSecond->nFramesMeasured);
 }
 
-OscFunction(mainFunction)
+/*********************************************************************//*!
+ * @brief Answer with the production statistics of the last seconds
+ * instead of the state.
+ *
+ * Each line holds the second, the frames received, the objects per class
+ * (none, white, red, other), the ejections fired and dropped, the
+ * regions and foreground per mille summed over the measured frames and
+ * the number of those.
+ *//*********************************************************************/
+static OSC_ERR FormStatsResponse()
+{
 	OSC_ERR err;
+	char strName[24];
+	uint32 i;
+
+	err = OscIpcGetParam(cgi.ipcChan, &cgi.statsHistory, GET_STATS_HISTORY, sizeof(struct STATS_HISTORY));
+	if (err != SUCCESS)
+	{
+		OscLog(ERROR, "CGI: Getting the statistics failed! (%d)\n", err);
+		return err;
+	}
+
+	CgiPrintf("Content-type: text/plain\n\n" );
+	PrintStatsSecond("Total", &cgi.statsHistory.total);
+	for (i = 0; i < cgi.statsHistory.nSeconds; i++)
+	{
+		sprintf(strName, "Second%u", (unsigned int)i);
+		PrintStatsSecond(strName, &cgi.statsHistory.seconds[i]);
+	}
+	return SUCCESS;
+}
+
+/*********************************************************************//*!
+ * @brief Microseconds of a monotonic clock.
+ *//*********************************************************************/
+static uint64 MicroSecs()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+/*********************************************************************//*!
+ * @brief Wait until the application processed a new frame or the time
+ * is up, polling nFrameSeq; the IPC channel of the application is not
+ * held meanwhile.
+ *
+ * @param ms Time to wait at most in milli seconds (cut to
+ * MAX_WAIT_NEW_FRAME_MS).
+ * @return SUCCESS also if no frame came in time, or an appropriate error
+ * code otherwise.
+ *//*********************************************************************/
+static OSC_ERR WaitNewFrame(int ms)
+{
+	OSC_ERR err;
+	uint64 start = MicroSecs();
+	uint32 nFrameSeq;
+
+	if (ms > MAX_WAIT_NEW_FRAME_MS)
+	{
+		ms = MAX_WAIT_NEW_FRAME_MS;
+	}
+	/* The next frame is debayered in full for the waiting client. */
+	err = OscIpcSetParam(cgi.ipcChan, &ms, WAIT_NEW_FRAME, sizeof(ms));
+	if (err == SUCCESS)
+	{
+		err = OscIpcGetParam(cgi.ipcChan, &cgi.appState, GET_APP_STATE, sizeof(struct APPLICATION_STATE));
+	}
+	nFrameSeq = cgi.appState.nFrameSeq;
+	while (err == SUCCESS && cgi.appState.nFrameSeq == nFrameSeq &&
+			MicroSecs() - start < (uint64)ms*1000)
+	{
+		usleep(WAIT_POLL_US);
+		err = OscIpcGetParam(cgi.ipcChan, &cgi.appState, GET_APP_STATE, sizeof(struct APPLICATION_STATE));
+	}
+	return err;
+}
+
+/*********************************************************************//*!
+ * @brief Serve one request: cgi.strArgumentsRaw holds its arguments, the
+ * answer is left in cgi.strResponse.
+ *
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+static OSC_ERR HandleRequest()
+{
+	OSC_ERR err;
+
+	/* Only what a request fills in is reset, not the image buffer. */
+	memset(&cgi.args, 0, sizeof(cgi.args));
+	cgi.lanesInfo.nLanes = 0;
+	cgi.bSnapshotValid = FALSE;
+	cgi.nResponseLen = 0;
+
+	err = CGIParseArguments();
+	if (err != SUCCESS)
+	{
+		return err;
+	}
+
+	/* Dashboards fetch the statistics of the last seconds at once. */
+	if (cgi.args.bStats_supplied && cgi.args.nStats != 0)
+	{
+		return FormStatsResponse();
+	}
+
+	/* The preview holds the request until the next frame is processed
+	 * instead of polling from the browser; if none comes in time the
+	 * answer is the unchanged state. */
+	if (cgi.args.bWait_supplied && cgi.args.nWait > 0)
+	{
+		err = WaitNewFrame(cgi.args.nWait);
+		if (err != SUCCESS)
+		{
+			OscLog(ERROR, "CGI: Error waiting for a frame! (%d)\n", err);
+			return err;
+		}
+	}
+
+	/* The algorithm negative acknowledges if it cannot supply
+	 * the requested data, i.e. it changed state during the
+	 * process of getting the data.
+	 * Try again until we succeed. A snapshot is answered in any
+	 * state, so its refusal is final. */
+	do
+	{
+		err = QueryApp();
+	} while (err == -ENEGATIVE_ACKNOWLEDGE && !cgi.args.bSnapshot_supplied);
+
+	if (err != SUCCESS)
+	{
+		OscLog(ERROR, "CGI: Error querying algorithm! (%d)\n", err);
+		return err;
+	}
+	/* The settings negative acknowledge values they refuse; asking
+	 * again does not help. */
+	err = SetOptions();
+	if (err != SUCCESS)
+	{
+		return err;
+	}
+	FormCGIResponse();
+	return SUCCESS;
+}
+
+/*! @brief The HTTP status a request failing with an error is answered
+ * with. */
+struct ERROR_STATUS
+{
+	OSC_ERR err;
+	const char *strStatus;
+	/*! @brief Whether the IPC channel is registered again, because the
+	 * application may have been restarted. */
+	bool bReconnect;
+};
+
+/*! @brief The errors of a request; any other is a failure of the IPC
+ * with the application (502). */
+static const struct ERROR_STATUS errorStatus[] = {
+	/* The arguments cannot be parsed. */
+	{ -EINVALID_PARAMETER, "400 Bad Request", FALSE },
+	/* The application refused a setting. */
+	{ -ENEGATIVE_ACKNOWLEDGE, "422 Unprocessable Entity", FALSE },
+	/* The frame of a snapshot is no longer kept. */
+	{ -ENO_MSG_AVAIL, "410 Gone", FALSE },
+	/* The image cannot be written for the web server. */
+	{ -EUNABLE_TO_OPEN_FILE, "500 Internal Server Error", FALSE },
+	{ -EFILE_ERROR, "500 Internal Server Error", FALSE },
+	{ -EOUT_OF_MEMORY, "500 Internal Server Error", FALSE },
+	{ -EBUFFER_TOO_SMALL, "500 Internal Server Error", FALSE },
+	/* The application did not answer in time. */
+	{ -ETIMEOUT, "504 Gateway Timeout", TRUE },
+	/* The application is not running. */
+	{ -EDEVICE, "503 Service Unavailable", TRUE }
+};
+
+/*********************************************************************//*!
+ * @brief Look up the HTTP status of an error of a request.
+ *//*********************************************************************/
+static const struct ERROR_STATUS *ErrorStatus(OSC_ERR err)
+{
+	static const struct ERROR_STATUS badGateway = { 0, "502 Bad Gateway", TRUE };
+	uint32 i;
+
+	for (i = 0; i < sizeof(errorStatus)/sizeof(errorStatus[0]); i++)
+	{
+		if (errorStatus[i].err == err)
+		{
+			return &errorStatus[i];
+		}
+	}
+	return &badGateway;
+}
+
+/*********************************************************************//*!
+ * @brief Serve the requests of the web server over FastCGI with the
+ * framework and the IPC channel kept open.
+ *
+ * The channel is registered again after an error, so the worker
+ * survives a restart of the application.
+ *
+ * @param strPath Path of the socket to listen on.
+ * @return Only on an error setting up the socket.
+ *//*********************************************************************/
+static OSC_ERR RunWorker(const char *strPath)
+{
+	const struct ERROR_STATUS *pStatus;
+	char strError[128];
+	struct FCGI_REQUEST req;
 	struct stat socketStat;
+	bool bRegistered = FALSE;
+	int fdListen;
+	OSC_ERR err;
 
-	/* Initialize */
-	memset(&cgi, 0, sizeof(struct CGI_TEMPLATE));
+	err = FcgiListen(strPath, &fdListen);
+	if (err != SUCCESS)
+	{
+		OscLog(ERROR, "CGI: Unable to listen on %s!\n", strPath);
+		return err;
+	}
+
+	req.strInput = cgi.strArgumentsRaw;
+	req.inputSize = sizeof(cgi.strArgumentsRaw);
+	for (;;)
+	{
+		req.fd = accept(fdListen, NULL, NULL);
+		if (req.fd < 0)
+		{
+			continue;
+		}
+		while (FcgiReadRequest(&req) == SUCCESS)
+		{
+			if (!bRegistered && stat(USER_INTERFACE_SOCKET_PATH, &socketStat) == 0)
+			{
+				bRegistered = OscIpcRegisterChannel(&cgi.ipcChan, USER_INTERFACE_SOCKET_PATH, 0) == SUCCESS;
+				/* A restarted application counts its frames from 1 again. */
+				memset(cgi.nSnapshotFileSeq, 0, sizeof(cgi.nSnapshotFileSeq));
+			}
+
+			err = bRegistered ? HandleRequest() : -EDEVICE;
+			if (err == SUCCESS)
+			{
+				err = FcgiWriteResponse(&req, cgi.strResponse, cgi.nResponseLen);
+			}
+			else
+			{
+				pStatus = ErrorStatus(err);
+				if (bRegistered && pStatus->bReconnect)
+				{
+					OscIpcUnregisterChannel(cgi.ipcChan);
+					bRegistered = FALSE;
+				}
+				err = FcgiWriteResponse(&req, strError, snprintf(strError, sizeof(strError),
+						"Status: %s\nContent-type: text/plain\n\nError %d\n", pStatus->strStatus, err));
+			}
+			if (err != SUCCESS || !req.bKeepConn)
+			{
+				break;
+			}
+		}
+		close(req.fd);
+	}
+	return SUCCESS;
+}
+
+/*********************************************************************//*!
+ * @brief Run the CGI in a process of its own, as the web server does.
+ *
+ * @return SUCCESS if the CGI answered.
+ *//*********************************************************************/
+static OSC_ERR RunCgiProcess(const char *strSelf)
+{
+	int fdIn[2], fdOut[2], status;
+	pid_t pid;
+
+	if (pipe(fdIn) != 0)
+	{
+		return -EDEVICE;
+	}
+	if (pipe(fdOut) != 0)
+	{
+		close(fdIn[0]);
+		close(fdIn[1]);
+		return -EDEVICE;
+	}
+	/* No fork on uClinux. */
+	pid = vfork();
+	if (pid == 0)
+	{
+		dup2(fdIn[0], STDIN_FILENO);
+		dup2(fdOut[1], STDOUT_FILENO);
+		close(fdIn[1]);
+		close(fdOut[0]);
+		execl(strSelf, strSelf, (char*)NULL);
+		_exit(127);
+	}
+	close(fdIn[0]);
+	close(fdOut[1]);
+	/* No arguments: stdin is empty. */
+	close(fdIn[1]);
+	while (pid > 0 && read(fdOut[0], cgi.strResponse, sizeof(cgi.strResponse)) > 0)
+	{
+	}
+	close(fdOut[0]);
+	if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+	{
+		return -EDEVICE;
+	}
+	return SUCCESS;
+}
+
+/*********************************************************************//*!
+ * @brief Compare the latency of a request to a CGI process with the one
+ * to the FastCGI worker (which has to be running).
+ *
+ * @param strSelf Path of this binary.
+ * @param nRequests Requests per variant.
+ *//*********************************************************************/
+static void RunLatencyBenchmark(const char *strSelf, int nRequests)
+{
+	uint64 t, dt, sum, max;
+	uint32 len;
+	int i, nFailed;
+
+	for (i = 0, sum = max = 0, nFailed = 0; i < nRequests; i++)
+	{
+		t = MicroSecs();
+		if (RunCgiProcess(strSelf) != SUCCESS)
+		{
+			nFailed++;
+		}
+		dt = MicroSecs() - t;
+		sum += dt;
+		max = dt > max ? dt : max;
+	}
+	printf("cgi:     %d requests, %d failed, mean %u us, max %u us\n", nRequests, nFailed,
+			(unsigned int)(sum/nRequests), (unsigned int)max);
+
+	for (i = 0, sum = max = 0, nFailed = 0; i < nRequests; i++)
+	{
+		t = MicroSecs();
+		if (FcgiClientRequest(FCGI_SOCKET_PATH, "", cgi.strResponse, sizeof(cgi.strResponse), &len) != SUCCESS ||
+				strncmp(cgi.strResponse, "Status: ", 8) == 0)
+		{
+			nFailed++;
+		}
+		dt = MicroSecs() - t;
+		sum += dt;
+		max = dt > max ? dt : max;
+	}
+	printf("fastcgi: %d requests, %d failed, mean %u us, max %u us\n", nRequests, nFailed,
+			(unsigned int)(sum/nRequests), (unsigned int)max);
+}
+
+OscFunction(mainFunction, const int argc, const char * argv[])
+	OSC_ERR err;
+	struct stat socketStat;
+	ssize_t len, n;
+
+	/* -b [n] compares the request latency of the CGI with the one of the
+	 * worker. */
+	if (argc > 1 && strcmp(argv[1], "-b") == 0)
+	{
+		RunLatencyBenchmark(argv[0], argc > 2 ? atoi(argv[2]) : 100);
+		return SUCCESS;
+	}
+
+	/* -f [socket] serves the requests as a persistent FastCGI worker. */
+	if (argc > 1 && strcmp(argv[1], "-f") == 0)
+	{
+		OscCall(OscCreate,
+			&OscModule_log,
+			&OscModule_ipc);
+
+		OscLogSetConsoleLogLevel(CRITICAL);
+		OscLogSetFileLogLevel(DEBUG);
+
+		OscCall( RunWorker, argc > 2 ? argv[2] : FCGI_SOCKET_PATH);
+		OscDestroy();
+		return SUCCESS;
+	}
 
 	/* First, check if the algorithm is even running and ready for IPC
 	 * by looking if its socket exists.*/
@@ -280,23 +946,18 @@ OscFunction(mainFunction)
 
 	OscCall( OscIpcRegisterChannel, &cgi.ipcChan, USER_INTERFACE_SOCKET_PATH, 0);
 
-	OscCall( CGIParseArguments);
-
-	/* The algorithm negative acknowledges if it cannot supply
-	 * the requested data, i.e. it changed state during the
-	 * process of getting the data.
-	 * Try again until we succeed. */
-	do
+	/* The arguments come in on stdin. */
+	len = 0;
+	while ((n = read(STDIN_FILENO, cgi.strArgumentsRaw + len, sizeof(cgi.strArgumentsRaw) - 1 - len)) > 0)
 	{
-		do
-		{
-			err = QueryApp();
-		} while (err == -ENEGATIVE_ACKNOWLEDGE);
+		len += n;
+	}
+	cgi.strArgumentsRaw[len] = 0;
 
-		OscAssert_m( err == SUCCESS, "Error querying algorithm!");
-		err = SetOptions();
-	} while (err == -ENEGATIVE_ACKNOWLEDGE);
-	FormCGIResponse();
+	err = HandleRequest();
+	OscAssert_m( err == SUCCESS, "Error handling the request!");
+	fwrite(cgi.strResponse, 1, cgi.nResponseLen, stdout);
+	fflush(stdout);
 
 	OscDestroy();
 
@@ -311,10 +972,9 @@ OscFunctionEnd()
 	 * Handles initialization, control and unloading.
 	 * @return 0 on success, -1 otherwise
 	 *//*********************************************************************/
-int main(void) {
-	if (mainFunction() == SUCCESS)
+int main(const int argc, const char * argv[]) {
+	if (mainFunction(argc, argv) == SUCCESS)
 		return 0;
 	else
 		return 1;
 }
-
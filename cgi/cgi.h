@@ -21,8 +21,27 @@
  * argument. */
 #define MAX_ARG_NAME_LEN 32
 
+/*! @brief The longest answer to a request. */
+#define MAX_RESPONSE_LEN 8192
+
 /*! @brief The file name of the live image. */
 #define IMG_FN "../image.bmp"
+/*! @brief The directory the web server serves the images from. */
+#define SNAPSHOT_DIR "../"
+/*! @brief The file name of a snapshot of an image type and frame (c.f.
+ * GET_SNAPSHOT); the frames share SNAPSHOT_FILES files per image type by
+ * their sequence number. */
+#define SNAPSHOT_FN "image%d_%u.bmp"
+/*! @brief Number of files per image type; a file is replaced by the
+ * frame SNAPSHOT_FILES sequence numbers later, so a client has that many
+ * frames of others' time to load its image. */
+#define SNAPSHOT_FILES 4
+/*! @brief Interval in micro seconds nFrameSeq is polled at while a
+ * request waits for a new frame (c.f. MAX_WAIT_NEW_FRAME_MS): a frame is
+ * seen up to this late, for at most MAX_WAIT_NEW_FRAME_MS*1000/WAIT_POLL_US
+ * (25) requests into the frame loop per preview image; one frame period
+ * of the camera (CAM_FRAME_RATE 50). */
+#define WAIT_POLL_US 20000
 
 /* @brief The different data types of the argument string. */
 enum EnArgumentType
@@ -61,11 +80,72 @@ struct ARGUMENT_DATA
 	/*! @brief Says whether the argument threshold has been
 	 * supplied or not. */
 	bool bThreshold_supplied;
+	/*! @brief pyramid level detection runs on.*/
+	int nDetectLevel;
+	/*! @brief Says whether the argument DetectLevel has been
+	 * supplied or not. */
+	bool bDetectLevel_supplied;
+	/*! @brief operator cleaning up the foreground mask.*/
+	int nMorphOp;
+	/*! @brief Says whether the argument MorphOp has been
+	 * supplied or not. */
+	bool bMorphOp_supplied;
+	/*! @brief minimal area of a region.*/
+	int nMinArea;
+	/*! @brief Says whether the argument MinArea has been
+	 * supplied or not. */
+	bool bMinArea_supplied;
+	/*! @brief threads a frame is split among.*/
+	int nBandThreads;
+	/*! @brief Says whether the argument BandThreads has been
+	 * supplied or not. */
+	bool bBandThreads_supplied;
+	/*! @brief automatic exposure on (1) or off (0).*/
+	int nAutoExposure;
+	/*! @brief Says whether the argument AutoExposure has been
+	 * supplied or not. */
+	bool bAutoExposure_supplied;
+	/*! @brief encoder pulses from the camera to the ejector.*/
+	int nEjectDistance;
+	/*! @brief Says whether the argument EjectDistance has been
+	 * supplied or not. */
+	bool bEjectDistance_supplied;
+	/*! @brief non-zero to answer with the production statistics.*/
+	int nStats;
+	/*! @brief Says whether the argument Stats has been
+	 * supplied or not. */
+	bool bStats_supplied;
+	/*! @brief milli seconds to wait for the next processed frame.*/
+	int nWait;
+	/*! @brief Says whether the argument Wait has been
+	 * supplied or not. */
+	bool bWait_supplied;
+	/*! @brief non-zero to trigger a black-box recording.*/
+	int nRecord;
+	/*! @brief Says whether the argument Record has been
+	 * supplied or not. */
+	bool bRecord_supplied;
+	/*! @brief region of interest (position and size).*/
+	int nRoiX, nRoiY, nRoiWidth, nRoiHeight;
+	/*! @brief Says whether the arguments RoiX, RoiY, RoiWidth and
+	 * RoiHeight have been supplied or not. */
+	bool bRoiX_supplied, bRoiY_supplied, bRoiWidth_supplied, bRoiHeight_supplied;
 	/*! @brief index of image to be sent via cgi to webserver.*/
 	int nImageType;
 	/*! @brief Says whether the argument ImageType has been
 	 * supplied or not. */
 	bool bImageType_supplied;
+	/*! @brief image type to fetch a snapshot of.*/
+	int nSnapshot;
+	/*! @brief Says whether the argument Snapshot has been
+	 * supplied or not. */
+	bool bSnapshot_supplied;
+	/*! @brief sequence number of the frame of the snapshot (0: the last
+	 * processed one).*/
+	int nSeq;
+	/*! @brief Says whether the argument Seq has been
+	 * supplied or not. */
+	bool bSeq_supplied;
 };
 
 /*! @brief Main object structure of the CGI. Contains all 'global'
@@ -79,12 +159,28 @@ struct CGI_TEMPLATE
 	char strArgumentsRaw[MAX_ARGUMENT_STRING_LEN];
 	/*! @brief Temporary variable for argument extraction. */
 	char strArgumentsTemp[MAX_ARGUMENT_STRING_LEN];
+	/*! @brief The answer to the current request. */
+	char strResponse[MAX_RESPONSE_LEN];
+	/*! @brief Length of strResponse. */
+	uint32 nResponseLen;
 
 	/*! @brief The state queried from the application. */
 	struct APPLICATION_STATE appState;
+	/*! @brief The results of the lanes besides the camera. */
+	struct LANES_INFO lanesInfo;
+	/*! @brief The production statistics of the last seconds. */
+	struct STATS_HISTORY statsHistory;
 	/*! @brief The GET/POST arguments of the CGI. */
 	struct ARGUMENT_DATA    args;
-	/*! @brief Temporary data buffer for the images to be saved. */
-	uint8 imgBuf[NUM_COLORS*OSC_CAM_MAX_IMAGE_WIDTH*OSC_CAM_MAX_IMAGE_HEIGHT];
+	/*! @brief The snapshot fetched by the current request; its data is
+	 * also the buffer of the live image. */
+	struct SNAPSHOT snapshot;
+	/*! @brief Whether snapshot holds an image of the current request. */
+	bool bSnapshotValid;
+	/*! @brief The file name of snapshot relative to SNAPSHOT_DIR. */
+	char strSnapshotFile[32];
+	/*! @brief The sequence number of the frame in each snapshot file, 0
+	 * for none yet. */
+	uint32 nSnapshotFileSeq[SNAPSHOT_NUM_TYPES][SNAPSHOT_FILES];
 };
 #endif /*CGI_TEMPLATE_H_*/
@@ -0,0 +1,346 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file fcgi.c
+ * @brief The part of the FastCGI protocol a persistent responder needs,
+ * over a unix domain socket.
+ */
+
+#include "fcgi.h"
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/*! @brief Version of the protocol. */
+#define FCGI_VERSION_1 1
+
+/*! @brief Record types. */
+enum EnFcgiType
+{
+	FCGI_BEGIN_REQUEST = 1,
+	FCGI_ABORT_REQUEST = 2,
+	FCGI_END_REQUEST = 3,
+	FCGI_PARAMS = 4,
+	FCGI_STDIN = 5,
+	FCGI_STDOUT = 6,
+	FCGI_GET_VALUES = 9,
+	FCGI_GET_VALUES_RESULT = 10,
+	FCGI_UNKNOWN_TYPE = 11
+};
+
+/*! @brief Role of the application in FCGI_BEGIN_REQUEST. */
+#define FCGI_RESPONDER 1
+/*! @brief Flag of FCGI_BEGIN_REQUEST to keep the connection. */
+#define FCGI_KEEP_CONN 1
+
+/*! @brief Protocol status of FCGI_END_REQUEST. */
+enum EnFcgiStatus
+{
+	FCGI_REQUEST_COMPLETE = 0,
+	FCGI_CANT_MPX_CONN = 1,
+	FCGI_UNKNOWN_ROLE = 3
+};
+
+/*! @brief Header of a record. */
+struct FCGI_HEADER
+{
+	uint8 version;
+	uint8 type;
+	uint8 requestIdB1;
+	uint8 requestIdB0;
+	uint8 contentLengthB1;
+	uint8 contentLengthB0;
+	uint8 paddingLength;
+	uint8 reserved;
+};
+
+/*! @brief Content of a record as read; the largest content plus the
+ * largest padding. */
+static uint8 recordContent[FCGI_MAX_CONTENT + 255];
+
+/*! @brief Answer to FCGI_GET_VALUES: one request at a time. */
+static const uint8 getValuesResult[] = {
+	14, 1, 'F', 'C', 'G', 'I', '_', 'M', 'A', 'X', '_', 'C', 'O', 'N', 'N', 'S', '1',
+	13, 1, 'F', 'C', 'G', 'I', '_', 'M', 'A', 'X', '_', 'R', 'E', 'Q', 'S', '1',
+	15, 1, 'F', 'C', 'G', 'I', '_', 'M', 'P', 'X', 'S', '_', 'C', 'O', 'N', 'N', 'S', '0'
+};
+
+/*********************************************************************//*!
+ * @brief Read exactly len bytes.
+ *//*********************************************************************/
+static OSC_ERR ReadFull(int fd, void *pData, uint32 len)
+{
+	uint8 *p = (uint8*)pData;
+	ssize_t n;
+
+	while (len > 0)
+	{
+		n = read(fd, p, len);
+		if (n < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (n <= 0)
+		{
+			return -EFILE_ERROR;
+		}
+		p += n;
+		len -= n;
+	}
+	return SUCCESS;
+}
+
+/*********************************************************************//*!
+ * @brief Write exactly len bytes.
+ *//*********************************************************************/
+static OSC_ERR WriteFull(int fd, const void *pData, uint32 len)
+{
+	const uint8 *p = (const uint8*)pData;
+	ssize_t n;
+
+	while (len > 0)
+	{
+		n = write(fd, p, len);
+		if (n < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (n <= 0)
+		{
+			return -EFILE_ERROR;
+		}
+		p += n;
+		len -= n;
+	}
+	return SUCCESS;
+}
+
+/*********************************************************************//*!
+ * @brief Write a record.
+ *//*********************************************************************/
+static OSC_ERR WriteRecord(int fd, uint8 type, uint16 id, const void *pContent, uint16 len)
+{
+	struct FCGI_HEADER header;
+
+	header.version = FCGI_VERSION_1;
+	header.type = type;
+	header.requestIdB1 = id >> 8;
+	header.requestIdB0 = id & 0xff;
+	header.contentLengthB1 = len >> 8;
+	header.contentLengthB0 = len & 0xff;
+	header.paddingLength = 0;
+	header.reserved = 0;
+	if (WriteFull(fd, &header, sizeof(header)) != SUCCESS)
+	{
+		return -EFILE_ERROR;
+	}
+	return WriteFull(fd, pContent, len);
+}
+
+/*********************************************************************//*!
+ * @brief End a request with the given protocol status.
+ *//*********************************************************************/
+static OSC_ERR WriteEndRequest(int fd, uint16 id, uint8 status)
+{
+	uint8 body[8] = { 0, 0, 0, 0, status, 0, 0, 0 };
+
+	return WriteRecord(fd, FCGI_END_REQUEST, id, body, sizeof(body));
+}
+
+/*********************************************************************//*!
+ * @brief Read a record.
+ *
+ * @return SUCCESS or -EFILE_ERROR; the content is left in
+ * recordContent.
+ *//*********************************************************************/
+static OSC_ERR ReadRecord(int fd, uint8 *pType, uint16 *pId, uint16 *pLen)
+{
+	struct FCGI_HEADER header;
+
+	if (ReadFull(fd, &header, sizeof(header)) != SUCCESS || header.version != FCGI_VERSION_1)
+	{
+		return -EFILE_ERROR;
+	}
+	*pType = header.type;
+	*pId = (header.requestIdB1 << 8) | header.requestIdB0;
+	*pLen = (header.contentLengthB1 << 8) | header.contentLengthB0;
+	return ReadFull(fd, recordContent, *pLen + header.paddingLength);
+}
+
+OSC_ERR FcgiListen(const char *strPath, int *pFd)
+{
+	struct sockaddr_un addr;
+
+	*pFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (*pFd < 0)
+	{
+		return -EDEVICE;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, strPath, sizeof(addr.sun_path) - 1);
+	/* A socket left over by an earlier worker is replaced. */
+	unlink(strPath);
+	if (bind(*pFd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(*pFd, 8) != 0)
+	{
+		close(*pFd);
+		return -EDEVICE;
+	}
+	return SUCCESS;
+}
+
+OSC_ERR FcgiReadRequest(struct FCGI_REQUEST *pReq)
+{
+	uint8 type;
+	uint16 id, len;
+	uint32 inputLen = 0;
+
+	pReq->id = 0;
+	for (;;)
+	{
+		if (ReadRecord(pReq->fd, &type, &id, &len) != SUCCESS)
+		{
+			return -EFILE_ERROR;
+		}
+
+		if (id == 0)
+		{
+			/* Management records. */
+			if (type == FCGI_GET_VALUES)
+			{
+				WriteRecord(pReq->fd, FCGI_GET_VALUES_RESULT, 0, getValuesResult, sizeof(getValuesResult));
+			}
+			else
+			{
+				uint8 body[8] = { type, 0, 0, 0, 0, 0, 0, 0 };
+				WriteRecord(pReq->fd, FCGI_UNKNOWN_TYPE, 0, body, sizeof(body));
+			}
+			continue;
+		}
+
+		switch (type)
+		{
+		case FCGI_BEGIN_REQUEST:
+			if (pReq->id != 0)
+			{
+				WriteEndRequest(pReq->fd, id, FCGI_CANT_MPX_CONN);
+			}
+			else if (((recordContent[0] << 8) | recordContent[1]) != FCGI_RESPONDER)
+			{
+				WriteEndRequest(pReq->fd, id, FCGI_UNKNOWN_ROLE);
+			}
+			else
+			{
+				pReq->id = id;
+				pReq->bKeepConn = (recordContent[2] & FCGI_KEEP_CONN) != 0;
+				inputLen = 0;
+			}
+			break;
+		case FCGI_ABORT_REQUEST:
+			if (id == pReq->id)
+			{
+				WriteEndRequest(pReq->fd, id, FCGI_REQUEST_COMPLETE);
+				pReq->id = 0;
+			}
+			break;
+		case FCGI_STDIN:
+			if (id != pReq->id)
+			{
+				break;
+			}
+			if (len == 0)
+			{
+				/* The end of stdin: the request is complete. */
+				pReq->strInput[inputLen] = 0;
+				return SUCCESS;
+			}
+			if (inputLen + len >= pReq->inputSize)
+			{
+				OscLog(WARN, "%s: Input of request %u cut!\n", __func__, id);
+				len = pReq->inputSize - 1 - inputLen;
+			}
+			memcpy(pReq->strInput + inputLen, recordContent, len);
+			inputLen += len;
+			break;
+		default:
+			/* The parameters are not needed. */
+			break;
+		}
+	}
+}
+
+OSC_ERR FcgiWriteResponse(struct FCGI_REQUEST *pReq, const char *pData, uint32 len)
+{
+	uint16 chunk;
+
+	while (len > 0)
+	{
+		chunk = len > FCGI_MAX_CONTENT ? FCGI_MAX_CONTENT : len;
+		if (WriteRecord(pReq->fd, FCGI_STDOUT, pReq->id, pData, chunk) != SUCCESS)
+		{
+			return -EFILE_ERROR;
+		}
+		pData += chunk;
+		len -= chunk;
+	}
+	if (WriteRecord(pReq->fd, FCGI_STDOUT, pReq->id, NULL, 0) != SUCCESS)
+	{
+		return -EFILE_ERROR;
+	}
+	return WriteEndRequest(pReq->fd, pReq->id, FCGI_REQUEST_COMPLETE);
+}
+
+OSC_ERR FcgiClientRequest(const char *strPath, const char *strInput, char *pResponse, uint32 size, uint32 *pLen)
+{
+	struct sockaddr_un addr;
+	uint8 begin[8] = { 0, FCGI_RESPONDER, 0, 0, 0, 0, 0, 0 };
+	uint8 type;
+	uint16 id, len;
+	uint32 inputLen = strlen(strInput);
+	OSC_ERR err = SUCCESS;
+	int fd;
+
+	*pLen = 0;
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+	{
+		return -EUNABLE_TO_OPEN_FILE;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, strPath, sizeof(addr.sun_path) - 1);
+	if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+	{
+		close(fd);
+		return -EUNABLE_TO_OPEN_FILE;
+	}
+
+	if (WriteRecord(fd, FCGI_BEGIN_REQUEST, 1, begin, sizeof(begin)) != SUCCESS ||
+			WriteRecord(fd, FCGI_PARAMS, 1, NULL, 0) != SUCCESS ||
+			(inputLen > 0 && WriteRecord(fd, FCGI_STDIN, 1, strInput, inputLen) != SUCCESS) ||
+			WriteRecord(fd, FCGI_STDIN, 1, NULL, 0) != SUCCESS)
+	{
+		close(fd);
+		return -EFILE_ERROR;
+	}
+
+	for (;;)
+	{
+		err = ReadRecord(fd, &type, &id, &len);
+		if (err != SUCCESS || type == FCGI_END_REQUEST)
+		{
+			break;
+		}
+		if (type == FCGI_STDOUT && *pLen + len <= size)
+		{
+			memcpy(pResponse + *pLen, recordContent, len);
+			*pLen += len;
+		}
+	}
+	close(fd);
+	return err;
+}
@@ -0,0 +1,84 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file fcgi.h
+ * @brief The part of the FastCGI protocol a persistent responder needs,
+ * over a unix domain socket.
+ *
+ * Requests are served one after the other; a web server trying to
+ * multiplex several requests over one connection is told so
+ * (FCGI_CANT_MPX_CONN). The parameters of a request are skipped, its
+ * stdin stream holds the arguments like the stdin of the CGI.
+ */
+
+#ifndef FCGI_H_
+#define FCGI_H_
+
+#include "oscar.h"
+
+/*! @brief Default path of the socket the worker listens on. */
+#define FCGI_SOCKET_PATH "/tmp/cgi.fcgi.sock"
+/*! @brief Largest content of a single record. */
+#define FCGI_MAX_CONTENT 65535
+
+/*! @brief A request read from the web server. */
+struct FCGI_REQUEST
+{
+	/*! @brief The connection to the web server. */
+	int fd;
+	/*! @brief FastCGI id of the request. */
+	uint16 id;
+	/*! @brief Whether the web server keeps the connection open after the
+	 * request. */
+	bool bKeepConn;
+	/*! @brief Receives the stdin stream, zero terminated. */
+	char *strInput;
+	/*! @brief Size of strInput; longer input is cut. */
+	uint32 inputSize;
+};
+
+/*********************************************************************//*!
+ * @brief Create the socket to accept the web server's connections on.
+ *
+ * @param strPath Path of the unix domain socket.
+ * @param pFd Receives the listening socket.
+ * @return SUCCESS or -EDEVICE.
+ *//*********************************************************************/
+OSC_ERR FcgiListen(const char *strPath, int *pFd);
+
+/*********************************************************************//*!
+ * @brief Read the records of a connection up to the end of the stdin
+ * stream of the next request, answering management records on the way.
+ *
+ * @param pReq The request; fd, strInput and inputSize are set by the
+ * caller.
+ * @return SUCCESS or -EFILE_ERROR when the connection is closed.
+ *//*********************************************************************/
+OSC_ERR FcgiReadRequest(struct FCGI_REQUEST *pReq);
+
+/*********************************************************************//*!
+ * @brief Send the answer to a request and end it.
+ *
+ * @param pReq The request.
+ * @param pData The answer (headers and body as written by a CGI).
+ * @param len Length of the answer.
+ * @return SUCCESS or -EFILE_ERROR.
+ *//*********************************************************************/
+OSC_ERR FcgiWriteResponse(struct FCGI_REQUEST *pReq, const char *pData, uint32 len);
+
+/*********************************************************************//*!
+ * @brief Send a request to a FastCGI responder and read its answer, as
+ * a web server would (used by the latency benchmark).
+ *
+ * @param strPath Path of the responder's socket.
+ * @param strInput The stdin stream of the request.
+ * @param pResponse Receives the answer.
+ * @param size Size of pResponse.
+ * @param pLen Receives the length of the answer.
+ * @return SUCCESS, -EUNABLE_TO_OPEN_FILE or -EFILE_ERROR.
+ *//*********************************************************************/
+OSC_ERR FcgiClientRequest(const char *strPath, const char *strInput, char *pResponse, uint32 size, uint32 *pLen);
+
+#endif /*FCGI_H_*/
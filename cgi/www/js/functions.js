@@ -365,8 +365,18 @@ function updateCycle() {
 	function online() {
 		stateControl.pullState("online");
 		
-		exchangeState("GetImage", { }, function (data) {
-			asynLoadImage("image.bmp?" + data.imgTS, function () {
+		// The answer comes as soon as the next frame is processed, with a
+		// snapshot of the image type shown here (other clients may show
+		// another one).
+		exchangeState("GetImage", { Wait: 500, Snapshot: inputValues.ImageType }, function (data) {
+			// No frame has been processed yet.
+			if (data.SnapshotSeq === undefined) {
+				$(document).oneTime("0.5s", online);
+				return;
+			}
+			
+			// The file holds this frame only (c.f. SNAPSHOT_FN).
+			asynLoadImage(data.SnapshotFile + "?" + data.SnapshotSeq, function () {
 				$(this).attr("id", "image");
 				$("#image").replaceWith(this);
 				
@@ -385,11 +395,6 @@ function updateCycle() {
 				offline();
 			});
 			
-			if (data.ImageType != inputValues.ImageType)
-				exchangeState("SetOptions", {
-					ImageType: inputValues.ImageType
-				});
-			
 			if (data.exposureTime != inputValues.exposureTime)
 				exchangeState("SetOptions", {
 					exposureTime: inputValues.exposureTime
@@ -0,0 +1,193 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file colorhist.c
+ * @brief Quantised per-region colour histograms and the colour
+ * classification based on them.
+ *
+ * The hue is computed in integer arithmetic only; the division by the
+ * chroma is replaced by a multiplication with a tabulated reciprocal,
+ * as the target has no hardware divider.
+ */
+
+#include "colorhist.h"
+#include <string.h>
+
+#if HIST_CHROMA_LEVELS != 2
+#error "The binning only supports two chroma levels."
+#endif
+#if HIST_NUM_BINS > 32
+#error "The bins of a colour class must fit into a 32 bit mask."
+#endif
+#if HIST_HUE_BINS % 6 != 0
+#error "The number of hue bins must be a multiple of six."
+#endif
+
+/*! @brief Number of hue bins per sixth of the colour circle. */
+#define HUE_SUB (HIST_HUE_BINS/6)
+
+/*! @brief Bit mask of the hue bin h on chroma level l. */
+#define HUE_BIT(l, h) (1UL << (HIST_ACHROMATIC_BINS + (l)*HIST_HUE_BINS + (h)))
+/*! @brief Bit mask of the achromatic bin a. */
+#define ACHROMATIC_BIT(a) (1UL << (a))
+
+/*! @brief One entry of the colour class table. */
+struct COLOR_CLASS
+{
+	/*! @brief The class described by this entry. */
+	enum EnObjectClass objClass;
+	/*! @brief The histogram bins belonging to the class. */
+	uint32 binMask;
+	/*! @brief Part of the pixels (per mille) that has to fall into the
+	 * bins for an object to be of this class. */
+	uint16 minPermille;
+};
+
+/*! @brief The colour classes; the first matching entry wins. */
+static const struct COLOR_CLASS colorClasses[] =
+{
+	/* Red: hue around 0 degrees on both chroma levels. */
+	{ OBJ_CLASS_RED,
+		HUE_BIT(0, 0) | HUE_BIT(0, HIST_HUE_BINS - 1) |
+		HUE_BIT(1, 0) | HUE_BIT(1, HIST_HUE_BINS - 1), 500 },
+	/* White: bright pixels without significant chroma. */
+	{ OBJ_CLASS_WHITE,
+		ACHROMATIC_BIT(HIST_ACHROMATIC_BINS - 1) | ACHROMATIC_BIT(HIST_ACHROMATIC_BINS - 2), 500 }
+};
+
+/*! @brief HUE_SUB/c in 16.16 fixed point for every chroma c. */
+static int32 hueRecip[256];
+
+void ColorHistInit()
+{
+	int c;
+
+	hueRecip[0] = 0;
+	for (c = 1; c < 256; c++)
+	{
+		hueRecip[c] = (HUE_SUB << 16)/c;
+	}
+}
+
+/*********************************************************************//*!
+ * @brief Return the histogram bin of a pixel.
+ *//*********************************************************************/
+#if NUM_COLORS == 1
+static inline uint8 HistBin(const uint8 *pImg, uint32 i, uint32 nPix)
+{
+	return (pImg[i]*HIST_ACHROMATIC_BINS) >> 8;
+}
+#else
+static inline uint8 HistBin(const uint8 *pImg, uint32 i, uint32 nPix)
+{
+	const int b = pImg[COLOR_INDEX(i, 0, nPix)];
+	const int g = pImg[COLOR_INDEX(i, 1, nPix)];
+	const int r = pImg[COLOR_INDEX(i, 2, nPix)];
+	int max, min, h;
+
+	if (r >= g && r >= b)
+	{
+		max = r;
+		min = g < b ? g : b;
+		h = ((g - b)*hueRecip[max - min]) >> 16;
+		if (h < 0)
+			h += HIST_HUE_BINS;
+	}
+	else if (g >= b)
+	{
+		max = g;
+		min = r < b ? r : b;
+		h = 2*HUE_SUB + (((b - r)*hueRecip[max - min]) >> 16);
+	}
+	else
+	{
+		max = b;
+		min = r < g ? r : g;
+		h = 4*HUE_SUB + (((r - g)*hueRecip[max - min]) >> 16);
+	}
+
+	if (max - min < HIST_CHROMA_MIN)
+		return (max*HIST_ACHROMATIC_BINS) >> 8;
+	if (max - min >= HIST_CHROMA_HIGH)
+		h += HIST_HUE_BINS;
+	return HIST_ACHROMATIC_BINS + h;
+}
+#endif
+
+void AccumulateRegionColor(const struct OSC_PICTURE *picIn, const struct OSC_VIS_REGIONS_OBJECT *pObject, uint8 scaleShift, struct REGION_COLOR *pCol)
+{
+	const uint8 *pImg = (const uint8*)picIn->data;
+	const uint16 width = picIn->width;
+	const uint32 nPix = (uint32)width*picIn->height;
+	const struct OSC_VIS_REGIONS_RUN *pRun = pObject->root;
+	uint16 c, cpl, row;
+
+	memset(pCol, 0, sizeof(struct REGION_COLOR));
+	while (pRun != NULL)
+	{
+		/* The run projected to the resolution of picIn. */
+		const uint16 startCol = pRun->startColumn << scaleShift;
+		const uint16 endCol = pRun->endColumn << scaleShift;
+		const uint16 startRow = pRun->row << scaleShift;
+		const uint16 endRow = (pRun->row + 1) << scaleShift;
+
+		for (row = startRow; row < endRow; row++)
+		{
+			uint32 i = (uint32)width*row + startCol;
+			for (c = startCol; c < endCol; c++, i++)
+			{
+				for (cpl = 0; cpl < NUM_COLORS; cpl++)
+				{
+					pCol->sum[cpl] += pImg[COLOR_INDEX(i, cpl, nPix)];
+				}
+				pCol->hist[HistBin(pImg, i, nPix)]++;
+			}
+		}
+		pCol->nPixels += (endCol - startCol)*(endRow - startRow);
+		pRun = pRun->next;
+	}
+}
+
+enum EnObjectClass ClassifyHistogram(const uint32 hist[HIST_NUM_BINS])
+{
+	uint32 total = 0;
+	int i, k;
+
+	for (i = 0; i < HIST_NUM_BINS; i++)
+	{
+		total += hist[i];
+	}
+	if (total == 0)
+		return OBJ_CLASS_NONE;
+
+	for (k = 0; k < sizeof(colorClasses)/sizeof(struct COLOR_CLASS); k++)
+	{
+		uint32 inClass = 0;
+		for (i = 0; i < HIST_NUM_BINS; i++)
+		{
+			if (colorClasses[k].binMask & (1UL << i))
+				inClass += hist[i];
+		}
+		/* inClass/total >= minPermille/1000 without a division. */
+		if ((uint64)inClass*1000 >= (uint64)total*colorClasses[k].minPermille)
+			return colorClasses[k].objClass;
+	}
+	return OBJ_CLASS_OTHER;
+}
+
+void HistToPermille(const uint32 hist[HIST_NUM_BINS], uint16 permille[HIST_NUM_BINS])
+{
+	uint32 total = 0;
+	int i;
+
+	for (i = 0; i < HIST_NUM_BINS; i++)
+	{
+		total += hist[i];
+	}
+	for (i = 0; i < HIST_NUM_BINS; i++)
+	{
+		permille[i] = total ? (uint16)(((uint64)hist[i]*1000)/total) : 0;
+	}
+}
@@ -0,0 +1,79 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file colorhist.h
+ * @brief Quantised per-region colour histograms and the colour
+ * classification based on them.
+ */
+#ifndef COLORHIST_H_
+#define COLORHIST_H_
+
+#include "template.h"
+
+/*! @brief Minimal chroma (max - min of the colour components) for a pixel
+ * to be counted in a hue bin instead of an achromatic bin. */
+#define HIST_CHROMA_MIN 24
+/*! @brief Chroma from which on a pixel is counted in the upper chroma
+ * level. */
+#define HIST_CHROMA_HIGH 96
+
+/*! @brief Maximum number of regions per frame colour statistics are
+ * kept for. Further regions are ignored. */
+#define MAX_REGION_COLORS 64
+
+/*! @brief Colour statistics of one region accumulated over its runs. */
+struct REGION_COLOR
+{
+	/*! @brief Sum of each colour plane over the region. */
+	uint32 sum[NUM_COLORS];
+	/*! @brief Number of pixels accumulated. */
+	uint32 nPixels;
+	/*! @brief Number of pixels falling into each histogram bin. */
+	uint32 hist[HIST_NUM_BINS];
+};
+
+/*********************************************************************//*!
+ * @brief Prepare the lookup tables used for the binning.
+ *
+ * Must be called once before any other function of this module.
+ *//*********************************************************************/
+void ColorHistInit();
+
+/*********************************************************************//*!
+ * @brief Accumulate colour sum and histogram of a single region.
+ *
+ * Walks the runs of the region once and reads each of its pixels exactly
+ * once. picIn is laid out as given by PLANAR_COLORS.
+ *
+ * The region may have been labeled on a coarser pyramid level than
+ * picIn; each run then covers a block of 2^scaleShift rows and columns
+ * of picIn per pixel.
+ *
+ * @param picIn The colour image to gather the statistics in.
+ * @param pObject The region.
+ * @param scaleShift log2 of the resolution ratio between picIn and the
+ * image the region was labeled in.
+ * @param pCol Receives the statistics.
+ *//*********************************************************************/
+void AccumulateRegionColor(const struct OSC_PICTURE *picIn, const struct OSC_VIS_REGIONS_OBJECT *pObject, uint8 scaleShift, struct REGION_COLOR *pCol);
+
+/*********************************************************************//*!
+ * @brief Classify a histogram using the colour class table.
+ *
+ * @param hist Histogram to classify.
+ * @return The first class whose bins hold enough of the pixels or
+ * OBJ_CLASS_OTHER; OBJ_CLASS_NONE for an empty histogram.
+ *//*********************************************************************/
+enum EnObjectClass ClassifyHistogram(const uint32 hist[HIST_NUM_BINS]);
+
+/*********************************************************************//*!
+ * @brief Convert a histogram to per mille of its total count.
+ *
+ * @param hist Histogram to convert.
+ * @param permille Output array.
+ *//*********************************************************************/
+void HistToPermille(const uint32 hist[HIST_NUM_BINS], uint16 permille[HIST_NUM_BINS]);
+
+#endif /*COLORHIST_H_*/
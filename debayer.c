@@ -0,0 +1,358 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file debayer.c
+ * @brief Debayering of the raw camera image to the formats used for
+ * processing.
+ *
+ * All Bayer orders are reduced to ROW_RGRG by exchanging the two rows
+ * and/or the two columns of a cell.
+ */
+
+#include "debayer.h"
+#include <string.h>
+
+/*! @brief Whether eight cells at a time are debayered with the vector
+ * extensions of the compiler. Needs __builtin_convertvector() and the
+ * byte order where the low byte of a 16 bit lane is the left pixel. */
+#if defined(__GNUC__) && __GNUC__ >= 9 && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define DEBAYER_VECTOR 1
+#else
+#define DEBAYER_VECTOR 0
+#endif
+
+const uint16 camGains[3] = { CAM_GAIN_BLUE, CAM_GAIN_GREEN, CAM_GAIN_RED };
+
+/*! @brief Forces a kernel to be inlined into each instance. */
+#define KERNEL static inline __attribute__((always_inline))
+
+/*********************************************************************//*!
+ * @brief Whether an output includes the luminance image.
+ *//*********************************************************************/
+KERNEL bool HasLuma(const enum EnDebayerOutput output)
+{
+	return output == DEBAYER_LUMA || output == DEBAYER_LUMA_BGR || output == DEBAYER_LUMA_BGR_PLANAR;
+}
+
+/*********************************************************************//*!
+ * @brief Whether an output includes a planar colour image.
+ *//*********************************************************************/
+KERNEL bool HasPlanar(const enum EnDebayerOutput output)
+{
+	return output == DEBAYER_BGR_PLANAR || output == DEBAYER_LUMA_BGR_PLANAR;
+}
+
+/*********************************************************************//*!
+ * @brief Scale a value by a gain and saturate it.
+ *//*********************************************************************/
+KERNEL int ApplyGain(int value, uint16 gain, int max)
+{
+	value = (value*gain) >> 8;
+	return value > max ? max : value;
+}
+
+/*********************************************************************//*!
+ * @brief Debayer the cells [x, end) of a row pair one after the other.
+ *
+ * @param pRG The row of the cell with red (in ROW_RGRG order).
+ * @param pGB The row of the cell with blue.
+ * @param bSwapCols Red is in the right column of a cell.
+ * @param i Index of the output pixel of cell x.
+ * @param nPix Number of pixels of the output images.
+ *//*********************************************************************/
+KERNEL void DebayerRowScalar(const uint8 *pRG, const uint8 *pGB, uint16 x, const uint16 end, const bool bSwapCols,
+		const enum EnDebayerOutput output, const uint16 *pGains, uint8 *pColor, uint8 *pLuma, uint32 i, const uint32 nPix)
+{
+	const int cR = bSwapCols ? 1 : 0, cB = 1 - cR;
+
+	for (; x < end; x++, i++)
+	{
+		int r = pRG[2*x + cR];
+		int gsum = pRG[2*x + cB] + pGB[2*x + cR];
+		int b = pGB[2*x + cB];
+
+		if (pGains != NULL)
+		{
+			b = ApplyGain(b, pGains[0], 255);
+			gsum = ApplyGain(gsum, pGains[1], 2*255);
+			r = ApplyGain(r, pGains[2], 255);
+		}
+		if (HasLuma(output))
+		{
+			pLuma[i] = (r + gsum + b) >> 2;
+		}
+		if (output == DEBAYER_LUMA)
+		{
+			continue;
+		}
+		if (HasPlanar(output))
+		{
+			pColor[i] = b;
+			pColor[nPix + i] = gsum >> 1;
+			pColor[2*nPix + i] = r;
+		}
+		else
+		{
+			pColor[3*i] = b;
+			pColor[3*i + 1] = gsum >> 1;
+			pColor[3*i + 2] = r;
+		}
+	}
+}
+
+#if DEBAYER_VECTOR
+/*! @brief Eight cells in 16 bit lanes. */
+typedef uint16 v8u16 __attribute__((vector_size(16)));
+/*! @brief Eight output pixels. */
+typedef uint8 v8u8 __attribute__((vector_size(8)));
+
+/*********************************************************************//*!
+ * @brief ApplyGain() for eight cells.
+ *
+ * Stays in 16 bit lanes: the gain is split into its integer part and
+ * its fraction and the value into its two bytes, so no product exceeds
+ * 16 bits for values up to 2*255 and gains below 16.0.
+ *//*********************************************************************/
+KERNEL v8u16 ApplyGainVector(v8u16 value, uint16 gain, uint16 max)
+{
+	const uint16 gainInt = gain >> 8, gainFrac = gain & 0xff;
+	v8u16 over;
+
+	value = value*gainInt + (value >> 8)*gainFrac + (((value & 0xff)*gainFrac) >> 8);
+	over = (v8u16)(value > max);
+	return (value & ~over) | (max & over);
+}
+
+/*********************************************************************//*!
+ * @brief Debayer the cells of a row pair eight at a time, as
+ * DebayerRowScalar() does.
+ *
+ * A 16 bit lane holds the two pixels of a row of a cell, so the columns
+ * are separated by a mask and a shift.
+ *
+ * @return The number of cells done, a multiple of eight.
+ *//*********************************************************************/
+KERNEL uint16 DebayerRowVector(const uint8 *pRG, const uint8 *pGB, const uint16 end, const bool bSwapCols,
+		const enum EnDebayerOutput output, const uint16 *pGains, uint8 *pColor, uint8 *pLuma, uint32 i, const uint32 nPix)
+{
+	uint16 x;
+	int k;
+
+	for (x = 0; x + 8 <= end; x += 8, i += 8)
+	{
+		v8u16 rowRG, rowGB, r, gsum, b;
+
+		memcpy(&rowRG, pRG + 2*x, sizeof(rowRG));
+		memcpy(&rowGB, pGB + 2*x, sizeof(rowGB));
+		if (bSwapCols)
+		{
+			r = rowRG >> 8;
+			gsum = (rowRG & 0xff) + (rowGB >> 8);
+			b = rowGB & 0xff;
+		}
+		else
+		{
+			r = rowRG & 0xff;
+			gsum = (rowRG >> 8) + (rowGB & 0xff);
+			b = rowGB >> 8;
+		}
+
+		if (pGains != NULL)
+		{
+			b = ApplyGainVector(b, pGains[0], 255);
+			gsum = ApplyGainVector(gsum, pGains[1], 2*255);
+			r = ApplyGainVector(r, pGains[2], 255);
+		}
+		if (HasLuma(output))
+		{
+			const v8u8 y8 = __builtin_convertvector((r + gsum + b) >> 2, v8u8);
+			memcpy(pLuma + i, &y8, sizeof(y8));
+		}
+		if (output == DEBAYER_LUMA)
+		{
+			continue;
+		}
+		{
+			const v8u8 b8 = __builtin_convertvector(b, v8u8);
+			const v8u8 g8 = __builtin_convertvector(gsum >> 1, v8u8);
+			const v8u8 r8 = __builtin_convertvector(r, v8u8);
+
+			if (HasPlanar(output))
+			{
+				memcpy(pColor + i, &b8, sizeof(b8));
+				memcpy(pColor + nPix + i, &g8, sizeof(g8));
+				memcpy(pColor + 2*nPix + i, &r8, sizeof(r8));
+			}
+			else
+			{
+				uint8 *pOut = pColor + 3*i;
+
+				for (k = 0; k < 8; k++)
+				{
+					pOut[3*k] = b8[k];
+					pOut[3*k + 1] = g8[k];
+					pOut[3*k + 2] = r8[k];
+				}
+			}
+		}
+	}
+	return x;
+}
+#endif /* DEBAYER_VECTOR */
+
+/*********************************************************************//*!
+ * @brief The rows of the cells in row y: pRG with red, pGB with blue.
+ *//*********************************************************************/
+static void DebayerRows(const uint8 *pRaw, uint16 width, uint16 y, enum EnBayerOrder order,
+		const uint8 **ppRG, const uint8 **ppGB)
+{
+	const uint8 *pTop = pRaw + 2*(uint32)y*width;
+
+	if (order == ROW_BGBG || order == ROW_GBGB)
+	{
+		*ppRG = pTop + width;
+		*ppGB = pTop;
+	}
+	else
+	{
+		*ppRG = pTop;
+		*ppGB = pTop + width;
+	}
+}
+
+/*********************************************************************//*!
+ * @brief Whether red is in the right column of a cell.
+ *//*********************************************************************/
+static bool DebayerSwapCols(enum EnBayerOrder order)
+{
+	return order == ROW_BGBG || order == ROW_GRGR;
+}
+
+void DebayerHalfSizeScalar(const uint8 *pRaw, uint16 width, uint16 height, enum EnBayerOrder order,
+		enum EnDebayerOutput output, const uint16 *pGains, uint8 *pColor, uint8 *pLuma)
+{
+	const uint32 nPix = (uint32)(width/2)*(height/2);
+	const bool bSwapCols = DebayerSwapCols(order);
+	const uint8 *pRG, *pGB;
+	uint16 y;
+
+	for (y = 0; y < height/2; y++)
+	{
+		DebayerRows(pRaw, width, y, order, &pRG, &pGB);
+		DebayerRowScalar(pRG, pGB, 0, width/2, bSwapCols, output, pGains, pColor, pLuma, (uint32)y*(width/2), nPix);
+	}
+}
+
+#if DEBAYER_VECTOR
+/*********************************************************************//*!
+ * @brief DebayerHalfSize() for one output, so each output gets its own
+ * instance of the kernels.
+ *//*********************************************************************/
+KERNEL void DebayerImageVector(const uint8 *pRaw, uint16 width, uint16 height, enum EnBayerOrder order,
+		const enum EnDebayerOutput output, const uint16 *pGains, uint8 *pColor, uint8 *pLuma)
+{
+	const uint32 nPix = (uint32)(width/2)*(height/2);
+	const bool bSwapCols = DebayerSwapCols(order);
+	const uint8 *pRG, *pGB;
+	uint16 x, y;
+
+	for (y = 0; y < height/2; y++)
+	{
+		const uint32 i = (uint32)y*(width/2);
+
+		DebayerRows(pRaw, width, y, order, &pRG, &pGB);
+		/* One instance per column order; the cells left over at the end
+		 * of the row are done one by one. */
+		if (bSwapCols)
+		{
+			x = DebayerRowVector(pRG, pGB, width/2, TRUE, output, pGains, pColor, pLuma, i, nPix);
+		}
+		else
+		{
+			x = DebayerRowVector(pRG, pGB, width/2, FALSE, output, pGains, pColor, pLuma, i, nPix);
+		}
+		DebayerRowScalar(pRG, pGB, x, width/2, bSwapCols, output, pGains, pColor, pLuma, i + x, nPix);
+	}
+}
+#endif /* DEBAYER_VECTOR */
+
+/*********************************************************************//*!
+ * @brief The gains to apply, NULL if they are all 1.0.
+ *//*********************************************************************/
+static const uint16 *DebayerGains(const uint16 *pGains)
+{
+	if (pGains != NULL && pGains[0] == DEBAYER_GAIN_ONE && pGains[1] == DEBAYER_GAIN_ONE && pGains[2] == DEBAYER_GAIN_ONE)
+	{
+		return NULL;
+	}
+	return pGains;
+}
+
+void DebayerHalfSize(const uint8 *pRaw, uint16 width, uint16 height, enum EnBayerOrder order,
+		enum EnDebayerOutput output, const uint16 *pGains, uint8 *pColor, uint8 *pLuma)
+{
+	pGains = DebayerGains(pGains);
+	/* Without gains the framework does what the own kernels were not
+	 * measured to do faster: the interleaved colour image (on par on the
+	 * host) and, without the vector kernels, the luminance image. */
+	if (pGains == NULL && output == DEBAYER_BGR)
+	{
+		OscVisDebayerHalfSize((uint8*)pRaw, width, height, order, pColor);
+		return;
+	}
+#if !DEBAYER_VECTOR
+	if (pGains == NULL && output == DEBAYER_LUMA)
+	{
+		OscVisDebayerGreyscaleHalfSize((uint8*)pRaw, width, height, order, pLuma);
+		return;
+	}
+#endif
+
+#if DEBAYER_VECTOR
+	switch (output)
+	{
+	case DEBAYER_BGR:
+		DebayerImageVector(pRaw, width, height, order, DEBAYER_BGR, pGains, pColor, pLuma);
+		break;
+	case DEBAYER_BGR_PLANAR:
+		DebayerImageVector(pRaw, width, height, order, DEBAYER_BGR_PLANAR, pGains, pColor, pLuma);
+		break;
+	case DEBAYER_LUMA:
+		DebayerImageVector(pRaw, width, height, order, DEBAYER_LUMA, pGains, pColor, pLuma);
+		break;
+	case DEBAYER_LUMA_BGR:
+		DebayerImageVector(pRaw, width, height, order, DEBAYER_LUMA_BGR, pGains, pColor, pLuma);
+		break;
+	case DEBAYER_LUMA_BGR_PLANAR:
+		DebayerImageVector(pRaw, width, height, order, DEBAYER_LUMA_BGR_PLANAR, pGains, pColor, pLuma);
+		break;
+	}
+#else
+	DebayerHalfSizeScalar(pRaw, width, height, order, output, pGains, pColor, pLuma);
+#endif
+}
+
+void DebayerHalfSizeRect(const uint8 *pRaw, uint16 width, uint16 height, enum EnBayerOrder order,
+		const uint16 *pGains, const struct IMG_RECT *pRect, uint8 *pOut)
+{
+	const uint16 outWidth = width/2, outHeight = height/2;
+	const uint16 xEnd = pRect->xPos + pRect->width < outWidth ? pRect->xPos + pRect->width : outWidth;
+	const uint16 yEnd = pRect->yPos + pRect->height < outHeight ? pRect->yPos + pRect->height : outHeight;
+	const bool bSwapCols = DebayerSwapCols(order);
+	const uint8 *pRG, *pGB;
+	uint16 y;
+
+	pGains = DebayerGains(pGains);
+	if (pRect->xPos >= xEnd)
+	{
+		return;
+	}
+	for (y = pRect->yPos; y < yEnd; y++)
+	{
+		DebayerRows(pRaw, width, y, order, &pRG, &pGB);
+		DebayerRowScalar(pRG, pGB, pRect->xPos, xEnd, bSwapCols, PLANAR_COLORS ? DEBAYER_BGR_PLANAR : DEBAYER_BGR,
+				pGains, pOut, NULL, (uint32)y*outWidth + pRect->xPos, (uint32)outWidth*outHeight);
+	}
+}
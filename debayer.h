@@ -0,0 +1,97 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file debayer.h
+ * @brief Debayering of the raw camera image to the formats used for
+ * processing.
+ *
+ * Each 2x2 Bayer cell gives one output pixel: red and blue are taken as
+ * they are, green is the mean of the two green pixels and the luminance
+ * the mean of all four, (R + 2G + B)/4.
+ */
+#ifndef DEBAYER_H_
+#define DEBAYER_H_
+
+#include "template.h"
+
+/*! @brief Gain 1.0 of a colour channel (c.f. DebayerHalfSize()). */
+#define DEBAYER_GAIN_ONE 256
+
+/*! @brief The white balance gains of the camera (CAM_GAIN_BLUE,
+ * CAM_GAIN_GREEN, CAM_GAIN_RED). */
+extern const uint16 camGains[3];
+
+/*! @brief The images a debayering writes. */
+enum EnDebayerOutput
+{
+	/*! @brief Colour image, blue, green, red interleaved. */
+	DEBAYER_BGR,
+	/*! @brief Colour image, the blue, green and red planes one after the
+	 * other. */
+	DEBAYER_BGR_PLANAR,
+	/*! @brief Luminance image only. */
+	DEBAYER_LUMA,
+	/*! @brief Luminance image and interleaved colour image. */
+	DEBAYER_LUMA_BGR,
+	/*! @brief Luminance image and planar colour image. */
+	DEBAYER_LUMA_BGR_PLANAR
+};
+
+/*********************************************************************//*!
+ * @brief Debayer a raw image to half size.
+ *
+ * Without gains, the interleaved colour image is left to
+ * OscVisDebayerHalfSize() and, where the vector kernels are not
+ * available, the luminance image alone to
+ * OscVisDebayerGreyscaleHalfSize(); the own kernels are not faster
+ * there. Everything else uses the vector extensions of the compiler where
+ * available (c.f. DEBAYER_VECTOR in debayer.c) and gives the same result
+ * as DebayerHalfSizeScalar().
+ *
+ * @param pRaw The raw image.
+ * @param width Width of the raw image.
+ * @param height Height of the raw image.
+ * @param order Bayer order of the raw image.
+ * @param output The images to write.
+ * @param pGains Gains of blue, green and red (DEBAYER_GAIN_ONE: 1.0)
+ * applied before the luminance is computed, for the white balance; NULL
+ * or all DEBAYER_GAIN_ONE for none. Gains must be below 16.0; values are
+ * saturated at 255.
+ * @param pColor Colour output image of (width/2)*(height/2) pixels; not
+ * used for DEBAYER_LUMA.
+ * @param pLuma Luminance output image of (width/2)*(height/2) bytes; only
+ * used for the outputs with luminance.
+ *//*********************************************************************/
+void DebayerHalfSize(const uint8 *pRaw, uint16 width, uint16 height, enum EnBayerOrder order,
+		enum EnDebayerOutput output, const uint16 *pGains, uint8 *pColor, uint8 *pLuma);
+
+/*********************************************************************//*!
+ * @brief Reference implementation of DebayerHalfSize(), one cell after
+ * the other.
+ *//*********************************************************************/
+void DebayerHalfSizeScalar(const uint8 *pRaw, uint16 width, uint16 height, enum EnBayerOrder order,
+		enum EnDebayerOutput output, const uint16 *pGains, uint8 *pColor, uint8 *pLuma);
+
+/*********************************************************************//*!
+ * @brief Debayer a rectangle of a raw image to half size colour.
+ *
+ * Only the pixels of the rectangle are written; they get the same values
+ * as with DebayerHalfSize().
+ *
+ * @param pRaw The raw image.
+ * @param width Width of the raw image.
+ * @param height Height of the raw image.
+ * @param order Bayer order of the raw image.
+ * @param pGains Gains of blue, green and red or NULL (c.f.
+ * DebayerHalfSize()).
+ * @param pRect The rectangle in pixels of the output image; it is clipped
+ * to the image.
+ * @param pOut The output image of (width/2)*(height/2) pixels in the
+ * layout given by PLANAR_COLORS.
+ *//*********************************************************************/
+void DebayerHalfSizeRect(const uint8 *pRaw, uint16 width, uint16 height, enum EnBayerOrder order,
+		const uint16 *pGains, const struct IMG_RECT *pRect, uint8 *pOut);
+
+#endif /*DEBAYER_H_*/
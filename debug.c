@@ -11,74 +11,83 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <pthread.h>
 
-OSC_ERR WrDbgImgInt16(const int16 *pData,  const uint16 width,  const uint16 height, const char * strPrefix, int32 seq)
+/*********************************************************************//*!
+ * @brief Build the name of a debug file from its prefix, the sequence
+ * number (if seq >= 0) and the suffix; truncated to fit.
+ *//*********************************************************************/
+static void DbgFileName(char *strName, size_t size, const char *strPrefix, int32 seq, const char *strSuffix)
 {
-	struct OSC_PICTURE pic;
-	OSC_ERR err;
-	int i;
-	uint8 *pPix;
-	char strName[256];
-	char strTemp[16];
-	
-	pPix = (uint8*)malloc(width*height);
-	pic.width = width;
-	pic.height = height;
-	pic.type = OSC_PICTURE_GREYSCALE;
-	pic.data = (void*)pPix;
-	strcpy(strName, strPrefix);
 	if (seq >= 0)
 	{
-		sprintf(strTemp, "%05u.bmp", (unsigned int)seq);
-		strcat(strName, strTemp);
+		snprintf(strName, size, "%s%05u.%s", strPrefix, (unsigned int)seq, strSuffix);
 	}
 	else
 	{
-		strcat(strName, ".bmp");
+		snprintf(strName, size, "%s.%s", strPrefix, strSuffix);
 	}
+}
+
+/*! @brief Conversion buffer of the synchronous writers; allocated once
+ * for the lifetime of the application like the ones of the queue. */
+static struct
+{
+	pthread_mutex_t mutex;
+	uint8 pix[DBG_MAX_IMAGE_SIZE];
+} dbgSync = { PTHREAD_MUTEX_INITIALIZER };
+
+/*********************************************************************//*!
+ * @brief Write the converted image of dbgSync (locked by the caller).
+ *//*********************************************************************/
+static OSC_ERR DbgWriteSync(const uint16 width, const uint16 height, const char * strPrefix, int32 seq)
+{
+	struct OSC_PICTURE pic;
+	char strName[256];
+
+	pic.width = width;
+	pic.height = height;
+	pic.type = OSC_PICTURE_GREYSCALE;
+	pic.data = (void*)dbgSync.pix;
+	DbgFileName(strName, sizeof(strName), strPrefix, seq, "bmp");
+	return OscBmpWrite(&pic, strName);
+}
+
+OSC_ERR WrDbgImgInt16(const int16 *pData,  const uint16 width,  const uint16 height, const char * strPrefix, int32 seq)
+{
+	OSC_ERR err;
+	int i;
 	
+	if (width*height > DBG_MAX_IMAGE_SIZE)
+	{
+		return -EINVALID_PARAMETER;
+	}
+	pthread_mutex_lock(&dbgSync.mutex);
 	for (i = 0; i < width*height; i++)
 	{
-		pPix[i] = (uint8)(((uint32)((int32)pData[i] + 0x8000)) >> 8);
+		dbgSync.pix[i] = (uint8)(((uint32)((int32)pData[i] + 0x8000)) >> 8);
 	}
-	err = OscBmpWrite(&pic, strName);
-	
-	free(pPix);
+	err = DbgWriteSync(width, height, strPrefix, seq);
+	pthread_mutex_unlock(&dbgSync.mutex);
 	return err;
 }
 
 OSC_ERR WrDbgImgUint16(const uint16 *pData, const uint16 width,  const uint16 height, const char * strPrefix, int32 seq)
 {
-	struct OSC_PICTURE pic;
 	OSC_ERR err;
 	int i;
-	uint8 *pPix;
-	char strName[256];
-	char strTemp[16];
 	
-	pPix = (uint8*)malloc(width*height);
-	pic.width = width;
-	pic.height = height;
-	pic.type = OSC_PICTURE_GREYSCALE;
-	pic.data = (void*)pPix;
-	strcpy(strName, strPrefix);
-	if (seq >= 0)
-	{
-		sprintf(strTemp, "%05u.bmp", (unsigned int)seq);
-		strcat(strName, strTemp);
-	}
-	else
+	if (width*height > DBG_MAX_IMAGE_SIZE)
 	{
-		strcat(strName, ".bmp");
+		return -EINVALID_PARAMETER;
 	}
-	
+	pthread_mutex_lock(&dbgSync.mutex);
 	for (i = 0; i < width*height; i++)
 	{
-		pPix[i] = (uint8)(pData[i] >> 8);
+		dbgSync.pix[i] = (uint8)(pData[i] >> 8);
 	}
-	err = OscBmpWrite(&pic, strName);
-	
-	free(pPix);
+	err = DbgWriteSync(width, height, strPrefix, seq);
+	pthread_mutex_unlock(&dbgSync.mutex);
 	return err;
 }
 
@@ -87,23 +96,13 @@ OSC_ERR WrDbgImgUint8(const uint8 *pData, const uint16 width, const uint16 heigh
 	struct OSC_PICTURE pic;
 	OSC_ERR err;
 	char strName[256];
-	char strTemp[16];
 	
 	
 	pic.width = width;
 	pic.height = height;
 	pic.type = OSC_PICTURE_GREYSCALE;
 	pic.data = (uint8*)pData;
-	strcpy(strName, strPrefix);
-	if (seq != -1)
-	{
-		sprintf(strTemp, "%05u.bmp", (unsigned int)seq);
-		strcat(strName, strTemp);
-	}
-	else
-	{
-		strcat(strName, ".bmp");
-	}
+	DbgFileName(strName, sizeof(strName), strPrefix, seq, "bmp");
 	
 	err = OscBmpWrite(&pic, strName);
 	
@@ -114,19 +113,9 @@ OSC_ERR WrDbgText(const char* strPrefix, int32 seq, const char *strFormat, ...)
 {
 	FILE *pF;
 	char strName[256];
-	char strTemp[16];
 	va_list ap; /*< The dynamic argument list */
 	
-	strcpy(strName, strPrefix);
-	if (seq != -1)
-	{
-		sprintf(strTemp, "%05u.txt", (unsigned int)seq);
-		strcat(strName, strTemp);
-	}
-	else
-	{
-		strcat(strName, ".txt");
-	}
+	DbgFileName(strName, sizeof(strName), strPrefix, seq, "txt");
 	
 	pF = fopen(strName, "w");
 	if (pF == NULL)
@@ -147,20 +136,10 @@ OSC_ERR WrDbgText(const char* strPrefix, int32 seq, const char *strFormat, ...)
 OSC_ERR WrDbgData(void *pData, uint32 len, const char* strPrefix, int32 seq)
 {
 	char strName[256];
-	char strTemp[16];
 	int32 ret;
 	FILE *pF;
 	
-	strcpy(strName, strPrefix);
-	if (seq >= 0)
-	{
-		sprintf(strTemp, "%05u.dat", (unsigned int)seq);
-		strcat(strName, strTemp);
-	}
-	else
-	{
-		strcat(strName, ".dat");
-	}
+	DbgFileName(strName, sizeof(strName), strPrefix, seq, "dat");
 	
 	pF = fopen(strName, "wb");
 	if (pF == NULL)
@@ -178,3 +157,286 @@ OSC_ERR WrDbgData(void *pData, uint32 len, const char* strPrefix, int32 seq)
 	
 	return SUCCESS;
 }
+
+/*! @brief States of a job of the asynchronous writer. */
+enum EnDbgJobState
+{
+	DBG_JOB_FREE,
+	DBG_JOB_FILLING,
+	DBG_JOB_READY
+};
+
+/*! @brief An image queued for the asynchronous writer. */
+struct DBG_JOB
+{
+	enum EnDbgJobState enState;
+	enum EnDbgFormat enFormat;
+	/*! @brief Whether the image is appended to the file. */
+	bool bAppend;
+	uint16 width;
+	uint16 height;
+	char strName[DBG_MAX_NAME_LEN];
+	/*! @brief The image converted to 8 bit. */
+	uint8 pix[DBG_MAX_IMAGE_SIZE];
+};
+
+/*! @brief The queue of the asynchronous writer; the jobs and their
+ * buffers are allocated once for the lifetime of the application. */
+static struct
+{
+	pthread_once_t once;
+	pthread_mutex_t mutex;
+	/*! @brief Signals the writer that a job is ready. */
+	pthread_cond_t cond;
+	pthread_t thread;
+	/*! @brief Whether the writer thread runs. */
+	bool bStarted;
+	/*! @brief Jobs taken so far; the next one is jobs[nHead % DBG_QUEUE_LEN]. */
+	uint32 nHead;
+	/*! @brief Jobs written so far. */
+	uint32 nTail;
+	/*! @brief Images dropped because the queue was full. */
+	uint32 nDropped;
+	struct DBG_JOB jobs[DBG_QUEUE_LEN];
+} dbgQueue = { PTHREAD_ONCE_INIT, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+/*! @brief The file a sequence of raw images is appended to; kept open by
+ * the writer as long as the sequence goes on. */
+static struct
+{
+	FILE *pFile;
+	/*! @brief Whether images were appended since the last flush. */
+	bool bDirty;
+	char strName[DBG_MAX_NAME_LEN];
+	char buf[DBG_STREAM_BUFFER];
+} dbgStream;
+
+/*********************************************************************//*!
+ * @brief Write a job to its file.
+ *//*********************************************************************/
+static OSC_ERR DbgWriteJob(struct DBG_JOB *pJob)
+{
+	struct OSC_PICTURE pic;
+	FILE *pF;
+	uint32 len = pJob->width*pJob->height;
+	OSC_ERR err = SUCCESS;
+
+	if (pJob->enFormat == DBG_BMP)
+	{
+		pic.width = pJob->width;
+		pic.height = pJob->height;
+		pic.type = OSC_PICTURE_GREYSCALE;
+		pic.data = (void*)pJob->pix;
+		return OscBmpWrite(&pic, pJob->strName);
+	}
+
+	if (!pJob->bAppend)
+	{
+		pF = fopen(pJob->strName, "wb");
+		if (pF == NULL)
+		{
+			return -EUNABLE_TO_OPEN_FILE;
+		}
+		if (fwrite(pJob->pix, 1, len, pF) != len)
+		{
+			err = -EFILE_ERROR;
+		}
+		fclose(pF);
+		return err;
+	}
+
+	/* The images of a sequence go to one file through a large buffer. */
+	if (dbgStream.pFile != NULL && strcmp(dbgStream.strName, pJob->strName) != 0)
+	{
+		fclose(dbgStream.pFile);
+		dbgStream.pFile = NULL;
+	}
+	if (dbgStream.pFile == NULL)
+	{
+		dbgStream.pFile = fopen(pJob->strName, "ab");
+		if (dbgStream.pFile == NULL)
+		{
+			return -EUNABLE_TO_OPEN_FILE;
+		}
+		setvbuf(dbgStream.pFile, dbgStream.buf, _IOFBF, sizeof(dbgStream.buf));
+		strcpy(dbgStream.strName, pJob->strName);
+	}
+	if (fwrite(pJob->pix, 1, len, dbgStream.pFile) != len)
+	{
+		err = -EFILE_ERROR;
+	}
+	dbgStream.bDirty = TRUE;
+	return err;
+}
+
+/*********************************************************************//*!
+ * @brief The writer thread; works off the queue in order and flushes the
+ * stream whenever the queue runs empty.
+ *//*********************************************************************/
+static void *DbgWriterMain(void *pArg)
+{
+	struct DBG_JOB *pJob;
+
+	pthread_mutex_lock(&dbgQueue.mutex);
+	for (;;)
+	{
+		pJob = &dbgQueue.jobs[dbgQueue.nTail % DBG_QUEUE_LEN];
+		if (pJob->enState != DBG_JOB_READY)
+		{
+			if (dbgStream.bDirty && pJob->enState == DBG_JOB_FREE)
+			{
+				pthread_mutex_unlock(&dbgQueue.mutex);
+				fflush(dbgStream.pFile);
+				dbgStream.bDirty = FALSE;
+				pthread_mutex_lock(&dbgQueue.mutex);
+				continue;
+			}
+			pthread_cond_wait(&dbgQueue.cond, &dbgQueue.mutex);
+			continue;
+		}
+		pthread_mutex_unlock(&dbgQueue.mutex);
+
+		if (DbgWriteJob(pJob) != SUCCESS)
+		{
+			OscLog(ERROR, "%s: Error writing %s!\n", __func__, pJob->strName);
+		}
+
+		pthread_mutex_lock(&dbgQueue.mutex);
+		pJob->enState = DBG_JOB_FREE;
+		dbgQueue.nTail++;
+	}
+	return NULL;
+}
+
+/*********************************************************************//*!
+ * @brief Start the writer thread with the first image queued.
+ *//*********************************************************************/
+static void DbgWriterStart()
+{
+	dbgQueue.bStarted = pthread_create(&dbgQueue.thread, NULL, DbgWriterMain, NULL) == 0;
+	if (!dbgQueue.bStarted)
+	{
+		OscLog(ERROR, "%s: Unable to start the writer!\n", __func__);
+	}
+}
+
+/*********************************************************************//*!
+ * @brief Take a free job of the queue and name its file.
+ *
+ * @return The job in state DBG_JOB_FILLING or NULL if the queue is full.
+ *//*********************************************************************/
+static struct DBG_JOB *DbgTakeJob(const uint16 width, const uint16 height, const char * strPrefix, int32 seq, enum EnDbgFormat enFormat)
+{
+	struct DBG_JOB *pJob;
+
+	pthread_once(&dbgQueue.once, DbgWriterStart);
+
+	pthread_mutex_lock(&dbgQueue.mutex);
+	pJob = &dbgQueue.jobs[dbgQueue.nHead % DBG_QUEUE_LEN];
+	if (!dbgQueue.bStarted || pJob->enState != DBG_JOB_FREE)
+	{
+		dbgQueue.nDropped++;
+		pthread_mutex_unlock(&dbgQueue.mutex);
+		return NULL;
+	}
+	pJob->enState = DBG_JOB_FILLING;
+	dbgQueue.nHead++;
+	pthread_mutex_unlock(&dbgQueue.mutex);
+
+	pJob->enFormat = enFormat;
+	pJob->width = width;
+	pJob->height = height;
+	pJob->bAppend = enFormat == DBG_RAW && seq >= 0;
+	if (enFormat == DBG_BMP)
+	{
+		DbgFileName(pJob->strName, sizeof(pJob->strName), strPrefix, seq, "bmp");
+	}
+	else
+	{
+		DbgFileName(pJob->strName, sizeof(pJob->strName), strPrefix, -1, "raw");
+	}
+	return pJob;
+}
+
+/*********************************************************************//*!
+ * @brief Hand a filled job to the writer.
+ *//*********************************************************************/
+static void DbgPutJob(struct DBG_JOB *pJob)
+{
+	pthread_mutex_lock(&dbgQueue.mutex);
+	pJob->enState = DBG_JOB_READY;
+	pthread_cond_signal(&dbgQueue.cond);
+	pthread_mutex_unlock(&dbgQueue.mutex);
+}
+
+OSC_ERR WrDbgImgInt16Async(const int16 *pData, const uint16 width, const uint16 height, const char * strPrefix, int32 seq, enum EnDbgFormat enFormat)
+{
+	struct DBG_JOB *pJob;
+	int i;
+
+	if (width*height > DBG_MAX_IMAGE_SIZE)
+	{
+		return -EINVALID_PARAMETER;
+	}
+	pJob = DbgTakeJob(width, height, strPrefix, seq, enFormat);
+	if (pJob == NULL)
+	{
+		return -EDEVICE_BUSY;
+	}
+	for (i = 0; i < width*height; i++)
+	{
+		pJob->pix[i] = (uint8)(((uint32)((int32)pData[i] + 0x8000)) >> 8);
+	}
+	DbgPutJob(pJob);
+	return SUCCESS;
+}
+
+OSC_ERR WrDbgImgUint16Async(const uint16 *pData, const uint16 width, const uint16 height, const char * strPrefix, int32 seq, enum EnDbgFormat enFormat)
+{
+	struct DBG_JOB *pJob;
+	int i;
+
+	if (width*height > DBG_MAX_IMAGE_SIZE)
+	{
+		return -EINVALID_PARAMETER;
+	}
+	pJob = DbgTakeJob(width, height, strPrefix, seq, enFormat);
+	if (pJob == NULL)
+	{
+		return -EDEVICE_BUSY;
+	}
+	for (i = 0; i < width*height; i++)
+	{
+		pJob->pix[i] = (uint8)(pData[i] >> 8);
+	}
+	DbgPutJob(pJob);
+	return SUCCESS;
+}
+
+OSC_ERR WrDbgImgUint8Async(const uint8 *pData, const uint16 width, const uint16 height, const char * strPrefix, int32 seq, enum EnDbgFormat enFormat)
+{
+	struct DBG_JOB *pJob;
+
+	if (width*height > DBG_MAX_IMAGE_SIZE)
+	{
+		return -EINVALID_PARAMETER;
+	}
+	pJob = DbgTakeJob(width, height, strPrefix, seq, enFormat);
+	if (pJob == NULL)
+	{
+		return -EDEVICE_BUSY;
+	}
+	memcpy(pJob->pix, pData, width*height);
+	DbgPutJob(pJob);
+	return SUCCESS;
+}
+
+uint32 WrDbgDropped()
+{
+	uint32 nDropped;
+
+	pthread_mutex_lock(&dbgQueue.mutex);
+	nDropped = dbgQueue.nDropped;
+	pthread_mutex_unlock(&dbgQueue.mutex);
+	return nDropped;
+}
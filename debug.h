@@ -10,12 +10,35 @@
 #define DEBUG_H_
 
 #include "oscar.h"
+
+/*! @brief Number of images the asynchronous writer can hold. */
+#define DBG_QUEUE_LEN 8
+/*! @brief Largest image (bytes, after conversion to 8 bit) the
+ * asynchronous writer accepts. */
+#define DBG_MAX_IMAGE_SIZE (OSC_CAM_MAX_IMAGE_WIDTH*OSC_CAM_MAX_IMAGE_HEIGHT)
+/*! @brief Longest file name of the asynchronous writer. */
+#define DBG_MAX_NAME_LEN 128
+/*! @brief Stdio buffer of the file a sequence of raw images is
+ * appended to. */
+#define DBG_STREAM_BUFFER (256*1024)
+
+/*! @brief File formats of the asynchronous writer. */
+enum EnDbgFormat
+{
+	/*! @brief One BMP file per image (<prefix><seq>.bmp). */
+	DBG_BMP,
+	/*! @brief The pixels only; the images of a sequence (seq >= 0) are
+	 * appended to <prefix>.raw, a single image goes there alone. */
+	DBG_RAW
+};
+
 /*********************************************************************//*!
  * @brief Write an image in int16 (or fract16) format to file (BMP)
  * for testing purposes.
  * 
  * Precision is automatically scaled down to 8 bit and the contents
- * are stored as greyscale image.
+ * are stored as greyscale image. The conversion buffer is allocated
+ * once, so images larger than DBG_MAX_IMAGE_SIZE are refused.
  * 
  * @param pData Data to be written as image
  * @param width Width of the image.
@@ -26,7 +49,8 @@
  * @param seq If the image is part of a sequence, a sequence number
  * can be specified here. It will be included as part of the file name.
  * Otherwise specify -1.
- * @return SUCCESS or an appropriate error code.
+ * @return SUCCESS, -EINVALID_PARAMETER if the image is too large or an
+ * appropriate error code.
  *//*********************************************************************/
 OSC_ERR WrDbgImgInt16(const int16 *pData, const uint16 width, const uint16 height, const char * strPrefix, int32 seq);
 
@@ -78,4 +102,41 @@ OSC_ERR WrDbgText(const char* strPrefix, int32 seq, const char *strFormat, ...);
  *//*********************************************************************/
 OSC_ERR WrDbgData(void *pData, uint32 len, const char* strPrefix, int32 seq);
 
+/*********************************************************************//*!
+ * @brief Queue an image in int16 (or fract16) format to be written by
+ * the background writer.
+ *
+ * The image is scaled down to 8 bit into a buffer of the queue right
+ * away, so the caller may reuse pData. Never blocks; if the queue is
+ * full the image is dropped.
+ *
+ * @param pData Data to be written as image
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param strPrefix Prefix of the file name (c.f. enum EnDbgFormat).
+ * @param seq Sequence number or -1.
+ * @param enFormat File format.
+ * @return SUCCESS, -EDEVICE_BUSY if the queue is full or
+ * -EINVALID_PARAMETER if the image is too large.
+ *//*********************************************************************/
+OSC_ERR WrDbgImgInt16Async(const int16 *pData, const uint16 width, const uint16 height, const char * strPrefix, int32 seq, enum EnDbgFormat enFormat);
+
+/*********************************************************************//*!
+ * @brief Queue an image in uint16 format to be written by the background
+ * writer (c.f. WrDbgImgInt16Async()).
+ *//*********************************************************************/
+OSC_ERR WrDbgImgUint16Async(const uint16 *pData, const uint16 width, const uint16 height, const char * strPrefix, int32 seq, enum EnDbgFormat enFormat);
+
+/*********************************************************************//*!
+ * @brief Queue an image in uint8 format to be written by the background
+ * writer (c.f. WrDbgImgInt16Async()).
+ *//*********************************************************************/
+OSC_ERR WrDbgImgUint8Async(const uint8 *pData, const uint16 width, const uint16 height, const char * strPrefix, int32 seq, enum EnDbgFormat enFormat);
+
+/*********************************************************************//*!
+ * @brief Number of images the background writer dropped because its
+ * queue was full.
+ *//*********************************************************************/
+uint32 WrDbgDropped();
+
 #endif /*DEBUG_H_*/
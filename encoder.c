@@ -0,0 +1,110 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file encoder.c
+ * @brief Belt position counted from the pulses of a conveyor encoder on
+ * a digital input.
+ */
+
+#include "encoder.h"
+#include "archive.h"
+#include <unistd.h>
+#include <time.h>
+
+/*********************************************************************//*!
+ * @brief The monotonic clock in micro seconds.
+ *//*********************************************************************/
+static uint64 EncoderClock()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+/*********************************************************************//*!
+ * @brief Body of the sampling thread; counts the rising edges.
+ *//*********************************************************************/
+static void *EncoderMain(void *pArg)
+{
+	struct ENCODER *pEncoder = (struct ENCODER*)pArg;
+	const uint64 start = EncoderClock();
+	uint32 nSamples = 0;
+	bool bLevel;
+	OSC_ERR err;
+
+	while (TRUE)
+	{
+		/* The sleep is as long as the kernel makes it. */
+		if (++nSamples == ENCODER_CALIBRATION_SAMPLES)
+		{
+			pthread_mutex_lock(&pEncoder->mutex);
+			pEncoder->nSampleUs = (EncoderClock() - start)/ENCODER_CALIBRATION_SAMPLES;
+			pthread_mutex_unlock(&pEncoder->mutex);
+			OscLog(INFO, "%s: input sampled every %u us, at most %u pulses/s.\n", __func__,
+					(unsigned int)pEncoder->nSampleUs, (unsigned int)EncoderMaxRate(pEncoder));
+		}
+		/* A replay has the input recorded with its frames. */
+		if (ArchiveIsSource())
+			err = ArchiveGpioRead(ENCODER_GPIO, &bLevel);
+		else
+			err = OscGpioRead(ENCODER_GPIO, &bLevel);
+		if (err == SUCCESS)
+		{
+			if (bLevel && !pEncoder->bLastLevel)
+			{
+				pthread_mutex_lock(&pEncoder->mutex);
+				pEncoder->nPosition++;
+				pthread_mutex_unlock(&pEncoder->mutex);
+			}
+			pEncoder->bLastLevel = bLevel;
+		}
+		usleep(ENCODER_SAMPLE_US);
+	}
+	return NULL;
+}
+
+OSC_ERR EncoderStart(struct ENCODER *pEncoder)
+{
+	pthread_mutex_init(&pEncoder->mutex, NULL);
+	pEncoder->nPosition = 0;
+	pEncoder->bLastLevel = FALSE;
+	pEncoder->nSampleUs = 0;
+	pEncoder->bStarted = pthread_create(&pEncoder->thread, NULL, EncoderMain, pEncoder) == 0;
+	if (!pEncoder->bStarted)
+	{
+		OscLog(ERROR, "%s: Unable to start the encoder thread!\n", __func__);
+		return -EDEVICE;
+	}
+	return SUCCESS;
+}
+
+uint32 EncoderPosition(struct ENCODER *pEncoder)
+{
+	uint32 nPosition;
+
+	if (!pEncoder->bStarted)
+	{
+		return 0;
+	}
+	pthread_mutex_lock(&pEncoder->mutex);
+	nPosition = pEncoder->nPosition;
+	pthread_mutex_unlock(&pEncoder->mutex);
+	return nPosition;
+}
+
+uint32 EncoderMaxRate(struct ENCODER *pEncoder)
+{
+	uint32 nSampleUs;
+
+	if (!pEncoder->bStarted)
+	{
+		return 0;
+	}
+	pthread_mutex_lock(&pEncoder->mutex);
+	nSampleUs = pEncoder->nSampleUs;
+	pthread_mutex_unlock(&pEncoder->mutex);
+	return nSampleUs > 0 ? 1000000/(4*nSampleUs) : 0;
+}
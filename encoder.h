@@ -0,0 +1,84 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file encoder.h
+ * @brief Belt position counted from the pulses of a conveyor encoder on
+ * a digital input.
+ *
+ * Every lane has an encoder of its own in its processing state (c.f.
+ * lanestate.h). Only the camera lane has an input; a thread of its own
+ * samples it independent of the frames, and every rising edge advances
+ * the position by one. The other lanes have no encoder and time their
+ * ejections in frames.
+ *
+ * The framework offers no interrupt on the inputs, so the thread sleeps
+ * ENCODER_SAMPLE_US between two samples. The kernel rounds the sleep up
+ * to its timer tick (several milli seconds on the target), so the real
+ * interval is measured once the thread runs and the fastest encoder that
+ * can be counted follows from it (c.f. EncoderMaxRate()).
+ *
+ * In the simulation the input is taken from gpio_in.txt, one value per
+ * frame; a replayed archive supplies the level recorded with each frame
+ * instead.
+ */
+#ifndef ENCODER_H_
+#define ENCODER_H_
+
+#include "template.h"
+#include <pthread.h>
+
+/*! @brief The input the encoder is connected to. */
+#define ENCODER_GPIO GPIO_IN1
+/*! @brief Interval the input is asked to be sampled at in micro
+ * seconds; the real one is at least a timer tick of the kernel. */
+#define ENCODER_SAMPLE_US 250
+/*! @brief Number of samples the real sampling interval is measured
+ * over. */
+#define ENCODER_CALIBRATION_SAMPLES 64
+
+/*! @brief An encoder and the thread sampling it. */
+struct ENCODER
+{
+	/*! @brief Protects nPosition. */
+	pthread_mutex_t mutex;
+	/*! @brief Rising edges seen so far. */
+	uint32 nPosition;
+	/*! @brief The level of the input at the last sample. */
+	bool bLastLevel;
+	/*! @brief Whether the sampling thread runs. */
+	bool bStarted;
+	/*! @brief The measured sampling interval in micro seconds; 0 until
+	 * it is measured. */
+	uint32 nSampleUs;
+	pthread_t thread;
+};
+
+/*********************************************************************//*!
+ * @brief Start sampling the encoder input (camera lane only).
+ *
+ * @param pEncoder The encoder of the lane.
+ * @return SUCCESS or an appropriate error code.
+ *//*********************************************************************/
+OSC_ERR EncoderStart(struct ENCODER *pEncoder);
+
+/*********************************************************************//*!
+ * @brief The current belt position in encoder pulses.
+ *
+ * @param pEncoder The encoder of the lane; stays at 0 if it was never
+ * started.
+ *//*********************************************************************/
+uint32 EncoderPosition(struct ENCODER *pEncoder);
+
+/*********************************************************************//*!
+ * @brief Most pulses per second that are counted with the measured
+ * sampling interval: a pulse and the pause after it have to last two
+ * intervals each. Faster belts need an encoder geared down accordingly.
+ *
+ * @param pEncoder The encoder of the lane.
+ * @return The rate, 0 while the interval is not yet measured.
+ *//*********************************************************************/
+uint32 EncoderMaxRate(struct ENCODER *pEncoder);
+
+#endif /*ENCODER_H_*/
@@ -0,0 +1,103 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file exposure.c
+ * @brief Closed-loop control of the shutter width from a sparse
+ * brightness histogram of the raw image.
+ */
+
+#include "exposure.h"
+#include <string.h>
+
+uint8 MeasureBrightness(const uint8 *pRaw, uint16 width, uint16 height, const uint8 *pMask, uint8 maskShift, uint16 *pSaturated, uint16 *pBackground)
+{
+	const uint16 maskWidth = width >> maskShift;
+	uint16 hist[AE_HIST_BINS];
+	uint32 nSamples = 0, nCells = 0, limit, cum;
+	uint16 x, y, bin;
+
+	memset(hist, 0, sizeof(hist));
+	for (y = 0; y + 1 < height; y += 2*AE_SAMPLE_STEP)
+	{
+		const uint8 *pRow0 = &pRaw[(uint32)y*width];
+		const uint8 *pRow1 = pRow0 + width;
+
+		for (x = 0; x + 1 < width; x += 2*AE_SAMPLE_STEP)
+		{
+			uint16 sum;
+
+			nCells++;
+			/* Objects on the belt are not metered. */
+			if (pMask != NULL && pMask[(y >> maskShift)*maskWidth + (x >> maskShift)])
+				continue;
+			sum = pRow0[x] + pRow0[x + 1] + pRow1[x] + pRow1[x + 1];
+			/* sum/4 scaled to the histogram bins */
+			hist[sum/(4*256/AE_HIST_BINS)]++;
+			nSamples++;
+		}
+	}
+
+	*pBackground = (nSamples*1000)/nCells;
+	if (nSamples == 0)
+	{
+		*pSaturated = 0;
+		return 0;
+	}
+	*pSaturated = (hist[AE_HIST_BINS - 1]*1000)/nSamples;
+
+	/* Walk the cumulative histogram up to the percentile. */
+	limit = (nSamples*AE_PERCENTILE)/100;
+	cum = 0;
+	for (bin = 0; bin < AE_HIST_BINS - 1; bin++)
+	{
+		cum += hist[bin];
+		if (cum > limit)
+			break;
+	}
+	/* centre of the bin */
+	return bin*(256/AE_HIST_BINS) + 256/AE_HIST_BINS/2;
+}
+
+uint32 AutoExposure(const uint8 *pRaw, uint32 curShutter, uint32 maxShutter)
+{
+	uint8 maskShift;
+	const uint8 *pMask = GetForegroundMask(&data, &maskShift);
+	uint16 saturated, background;
+	const uint8 level = MeasureBrightness(pRaw, OSC_CAM_MAX_IMAGE_WIDTH, OSC_CAM_MAX_IMAGE_HEIGHT, pMask, maskShift, &saturated, &background);
+	uint32 shutter;
+
+	if (background < AE_MIN_BACKGROUND_PERMILLE)
+	{
+		/* Too little of the belt is visible to judge the exposure. */
+		return curShutter;
+	}
+	data.ipc.state.nBrightness = level;
+
+	if (saturated > AE_SATURATED_PERMILLE)
+	{
+		/* The percentile cannot be trusted any more once it clips. */
+		shutter = curShutter/2;
+	}
+	else if (level > AE_TARGET + AE_DEADBAND || level + AE_DEADBAND < AE_TARGET)
+	{
+		const uint32 target = level < AE_TARGET ? AE_TARGET - AE_DEADBAND/2 : AE_TARGET;
+		shutter = (curShutter*target)/level;
+		/* Limit a single step. */
+		if (shutter > 2*curShutter)
+			shutter = 2*curShutter;
+		else if (shutter < curShutter/2)
+			shutter = curShutter/2;
+	}
+	else
+	{
+		shutter = curShutter;
+	}
+
+	if (shutter > maxShutter)
+		shutter = maxShutter;
+	if (shutter < AE_MIN_SHUTTER)
+		shutter = AE_MIN_SHUTTER;
+	return shutter;
+}
@@ -0,0 +1,75 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file exposure.h
+ * @brief Closed-loop control of the shutter width from a sparse
+ * brightness histogram of the raw image.
+ */
+#ifndef EXPOSURE_H_
+#define EXPOSURE_H_
+
+#include "template.h"
+
+/*! @brief Distance in Bayer cells between two samples, horizontally and
+ * vertically (8: about 1400 samples per frame). */
+#define AE_SAMPLE_STEP 8
+/*! @brief Number of bins of the brightness histogram. */
+#define AE_HIST_BINS 64
+/*! @brief The percentile of the brightness that is controlled. */
+#define AE_PERCENTILE 90
+/*! @brief Brightness (0..255) the percentile is driven to. */
+#define AE_TARGET 160
+/*! @brief No correction while the brightness is within this distance of
+ * AE_TARGET. */
+#define AE_DEADBAND 24
+/*! @brief Samples (permille) in the top bin above which the image counts
+ * as over-exposed regardless of the percentile. */
+#define AE_SATURATED_PERMILLE 20
+/*! @brief Shortest shutter width in micro seconds. */
+#define AE_MIN_SHUTTER 50
+/*! @brief Samples (permille) that have to fall on the background for a
+ * correction; with more of the scene covered the width is kept. */
+#define AE_MIN_BACKGROUND_PERMILLE 250
+
+/*********************************************************************//*!
+ * @brief Measure the brightness of a raw image.
+ *
+ * Every AE_SAMPLE_STEP-th 2x2 Bayer cell in each direction contributes
+ * the mean of its four pixels to a histogram, so the Bayer order does
+ * not matter. Cells on the foreground of the mask are left out, so
+ * objects on the belt do not drive the exposure.
+ *
+ * @param pRaw The raw image.
+ * @param width Width of the raw image.
+ * @param height Height of the raw image.
+ * @param pMask Foreground mask or NULL to sample the whole image.
+ * @param maskShift log2 of the resolution ratio between pRaw and pMask.
+ * @param pSaturated Receives the permille of samples in the top bin.
+ * @param pBackground Receives the permille of cells sampled.
+ * @return Brightness at percentile AE_PERCENTILE.
+ *//*********************************************************************/
+uint8 MeasureBrightness(const uint8 *pRaw, uint16 width, uint16 height, const uint8 *pMask, uint8 maskShift, uint16 *pSaturated, uint16 *pBackground);
+
+/*********************************************************************//*!
+ * @brief Compute the shutter width for the following frames.
+ *
+ * The brightness scales roughly linearly with the shutter width, so the
+ * width is scaled by the ratio of target and measured brightness. A
+ * single step at most halves or doubles the width. Longer exposures aim
+ * at the lower edge of the deadband, so the shortest width within it is
+ * used. The brightness is metered on the background only (c.f.
+ * GetForegroundMask()), so the control keeps working while objects pass;
+ * call it after the frame of pRaw has been processed, so the mask belongs
+ * to the same frame.
+ *
+ * @param pRaw The raw image taken with curShutter.
+ * @param curShutter Shutter width of the image in micro seconds.
+ * @param maxShutter Longest acceptable shutter width.
+ * @return The new shutter width; equal to curShutter if no correction is
+ * needed.
+ *//*********************************************************************/
+uint32 AutoExposure(const uint8 *pRaw, uint32 curShutter, uint32 maxShutter);
+
+#endif /*EXPOSURE_H_*/
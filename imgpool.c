@@ -0,0 +1,137 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file imgpool.c
+ * @brief Pool of the image buffers used for processing and their
+ * assignment to the image roles.
+ */
+
+#include "template.h"
+#include <string.h>
+
+/*! @brief Format and maximum geometry of an image role. */
+struct IMG_LAYOUT
+{
+	/*! @brief The format the image is used with. */
+	enum EnImgFormat format;
+	/*! @brief Maximum width. */
+	uint16 width;
+	/*! @brief Maximum height. */
+	uint16 height;
+};
+
+/*! @brief The layout of each role, in the order of enum IMG_TYPE. Must
+ * add up to at most IMG_ARENA_SIZE. */
+static const struct IMG_LAYOUT imgLayouts[MAX_NUM_IMG] =
+{
+	/* SENSORIMG */
+	{ IMG_FORMAT_COLOR, OSC_CAM_MAX_IMAGE_WIDTH/2, OSC_CAM_MAX_IMAGE_HEIGHT/2 },
+	/* BACKGROUND */
+	{ IMG_FORMAT_COLOR, OSC_CAM_MAX_IMAGE_WIDTH/2, OSC_CAM_MAX_IMAGE_HEIGHT/2 },
+	/* THRESHOLD (built when it is fetched, c.f. GetThresholdImage()) */
+	{ IMG_FORMAT_COLOR, 0, 0 },
+	/* PROCESSFRAME0 */
+	{ IMG_FORMAT_BINARY, OSC_CAM_MAX_IMAGE_WIDTH/2, OSC_CAM_MAX_IMAGE_HEIGHT/2 },
+	/* DETECTIMG */
+	{ IMG_FORMAT_PYRAMID, OSC_CAM_MAX_IMAGE_WIDTH/4, OSC_CAM_MAX_IMAGE_HEIGHT/4 },
+	/* DETECTBACKGROUND */
+	{ IMG_FORMAT_PYRAMID, OSC_CAM_MAX_IMAGE_WIDTH/4, OSC_CAM_MAX_IMAGE_HEIGHT/4 },
+	/* LUMAIMG (empty without LAZY_COLORS) */
+	{ IMG_FORMAT_GREY8, LAZY_COLORS*OSC_CAM_MAX_IMAGE_WIDTH/2, LAZY_COLORS*OSC_CAM_MAX_IMAGE_HEIGHT/2 },
+	/* LUMABACKGROUND */
+	{ IMG_FORMAT_GREY8, LAZY_COLORS*OSC_CAM_MAX_IMAGE_WIDTH/2, LAZY_COLORS*OSC_CAM_MAX_IMAGE_HEIGHT/2 }
+};
+
+/*********************************************************************//*!
+ * @brief Number of planes of a pixel format.
+ *//*********************************************************************/
+static uint8 ImgFormatPlanes(enum EnImgFormat format)
+{
+	return (format == IMG_FORMAT_BGR24 || format == IMG_FORMAT_BGR24_PLANAR) ? 3 : 1;
+}
+
+/*********************************************************************//*!
+ * @brief Distance between two rows of a plane for a given width.
+ *//*********************************************************************/
+static uint16 ImgFormatStride(enum EnImgFormat format, uint16 width)
+{
+	return format == IMG_FORMAT_BGR24 ? 3*width : width;
+}
+
+OSC_ERR ImgPoolInit(struct TEMPLATE *pData)
+{
+	struct IMG_POOL *pPool = &pData->imgPool;
+	uint32 offset = 0;
+	int i;
+
+	for (i = 0; i < MAX_NUM_IMG; i++)
+	{
+		struct IMG_DESC *pDesc = &pPool->buffers[i];
+		const struct IMG_LAYOUT *pLayout = &imgLayouts[i];
+
+		pDesc->format = pLayout->format;
+		pDesc->nPlanes = ImgFormatPlanes(pLayout->format);
+		pDesc->width = pLayout->width;
+		pDesc->height = pLayout->height;
+		pDesc->stride = ImgFormatStride(pLayout->format, pLayout->width);
+		pDesc->capacity = (uint32)pDesc->nPlanes*pLayout->width*pLayout->height;
+
+		if (offset + pDesc->capacity > IMG_ARENA_SIZE)
+		{
+			OscLog(ERROR, "%s: Image arena too small for buffer %d!\n", __func__, i);
+			return -EOUT_OF_MEMORY;
+		}
+		pDesc->pData = &pPool->u8Arena[offset];
+		offset += (pDesc->capacity + IMG_ALIGN - 1) & ~(IMG_ALIGN - 1);
+
+		pPool->role[i] = i;
+	}
+	return SUCCESS;
+}
+
+OSC_ERR ImgSetGeometry(struct TEMPLATE *pData, enum IMG_TYPE role, uint16 width, uint16 height)
+{
+	struct IMG_DESC *pDesc = ImgDesc(pData, role);
+	const uint16 stride = ImgFormatStride(pDesc->format, width);
+
+	if ((uint32)pDesc->nPlanes*width*height > pDesc->capacity)
+	{
+		OscLog(ERROR, "%s: %ux%u does not fit buffer of image %d!\n", __func__, width, height, role);
+		return -EBUFFER_TOO_SMALL;
+	}
+	pDesc->width = width;
+	pDesc->height = height;
+	pDesc->stride = stride;
+	return SUCCESS;
+}
+
+void ImgCopyInterleaved(struct TEMPLATE *pData, enum IMG_TYPE role, uint8 *pDst)
+{
+	const struct IMG_DESC *pDesc = ImgDesc(pData, role);
+	const uint32 nPix = (uint32)pDesc->width*pDesc->height;
+	const uint8 *pB = pDesc->pData, *pG = pB + nPix, *pR = pG + nPix;
+	uint32 i;
+
+	if (pDesc->format != IMG_FORMAT_BGR24_PLANAR)
+	{
+		memcpy(pDst, pDesc->pData, ImgSize(pData, role));
+		return;
+	}
+	for (i = 0; i < nPix; i++)
+	{
+		*pDst++ = pB[i];
+		*pDst++ = pG[i];
+		*pDst++ = pR[i];
+	}
+}
+
+void ImgSwapRoles(struct TEMPLATE *pData, enum IMG_TYPE roleA, enum IMG_TYPE roleB)
+{
+	struct IMG_POOL *pPool = &pData->imgPool;
+	const uint8 tmp = pPool->role[roleA];
+
+	pPool->role[roleA] = pPool->role[roleB];
+	pPool->role[roleB] = tmp;
+}
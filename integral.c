@@ -0,0 +1,69 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file integral.c
+ * @brief Summed-area tables of the foreground colour and the foreground
+ * mask for box queries in constant time.
+ *
+ * The tables have an additional leading row and column of zeros, so
+ * queries need no special cases at the image border.
+ */
+
+#include "integral.h"
+#include "lanestate.h"
+#include <string.h>
+
+void BuildIntegralImages(struct TEMPLATE *pData, const uint8 *pImg, const uint8 *pMask, uint8 maskShift)
+{
+	struct INTEGRAL_SUM *sat = pData->pState->integral.sat;
+	const uint16 maskWidth = SAT_WIDTH >> maskShift;
+	uint32 i = 0;
+	uint16 x, y, cpl;
+
+	memset(sat, 0, SAT_STRIDE*sizeof(struct INTEGRAL_SUM));
+	for (y = 0; y < SAT_HEIGHT; y++)
+	{
+		const uint8 *pMaskRow = &pMask[(y >> maskShift)*maskWidth];
+		const struct INTEGRAL_SUM *pAbove = &sat[y*SAT_STRIDE];
+		struct INTEGRAL_SUM *pCur = &sat[(y + 1)*SAT_STRIDE];
+		struct INTEGRAL_SUM rowSum;
+
+		memset(&rowSum, 0, sizeof(rowSum));
+		memset(pCur, 0, sizeof(struct INTEGRAL_SUM));
+		for (x = 0; x < SAT_WIDTH; x++, i++)
+		{
+			/* 0 or 1; used as a factor to avoid a branch per pixel. */
+			const uint32 m = pMaskRow[x >> maskShift];
+
+			for (cpl = 0; cpl < NUM_COLORS; cpl++)
+			{
+				rowSum.sum[cpl] += m*pImg[COLOR_INDEX(i, cpl, SAT_WIDTH*SAT_HEIGHT)];
+				pCur[x + 1].sum[cpl] = pAbove[x + 1].sum[cpl] + rowSum.sum[cpl];
+			}
+			rowSum.fg += m;
+			pCur[x + 1].fg = pAbove[x + 1].fg + rowSum.fg;
+		}
+	}
+}
+
+void IntegralBoxSum(struct TEMPLATE *pData, const struct IMG_RECT *pBox, struct INTEGRAL_SUM *pSum)
+{
+	const struct INTEGRAL_SUM *sat = pData->pState->integral.sat;
+	const uint16 x0 = pBox->xPos < SAT_WIDTH ? pBox->xPos : SAT_WIDTH;
+	const uint16 y0 = pBox->yPos < SAT_HEIGHT ? pBox->yPos : SAT_HEIGHT;
+	const uint16 x1 = pBox->xPos + pBox->width < SAT_WIDTH ? pBox->xPos + pBox->width : SAT_WIDTH;
+	const uint16 y1 = pBox->yPos + pBox->height < SAT_HEIGHT ? pBox->yPos + pBox->height : SAT_HEIGHT;
+	const struct INTEGRAL_SUM *pA = &sat[y0*SAT_STRIDE + x0];
+	const struct INTEGRAL_SUM *pB = &sat[y0*SAT_STRIDE + x1];
+	const struct INTEGRAL_SUM *pC = &sat[y1*SAT_STRIDE + x0];
+	const struct INTEGRAL_SUM *pD = &sat[y1*SAT_STRIDE + x1];
+	uint16 cpl;
+
+	for (cpl = 0; cpl < NUM_COLORS; cpl++)
+	{
+		pSum->sum[cpl] = pD->sum[cpl] - pB->sum[cpl] - pC->sum[cpl] + pA->sum[cpl];
+	}
+	pSum->fg = pD->fg - pB->fg - pC->fg + pA->fg;
+}
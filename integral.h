@@ -0,0 +1,67 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file integral.h
+ * @brief Summed-area tables of the foreground colour and the foreground
+ * mask for box queries in constant time.
+ *
+ * The tables are built at most once per frame and only when a box is
+ * queried: for the region of interest and for the bounding boxes of the
+ * regions reported by GET_REGION_COLORS.
+ */
+#ifndef INTEGRAL_H_
+#define INTEGRAL_H_
+
+#include "template.h"
+
+/*! @brief Sums over a box of the image. */
+struct INTEGRAL_SUM
+{
+	/*! @brief Sum of each colour plane over the foreground pixels. */
+	uint32 sum[NUM_COLORS];
+	/*! @brief Number of foreground pixels. */
+	uint32 fg;
+};
+
+/*! @brief Width of the integrated image. */
+#define SAT_WIDTH (OSC_CAM_MAX_IMAGE_WIDTH/2)
+/*! @brief Height of the integrated image. */
+#define SAT_HEIGHT (OSC_CAM_MAX_IMAGE_HEIGHT/2)
+/*! @brief Distance between two rows of the table. */
+#define SAT_STRIDE (SAT_WIDTH + 1)
+
+/*! @brief The summed-area table of a lane; entry (x, y) holds the sums
+ * over all pixels left of column x and above row y. */
+struct INTEGRAL_TABLE
+{
+	struct INTEGRAL_SUM sat[(SAT_HEIGHT + 1)*SAT_STRIDE];
+};
+
+/*********************************************************************//*!
+ * @brief Build the summed-area tables of the current frame.
+ *
+ * All colour planes and the mask are integrated in one pass over the
+ * image. Only foreground pixels contribute to the colour sums, so a box
+ * query yields the mean colour of the foreground inside the box.
+ *
+ * @param pData The data object of the lane.
+ * @param pImg Colour image of half the camera resolution (SENSORIMG).
+ * @param pMask Binary foreground mask, possibly of a coarser pyramid
+ * level.
+ * @param maskShift log2 of the resolution ratio between pImg and pMask.
+ *//*********************************************************************/
+void BuildIntegralImages(struct TEMPLATE *pData, const uint8 *pImg, const uint8 *pMask, uint8 maskShift);
+
+/*********************************************************************//*!
+ * @brief Get the sums over a box of the last frame in constant time.
+ *
+ * @param pData The data object of the lane.
+ * @param pBox The box in pixels of SENSORIMG; it is clipped to the
+ * image.
+ * @param pSum Receives the sums.
+ *//*********************************************************************/
+void IntegralBoxSum(struct TEMPLATE *pData, const struct IMG_RECT *pBox, struct INTEGRAL_SUM *pSum);
+
+#endif /*INTEGRAL_H_*/
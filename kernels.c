@@ -0,0 +1,92 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file kernels.c
+ * @brief Pixel kernels with the colour planes unrolled for NUM_COLORS.
+ */
+
+#include "kernels.h"
+#include <stdlib.h>
+
+/*! @brief Forces a kernel to be inlined into each caller. */
+#define KERNEL static inline __attribute__((always_inline))
+
+/*! @brief Width of SENSORIMG. */
+#define SENSOR_WIDTH (OSC_CAM_MAX_IMAGE_WIDTH/2)
+
+/*********************************************************************//*!
+ * @brief Sum of the absolute differences over the colour planes of
+ * pixel i; stride is the distance between two planes.
+ *//*********************************************************************/
+KERNEL int PixelDiff(const uint8 *pImg, const uint8 *pBg, const int i, const int stride)
+{
+#if NUM_COLORS == 1
+	return abs(pImg[i] - pBg[i]);
+#else
+	return abs(pImg[i] - pBg[i])
+		+ abs(pImg[i + stride] - pBg[i + stride])
+		+ abs(pImg[i + 2*stride] - pBg[i + 2*stride]);
+#endif
+}
+
+/*********************************************************************//*!
+ * @brief Change detection for the pixels [begin, end) of images with
+ * size pixels.
+ *//*********************************************************************/
+KERNEL void ChangeDetectionKernel(const uint8 *pImg, const uint8 *pBg, uint8 *pMask, const int threshold,
+		const int size, const int begin, const int end, const bool bPlanar)
+{
+	int i;
+
+	for (i = begin; i < end; i++)
+	{
+		if (bPlanar)
+			pMask[i] = PixelDiff(pImg, pBg, i, size) > threshold;
+		else
+			pMask[i] = PixelDiff(pImg, pBg, i*NUM_COLORS, 1) > threshold;
+	}
+}
+
+void ChangeDetectionRows(const uint8 *pImg, const uint8 *pBg, int width, int height, bool bPlanar,
+		int rowStart, int rowEnd, int threshold, uint8 *pMask)
+{
+	if (bPlanar)
+		ChangeDetectionKernel(pImg, pBg, pMask, threshold, width*height, rowStart*width, rowEnd*width, TRUE);
+	else
+		ChangeDetectionKernel(pImg, pBg, pMask, threshold, width*height, rowStart*width, rowEnd*width, FALSE);
+}
+
+/*********************************************************************//*!
+ * @brief Set pixels [i, end) of an interleaved image of the size of
+ * SENSORIMG to a colour.
+ *//*********************************************************************/
+KERNEL void PaintSpan(uint8 *pImg, int i, const int end, const uint8 col[3])
+{
+	for (; i < end; i++)
+	{
+#if NUM_COLORS == 1
+		pImg[i] = col[0];
+#else
+		pImg[3*i] = col[0];
+		pImg[3*i + 1] = col[1];
+		pImg[3*i + 2] = col[2];
+#endif
+	}
+}
+
+void PaintRuns(uint8 *pImg, const struct OSC_VIS_REGIONS_RUN *pRun, uint8 shift, const uint8 col[3])
+{
+	for (; pRun != 0; pRun = pRun->next)
+	{
+		const int start = pRun->startColumn << shift;
+		const int end = pRun->endColumn << shift;
+		int r;
+
+		for (r = pRun->row << shift; r < (pRun->row + 1) << shift; r++)
+		{
+			PaintSpan(pImg, SENSOR_WIDTH*r + start, SENSOR_WIDTH*r + end, col);
+		}
+	}
+}
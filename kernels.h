@@ -0,0 +1,50 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file kernels.h
+ * @brief Pixel kernels with the colour planes unrolled for NUM_COLORS.
+ *
+ * The change detection walks the pixels in one flat loop and is shared
+ * by the whole frame and the bands (c.f. band.h).
+ */
+#ifndef KERNELS_H_
+#define KERNELS_H_
+
+#include "template.h"
+
+/*********************************************************************//*!
+ * @brief Change detection for a band of rows of images of any size.
+ *
+ * Only reads its arguments, so bands of one image can be processed by
+ * several threads at once; the whole image is a band from row 0 to
+ * height.
+ *
+ * @param pImg The current image.
+ * @param pBg The background image.
+ * @param width Width of the images.
+ * @param height Height of the images.
+ * @param bPlanar Whether the images are planar or interleaved.
+ * @param rowStart First row of the band.
+ * @param rowEnd Row after the band.
+ * @param threshold Limit of the summed absolute difference over the
+ * colour planes.
+ * @param pMask The mask of the whole image.
+ *//*********************************************************************/
+void ChangeDetectionRows(const uint8 *pImg, const uint8 *pBg, int width, int height, bool bPlanar,
+		int rowStart, int rowEnd, int threshold, uint8 *pMask);
+
+/*********************************************************************//*!
+ * @brief Paint the runs of a region into a copy of SENSORIMG.
+ *
+ * The runs are scaled up by 2^shift.
+ *
+ * @param pImg The copy, interleaved as written by ImgCopyInterleaved().
+ * @param pRun The first run of the region.
+ * @param shift log2 of the ratio between SENSORIMG and the labeled image.
+ * @param col The colour, blue, green, red.
+ *//*********************************************************************/
+void PaintRuns(uint8 *pImg, const struct OSC_VIS_REGIONS_RUN *pRun, uint8 shift, const uint8 col[3]);
+
+#endif /*KERNELS_H_*/
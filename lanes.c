@@ -0,0 +1,207 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file lanes.c
+ * @brief Additional processing lanes fed from recordings or an emulated
+ * camera, each running in a thread of its own (host only).
+ */
+
+#include "lanes.h"
+#include "lanestate.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/*! @brief Size of a raw frame in bytes. */
+#define RAW_FRAME_SIZE (OSC_CAM_MAX_IMAGE_WIDTH*OSC_CAM_MAX_IMAGE_HEIGHT)
+/*! @brief Edge length of the object moving through the emulated camera
+ * image (raw pixels). */
+#define EMU_OBJECT_SIZE 80
+/*! @brief Raw pixels the emulated object moves per frame. */
+#define EMU_OBJECT_SPEED 12
+
+/*! @brief A lane other than the camera. */
+struct LANE
+{
+	/*! @brief Index of the lane (1 ... MAX_LANES). */
+	uint8 nLane;
+	/*! @brief Name of the recording or "-" for emulation. */
+	const char *strSource;
+	/*! @brief The open recording; NULL for emulation. */
+	FILE *pFile;
+	/*! @brief The processing parameters at start-up. */
+	struct APPLICATION_STATE params;
+	/*! @brief The thread running the lane. */
+	pthread_t thread;
+};
+
+/*! @brief The registered lanes. */
+static struct LANE lanes[MAX_LANES];
+/*! @brief Number of registered lanes. */
+static uint8 nLanes = 0;
+/*! @brief Results and counters of the lanes; written by the lanes, read
+ * by the IPC. */
+static struct LANE_STATS laneStats[MAX_LANES];
+/*! @brief Protects laneStats. */
+static pthread_mutex_t laneStatsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+OSC_ERR AddLane(const char *strSource)
+{
+#if !defined(OSC_HOST)
+	OscLog(ERROR, "%s: lanes are only supported on the host!\n", __func__);
+	return -EINVALID_PARAMETER;
+#else
+	if (nLanes == MAX_LANES)
+	{
+		OscLog(ERROR, "%s: no more than %d lanes!\n", __func__, MAX_LANES);
+		return -EINVALID_PARAMETER;
+	}
+	lanes[nLanes].nLane = nLanes + 1;
+	lanes[nLanes].strSource = strSource;
+	nLanes++;
+	return SUCCESS;
+#endif
+}
+
+/*********************************************************************//*!
+ * @brief Get the next raw frame of a lane.
+ *
+ * Recordings start over at their end. The emulation moves a bright
+ * square over a noisy grey background.
+ *//*********************************************************************/
+static OSC_ERR ReadLaneFrame(struct LANE *pLane, uint8 *pRaw, uint32 nFrame)
+{
+	uint32 i, x, y, pos;
+	unsigned int seed = nFrame;
+
+	if (pLane->pFile != NULL)
+	{
+		if (fread(pRaw, RAW_FRAME_SIZE, 1, pLane->pFile) == 1)
+			return SUCCESS;
+		rewind(pLane->pFile);
+		if (fread(pRaw, RAW_FRAME_SIZE, 1, pLane->pFile) == 1)
+			return SUCCESS;
+		return -EFILE_ERROR;
+	}
+
+	for (i = 0; i < RAW_FRAME_SIZE; i++)
+	{
+		pRaw[i] = 96 + (rand_r(&seed) & 7);
+	}
+	/* The square enters on the left, crosses and leaves again. */
+	pos = (nFrame*EMU_OBJECT_SPEED) % (OSC_CAM_MAX_IMAGE_WIDTH + 2*EMU_OBJECT_SIZE);
+	for (y = (OSC_CAM_MAX_IMAGE_HEIGHT - EMU_OBJECT_SIZE)/2; y < (OSC_CAM_MAX_IMAGE_HEIGHT + EMU_OBJECT_SIZE)/2; y++)
+	{
+		for (x = pos; x < pos + EMU_OBJECT_SIZE; x++)
+		{
+			if (x >= EMU_OBJECT_SIZE && x < OSC_CAM_MAX_IMAGE_WIDTH + EMU_OBJECT_SIZE)
+				pRaw[y*OSC_CAM_MAX_IMAGE_WIDTH + x - EMU_OBJECT_SIZE] = 230;
+		}
+	}
+	return SUCCESS;
+}
+
+/*********************************************************************//*!
+ * @brief Body of a lane thread.
+ *//*********************************************************************/
+static void *LaneMain(void *pArg)
+{
+	struct LANE *pLane = (struct LANE*)pArg;
+	struct LANE_STATS *pStats = &laneStats[pLane->nLane - 1];
+	uint32 secondStart = OscSupCycGet(), nSecondFrames = 0;
+	uint32 nFrame = 0;
+	struct TEMPLATE *pData;
+
+	/* The lane's own data object and processing state. */
+	pData = calloc(1, sizeof(struct TEMPLATE));
+	if (pData == NULL)
+	{
+		OscLog(ERROR, "%s: cannot allocate lane %d!\n", __func__, pLane->nLane);
+		return NULL;
+	}
+	pData->nLane = pLane->nLane;
+	if (ImgPoolInit(pData) != SUCCESS || LaneStateInit(pData) != SUCCESS)
+		return NULL;
+	pData->ipc.state = pLane->params;
+	pData->ipc.state.nStepCounter = 0;
+	pData->ipc.state.nObjectClass = OBJ_CLASS_NONE;
+	/* Only the camera has an encoder; the lanes eject after frames. */
+	pData->ipc.state.nEjectDistance = 0;
+	pData->nFramesElapsed = 1;
+	pData->pCurRawImg = pData->u8FrameBuffers[0];
+
+	pthread_mutex_lock(&laneStatsMutex);
+	pStats->bRunning = TRUE;
+	pthread_mutex_unlock(&laneStatsMutex);
+
+	while (ReadLaneFrame(pLane, pData->pCurRawImg, nFrame++) == SUCCESS)
+	{
+		uint32 start = OscSupCycGet(), time;
+
+		pData->ipc.state.nStepCounter++;
+		ProcessRawFrame(pData);
+		time = OscSupCycToMicroSecs(OscSupCycGet() - start);
+		nSecondFrames++;
+
+		pthread_mutex_lock(&laneStatsMutex);
+		pStats->nFrames++;
+		pStats->nProcessTime = time;
+		if (time > pStats->nMaxProcessTime)
+			pStats->nMaxProcessTime = time;
+		pStats->nObjectClass = pData->ipc.state.nObjectClass;
+		pStats->bForeground = pData->bForeground;
+		if (OscSupCycToMicroSecs(OscSupCycGet() - secondStart) >= 1000000)
+		{
+			pStats->nFramesPerSecond = nSecondFrames;
+			nSecondFrames = 0;
+			secondStart = OscSupCycGet();
+		}
+		pthread_mutex_unlock(&laneStatsMutex);
+	}
+
+	OscLog(ERROR, "%s: lane %d stopped, cannot read %s!\n", __func__, pLane->nLane, pLane->strSource);
+	pthread_mutex_lock(&laneStatsMutex);
+	pStats->bRunning = FALSE;
+	pthread_mutex_unlock(&laneStatsMutex);
+	return NULL;
+}
+
+OSC_ERR StartLanes()
+{
+	uint8 i;
+
+	for (i = 0; i < nLanes; i++)
+	{
+		struct LANE *pLane = &lanes[i];
+
+		pLane->params = data.ipc.state;
+		if (strcmp(pLane->strSource, "-") != 0)
+		{
+			pLane->pFile = fopen(pLane->strSource, "rb");
+			if (pLane->pFile == NULL)
+			{
+				OscLog(ERROR, "%s: cannot open %s!\n", __func__, pLane->strSource);
+				return -EUNABLE_TO_OPEN_FILE;
+			}
+		}
+		if (pthread_create(&pLane->thread, NULL, LaneMain, pLane) != 0)
+		{
+			OscLog(ERROR, "%s: cannot start lane %d!\n", __func__, pLane->nLane);
+			return -EOUT_OF_MEMORY;
+		}
+		OscLog(INFO, "Lane %d processes %s\n", pLane->nLane, pLane->strSource);
+	}
+	data.ipc.state.nLanes = nLanes;
+	return SUCCESS;
+}
+
+void GetLaneStats(struct LANES_INFO *pInfo)
+{
+	pthread_mutex_lock(&laneStatsMutex);
+	pInfo->nLanes = nLanes;
+	memcpy(pInfo->lanes, laneStats, sizeof(laneStats));
+	pthread_mutex_unlock(&laneStatsMutex);
+}
@@ -0,0 +1,48 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file lanes.h
+ * @brief Additional processing lanes fed from recordings or an emulated
+ * camera, each running in a thread of its own (host only).
+ *
+ * A lane works on a data object and a processing state of its own,
+ * which are passed to ProcessRawFrame() (c.f. lanestate.h), so the
+ * processing needs no locking. The camera is lane 0 and is served by the
+ * state machine with the global data object as before.
+ */
+#ifndef LANES_H_
+#define LANES_H_
+
+#include "template.h"
+
+/*********************************************************************//*!
+ * @brief Register an additional lane before StartLanes() is called.
+ *
+ * @param strSource File of raw frames (width*height bytes each, played
+ * in a loop) or "-" for an emulated camera.
+ * @return SUCCESS, -EINVALID_PARAMETER if all lanes are taken or lanes
+ * are not supported.
+ *//*********************************************************************/
+OSC_ERR AddLane(const char *strSource);
+
+/*********************************************************************//*!
+ * @brief Start the threads of all registered lanes.
+ *
+ * The lanes take their processing parameters from the current state of
+ * the camera lane.
+ *
+ * @return SUCCESS or an appropriate error code.
+ *//*********************************************************************/
+OSC_ERR StartLanes();
+
+/*********************************************************************//*!
+ * @brief Get the results and performance counters of all lanes except
+ * the camera.
+ *
+ * @param pInfo The answer of the GET_LANE_STATS request.
+ *//*********************************************************************/
+void GetLaneStats(struct LANES_INFO *pInfo);
+
+#endif /*LANES_H_*/
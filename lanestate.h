@@ -0,0 +1,113 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file lanestate.h
+ * @brief State of the processing of a lane.
+ *
+ * Every lane processes with a data object of its own (c.f. lanes.h),
+ * which is passed to the processing as pData and holds this state. Only
+ * the lane threads have one; no other thread carries a copy.
+ */
+#ifndef LANESTATE_H_
+#define LANESTATE_H_
+
+#include "template.h"
+#include "colorhist.h"
+#include "morph.h"
+#include "integral.h"
+#include "motion.h"
+#include "overlay.h"
+#include "stats.h"
+#include "encoder.h"
+
+/*! @brief Number of ejections that can be pending. */
+#define sizetimebuffer 10
+/*! @brief Marks a free entry of the ejection queue; no step or belt
+ * position a decision is stamped with. */
+#define TIMESTAMP_EMPTY (-1)
+
+/*! @brief The state of process_frame.c and of the modules it uses. */
+struct LANE_STATE
+{
+	/*! @brief Step the classified object was activated in. */
+	long framestep;
+	/*! @brief Colour sums of the activated object. */
+	long colorcounter[3];
+	/*! @brief Number of values summed up in colorcounter. */
+	long stp;
+	/*! @brief Area and index of the biggest region of the frame. */
+	int BiggestArea, RegionNumber;
+	/*! @brief Mean colour of the activated object. */
+	int coloravarage[3];
+	/*! @brief Steps (or belt positions) of the pending ejections;
+	 * TIMESTAMP_EMPTY if free. */
+	int timestamp[sizetimebuffer];
+	/*! @brief Frames the output stays switched on. */
+	int gpiotimer;
+	/*! @brief Steps since the activation. */
+	int framediff;
+	/*! @brief Colour histogram of the activated object accumulated like
+	 * colorcounter. */
+	uint32 colorhist[HIST_NUM_BINS];
+	/*! @brief The mask and SENSORIMG wrapped for the Oscar functions. */
+	struct OSC_PICTURE Pic1, Pic2;
+	/*! @brief The foreground objects of the last processed frame. */
+	struct OSC_VIS_REGIONS ImgRegions;
+	/*! @brief Colour sums and histograms of the regions in ImgRegions. */
+	struct REGION_COLOR RegionColors[MAX_REGION_COLORS];
+	/*! @brief Number of valid entries in RegionColors. */
+	uint16 nRegionColors;
+	/*! @brief log2 of the resolution ratio between SENSORIMG and the
+	 * image the regions are detected in. */
+	int detectShift;
+	/*! @brief State of the digital output. */
+	int outputIO;
+	/*! @brief A decision was taken in the current frame. */
+	int decisionTaken;
+	/*! @brief The last processed frame was empty; its raw image is the
+	 * motion reference. */
+	int sceneEmpty;
+	/*! @brief PROCESSFRAME0 holds the mask of the last processed frame. */
+	int maskValid;
+	/*! @brief The mask of the last processed frame packed (c.f.
+	 * CleanupMask()); NULL if it was not cleaned up. */
+	const uint32 *pPackedMask;
+	/*! @brief The summed-area tables belong to the last processed frame. */
+	int integralValid;
+
+	/*! @brief Buffers of the mask cleanup (c.f. morph.h). */
+	struct MORPH_BUFFERS morph;
+	/*! @brief The summed-area tables (c.f. integral.h). */
+	struct INTEGRAL_TABLE integral;
+	/*! @brief The motion reference (c.f. motion.h). */
+	struct MOTION_REFERENCE motion;
+	/*! @brief The markings of the frame (c.f. overlay.h). */
+	struct OVERLAY_LIST overlay;
+	/*! @brief The production counters (c.f. stats.h). */
+	struct STATS_COUNTERS stats;
+	/*! @brief The belt encoder (c.f. encoder.h). */
+	struct ENCODER encoder;
+};
+
+/*********************************************************************//*!
+ * @brief Allocate the processing state of a lane.
+ *
+ * @param pData The data object of the lane; receives the state in
+ * pState.
+ * @return SUCCESS or -EOUT_OF_MEMORY.
+ *//*********************************************************************/
+OSC_ERR LaneStateInit(struct TEMPLATE *pData);
+
+/*********************************************************************//*!
+ * @brief Drop the pending ejections, counted as lost.
+ *
+ * Needed when the ejection changes between frames and encoder pulses,
+ * the stamps of the pending ones cannot be converted.
+ *
+ * @param pData The data object of the lane.
+ *//*********************************************************************/
+void FlushEjections(struct TEMPLATE *pData);
+
+#endif /*LANESTATE_H_*/
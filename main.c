@@ -9,6 +9,9 @@
  */
 
 #include "template.h"
+#include "lanes.h"
+#include "archive.h"
+#include "lanestate.h"
 #include <string.h>
 #include <sched.h>
 #include <errno.h>
@@ -41,6 +44,11 @@ OscFunction(static Init, const int argc, const char * argv[])
 		&OscModule_log,
 		&OscModule_sup);
 
+	/* Assign the image buffers to their roles (may log, so after the
+	 * framework is created). */
+	OscCall( ImgPoolInit, &data);
+	OscCall( LaneStateInit, &data);
+
 	/* Seed the random generator */
 	srand(OscSupCycGet());
 
@@ -80,13 +88,46 @@ OscFunctionEnd()
  *//*********************************************************************/
 OscFunction( mainFunction, const int argc, const char * argv[])
 
+	int i;
+
 	/* Initialize system */
 	OscCall( Init, argc, argv);
 
 	OscLogSetConsoleLogLevel(INFO);
 	OscLogSetFileLogLevel(WARN);
 
-	StateControl();
+	/* -l <file> adds a lane processing a raw recording, -l - one with
+	 * an emulated camera. -a <archive> replays an archive instead of
+	 * capturing from the camera. */
+	for (i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "-l") == 0)
+		{
+			OscCall( AddLane, argv[++i]);
+		}
+		else if (strcmp(argv[i], "-a") == 0)
+		{
+			OscCall( ArchiveSetSource, argv[++i]);
+		}
+	}
+
+	/* -b runs the kernel benchmarks instead of the application,
+	 * -c <archive> <file>... converts BMP files and black-box recordings
+	 * to an archive. */
+	if (argc > 1 && strcmp(argv[1], "-b") == 0)
+	{
+		RunBenchmarks();
+		OscDestroy();
+	}
+	else if (argc > 3 && strcmp(argv[1], "-c") == 0)
+	{
+		OscCall( ArchiveConvert, argv[2], argc - 3, &argv[3]);
+		OscDestroy();
+	}
+	else
+	{
+		StateControl();
+	}
 
 OscFunctionCatch()
 	OscDestroy();
@@ -11,6 +11,18 @@
 
 #include "template.h"
 #include "mainstate.h"
+#include "debayer.h"
+#include "exposure.h"
+#include "lanes.h"
+#include "band.h"
+#include "recorder.h"
+#include "archive.h"
+#include "encoder.h"
+#include "stats.h"
+#include "overlay.h"
+#include "snapshot.h"
+#include "warmstart.h"
+#include "lanestate.h"
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -20,7 +32,10 @@ const Msg mainStateMsg[] = {
 	{ FRAMEPAR_EVT },
 	{ IPC_GET_APP_STATE_EVT },
 	{ IPC_GET_NEW_IMG_EVT },
-	{ IPC_SET_IMAGE_TYPE_EVT }
+	{ IPC_SET_IMAGE_TYPE_EVT },
+	{ IPC_GET_REGION_COLORS_EVT },
+	{ IPC_GET_LANE_STATS_EVT },
+	{ IPC_GET_STATS_HISTORY_EVT }
 };
 
 /*********************************************************************//*!
@@ -35,6 +50,30 @@ void ThrowEvent(struct MainState *pHsm, unsigned int evt)
 	HsmOnEvent((Hsm*)pHsm, pMsg);
 }
 
+/*********************************************************************//*!
+ * @brief Read the GPIO inputs.
+ *
+ * @return The state of the inputs, bit n for input n + 1; an input
+ * that cannot be read counts as low.
+ *//*********************************************************************/
+static uint8 ReadGpioInputs(void)
+{
+	bool bIn1 = FALSE, bIn2 = FALSE;
+
+	/* A replay has the inputs recorded with its frames. */
+	if(ArchiveIsSource())
+	{
+		ArchiveGpioRead(GPIO_IN1, &bIn1);
+		ArchiveGpioRead(GPIO_IN2, &bIn2);
+	}
+	else
+	{
+		OscGpioRead(GPIO_IN1, &bIn1);
+		OscGpioRead(GPIO_IN2, &bIn2);
+	}
+	return (bIn1 ? 1 : 0) | (bIn2 ? 2 : 0);
+}
+
 /*********************************************************************//*!
  * @brief Checks for IPC events, schedules their handling and
  * acknowledges any executed ones.
@@ -54,16 +93,45 @@ static OSC_ERR HandleIpcRequests(MainState *pMainState)
 	{
 		/* We have a request. See to it that it is handled
 		 * depending on the state we're in. */
-		switch(paramId)
+		switch(paramId & IPC_PARAM_MASK)
 		{
 		case GET_APP_STATE:
 			/* Request for the current state of the application. */
 			ThrowEvent(pMainState, IPC_GET_APP_STATE_EVT);
 			break;
 		case GET_NEW_IMG:
-			/* Request for the live image. */
+			/* Request for the live image. The next one is complete even
+			 * with LAZY_COLORS. */
+			data.bPreviewWanted = TRUE;
 			ThrowEvent(pMainState, IPC_GET_NEW_IMG_EVT);
 			break;
+		case GET_SNAPSHOT:
+			/* Request for an image of a recent frame, named by the request
+			 * itself; answered in any state from the snapshot ring, NACK
+			 * for a frame no longer kept. (With LAZY_COLORS the next frame
+			 * is debayered in full.) */
+			data.bPreviewWanted = TRUE;
+			if(SnapshotGet(paramId, (struct SNAPSHOT*)pReq->pAddr) == SUCCESS)
+			{
+				data.ipc.enReqState = REQ_STATE_ACK_PENDING;
+			}
+			else
+			{
+				data.ipc.enReqState = REQ_STATE_NACK_PENDING;
+			}
+			break;
+		case GET_REGION_COLORS:
+			/* Request for the colour statistics of the regions. */
+			ThrowEvent(pMainState, IPC_GET_REGION_COLORS_EVT);
+			break;
+		case GET_LANE_STATS:
+			/* Request for the results of the other lanes. */
+			ThrowEvent(pMainState, IPC_GET_LANE_STATS_EVT);
+			break;
+		case GET_STATS_HISTORY:
+			/* Request for the production statistics of the last seconds. */
+			ThrowEvent(pMainState, IPC_GET_STATS_HISTORY_EVT);
+			break;
 		case SET_IMAGE_TYPE:
 		{
 			/* Set the new image type. */
@@ -82,10 +150,15 @@ static OSC_ERR HandleIpcRequests(MainState *pMainState)
 		}
 		case SET_EXPOSURE_TIME:
 			// a new exposure time was given
+			// (with automatic exposure it only limits the shutter time)
 			if(data.ipc.state.nExposureTime != *((int*)pReq->pAddr))
 			{
-				data.nExposureTimeChanged = true;
 				data.ipc.state.nExposureTime = *((int*)pReq->pAddr);
+				if(!data.ipc.state.bAutoExposure)
+				{
+					data.ipc.state.nShutterWidth = data.ipc.state.nExposureTime * 100;
+					data.nExposureTimeChanged = true;
+				}
 			}
 			data.ipc.enReqState = REQ_STATE_ACK_PENDING;//we return immediately
 			break;
@@ -97,6 +170,129 @@ static OSC_ERR HandleIpcRequests(MainState *pMainState)
 			}
 			data.ipc.enReqState = REQ_STATE_ACK_PENDING;//we return immediately
 			break;
+		case SET_DETECT_LEVEL:
+		{
+			int level = *((int*)pReq->pAddr);
+			if(level < 1 || level > MAX_DETECT_LEVEL)
+			{
+				OscLog(ERROR, "%s: invalid detection level: %d!\n", __func__, level);
+				data.ipc.enReqState = REQ_STATE_NACK_PENDING;
+			}
+			else
+			{
+				/* The background is rebuilt with the next frame. */
+				data.ipc.state.nDetectLevel = level;
+				data.ipc.enReqState = REQ_STATE_ACK_PENDING;
+			}
+			break;
+		}
+		case SET_MORPH_OP:
+		{
+			int op = *((int*)pReq->pAddr);
+			if(op < MORPH_NONE || op > MORPH_CLOSE)
+			{
+				OscLog(ERROR, "%s: invalid morphological operator: %d!\n", __func__, op);
+				data.ipc.enReqState = REQ_STATE_NACK_PENDING;
+			}
+			else
+			{
+				data.ipc.state.nMorphOp = op;
+				data.ipc.enReqState = REQ_STATE_ACK_PENDING;
+			}
+			break;
+		}
+		case SET_MIN_AREA:
+		{
+			/* In pixels of SENSORIMG; an area above the image keeps no
+			 * region at all. */
+			int area = *((int*)pReq->pAddr);
+			if(area < 0 || area > IMG_SIZE_HALF_MASK)
+			{
+				OscLog(ERROR, "%s: invalid minimal region area: %d!\n", __func__, area);
+				data.ipc.enReqState = REQ_STATE_NACK_PENDING;
+			}
+			else
+			{
+				data.ipc.state.nMinArea = area;
+				data.ipc.enReqState = REQ_STATE_ACK_PENDING;
+			}
+			break;
+		}
+		case SET_BAND_THREADS:
+		{
+			int nThreads = *((int*)pReq->pAddr);
+#if defined(OSC_HOST)
+			if(nThreads < 1 || nThreads > MAX_BAND_THREADS)
+#else
+			if(nThreads != 1)
+#endif
+			{
+				OscLog(ERROR, "%s: invalid number of band threads: %d!\n", __func__, nThreads);
+				data.ipc.enReqState = REQ_STATE_NACK_PENDING;
+			}
+#if defined(OSC_HOST)
+			else if(BandInit(nThreads) != SUCCESS)
+			{
+				OscLog(ERROR, "%s: cannot start %d band threads!\n", __func__, nThreads);
+				data.ipc.enReqState = REQ_STATE_NACK_PENDING;
+			}
+#endif
+			else
+			{
+				data.ipc.state.nBandThreads = nThreads;
+				data.ipc.enReqState = REQ_STATE_ACK_PENDING;
+			}
+			break;
+		}
+		case SET_AUTO_EXPOSURE:
+			data.ipc.state.bAutoExposure = *((int*)pReq->pAddr) != 0;
+			if(!data.ipc.state.bAutoExposure)
+			{
+				/* Back to the manually set shutter time. */
+				data.ipc.state.nShutterWidth = data.ipc.state.nExposureTime * 100;
+				data.nExposureTimeChanged = true;
+			}
+			data.ipc.enReqState = REQ_STATE_ACK_PENDING;//we return immediately
+			break;
+		case SET_EJECT_DISTANCE:
+		{
+			int distance = *((int*)pReq->pAddr);
+			if(distance < 0)
+			{
+				OscLog(ERROR, "%s: invalid eject distance: %d!\n", __func__, distance);
+				data.ipc.enReqState = REQ_STATE_NACK_PENDING;
+			}
+			else
+			{
+				/* Steps and belt positions do not convert, so the
+				 * pending ejections are dropped when the mode changes. */
+				if((distance > 0) != (data.ipc.state.nEjectDistance > 0))
+				{
+					FlushEjections(&data);
+				}
+				data.ipc.state.nEjectDistance = distance;
+				data.ipc.enReqState = REQ_STATE_ACK_PENDING;
+			}
+			break;
+		}
+		case WAIT_NEW_FRAME:
+			/* A client waits for the next frame; it polls nFrameSeq
+			 * itself, so the channel stays free for the others. The
+			 * frame is debayered in full for it (c.f. LAZY_COLORS). */
+			data.bPreviewWanted = TRUE;
+			data.ipc.enReqState = REQ_STATE_ACK_PENDING;//we return immediately
+			break;
+		case TRIGGER_RECORDING:
+			/* The recording is written once the frames after the trigger
+			 * are in. */
+			RecorderTrigger();
+			data.ipc.enReqState = REQ_STATE_ACK_PENDING;//we return immediately
+			break;
+		case SET_ROI:
+			/* A region of interest with zero size disables the integral images. */
+			data.ipc.state.roi = *((struct IMG_RECT*)pReq->pAddr);
+			data.ipc.enReqState = REQ_STATE_ACK_PENDING;//we return immediately
+			break;
 		default:
 			OscLog(ERROR, "%s: Unkown IPC parameter ID (%d)!\n", __func__, paramId);
 			data.ipc.enReqState = REQ_STATE_NACK_PENDING;
@@ -124,6 +320,72 @@ static OSC_ERR HandleIpcRequests(MainState *pMainState)
 	return err;
 }
 
+void ProcessRawFrame(struct TEMPLATE *pData)
+{
+	/* Nothing moved since an empty frame: debayering, change detection
+	 * and labeling are skipped. */
+	if(IdleFrame(pData))
+	{
+		pData->ipc.state.nIdleFrames++;
+		return;
+	}
+	/* A frame marked as new background in the last step becomes it
+	 * now, before the next frame is debayered. Only the buffers of
+	 * the roles are exchanged. */
+	if(pData->bRebaseBackground)
+	{
+		ImgSwapRoles(pData, SENSORIMG, BACKGROUND);
+		ImgSwapRoles(pData, DETECTIMG, DETECTBACKGROUND);
+		ImgSwapRoles(pData, LUMAIMG, LUMABACKGROUND);
+		pData->bRebaseBackground = FALSE;
+	}
+#if LAZY_COLORS
+	/* Detection needs the luminance only, the colours are debayered
+	 * where they are measured. The whole image is debayered only for
+	 * the web interface (a client waiting for this frame or a live
+	 * image fetched recently) and for the region of interest. */
+	pData->bColorImage = pData->bPreviewWanted ||
+			(pData->ipc.state.roi.width != 0 && pData->ipc.state.roi.height != 0);
+	pData->bPreviewWanted = FALSE;
+	/* Luminance and colours are written in the same pass. */
+	if(pData->bColorImage)
+	{
+		DebayerHalfSize( pData->pCurRawImg, OSC_CAM_MAX_IMAGE_WIDTH, OSC_CAM_MAX_IMAGE_HEIGHT, CAM_BAYER_ORDER,
+				PLANAR_COLORS ? DEBAYER_LUMA_BGR_PLANAR : DEBAYER_LUMA_BGR, camGains, ImgData(pData, SENSORIMG), ImgData(pData, LUMAIMG));
+	}
+	else
+	{
+		DebayerHalfSize( pData->pCurRawImg, OSC_CAM_MAX_IMAGE_WIDTH, OSC_CAM_MAX_IMAGE_HEIGHT, CAM_BAYER_ORDER,
+				DEBAYER_LUMA, camGains, NULL, ImgData(pData, LUMAIMG));
+	}
+#else
+	/* debayer the image first -> to half size*/
+#if NUM_COLORS == 1
+	OscVisDebayerGreyscaleHalfSize( pData->pCurRawImg, OSC_CAM_MAX_IMAGE_WIDTH, OSC_CAM_MAX_IMAGE_HEIGHT, ROW_BGBG, ImgData(pData, SENSORIMG));
+#else
+	DebayerHalfSize( pData->pCurRawImg, OSC_CAM_MAX_IMAGE_WIDTH, OSC_CAM_MAX_IMAGE_HEIGHT, CAM_BAYER_ORDER,
+			PLANAR_COLORS ? DEBAYER_BGR_PLANAR : DEBAYER_BGR, camGains, ImgData(pData, SENSORIMG), NULL);
+#endif
+	pData->bColorImage = TRUE;
+#endif
+	/* Process the image. */
+	ProcessFrame(pData);
+#if LAZY_COLORS
+	/* A frame marked as new background is swapped in with its colours,
+	 * so they are debayered in full if they were not yet. */
+	if(pData->bRebaseBackground && !pData->bColorImage)
+	{
+		DebayerHalfSize( pData->pCurRawImg, OSC_CAM_MAX_IMAGE_WIDTH, OSC_CAM_MAX_IMAGE_HEIGHT, CAM_BAYER_ORDER,
+				PLANAR_COLORS ? DEBAYER_BGR_PLANAR : DEBAYER_BGR, camGains, ImgData(pData, SENSORIMG), NULL);
+		pData->bColorImage = TRUE;
+	}
+#endif
+	/* The images of the web interface now show this frame. */
+	pData->ipc.state.nFrameSeq++;
+	pData->nFrameStepCounter = pData->ipc.state.nStepCounter;
+	pData->frameTimeStamp = pData->ipc.state.imageTimeStamp;
+}
+
 Msg const *MainState_top(MainState *me, Msg *msg)
 {
 	struct APPLICATION_STATE *pState;
@@ -136,39 +398,148 @@ Msg const *MainState_top(MainState *me, Msg *msg)
 		data.pCurRawImg = data.u8FrameBuffers[0];
 		data.nExposureTimeChanged = true;
 		data.ipc.state.nExposureTime = 25;
+		data.ipc.state.bAutoExposure = DEFAULT_AUTO_EXPOSURE;
+		data.ipc.state.nShutterWidth = data.ipc.state.nExposureTime * 100;
 		data.ipc.state.nStepCounter = 0;
 		data.ipc.state.nThreshold = 30;
-		InitProcess();
+		data.ipc.state.nDetectLevel = DEFAULT_DETECT_LEVEL;
+		data.ipc.state.nMorphOp = DEFAULT_MORPH_OP;
+		data.ipc.state.nMinArea = DEFAULT_MIN_AREA;
+		data.ipc.state.nBandThreads = DEFAULT_BAND_THREADS;
+		data.ipc.state.nEjectDistance = DEFAULT_EJECT_DISTANCE;
+		InitProcess(&data);
+		/* The background and the parameters of the last run replace
+		 * the defaults if they were saved. */
+		WarmStartLoad();
 		return 0;
 	case IPC_GET_APP_STATE_EVT:
 		/* Fill in the response and schedule an acknowledge for the request. */
 		pState = (struct APPLICATION_STATE*)data.ipc.req.pAddr;
 		memcpy(pState, &data.ipc.state, sizeof(struct APPLICATION_STATE));
+		RecorderGetState(pState);
+
+		data.ipc.enReqState = REQ_STATE_ACK_PENDING;
+		return 0;
+	case IPC_GET_REGION_COLORS_EVT:
+		/* The statistics stay valid until the next frame is processed. */
+		GetRegionColors(&data, (struct REGION_COLORS*)data.ipc.req.pAddr);
+
+		data.ipc.enReqState = REQ_STATE_ACK_PENDING;
+		return 0;
+	case IPC_GET_LANE_STATS_EVT:
+		GetLaneStats((struct LANES_INFO*)data.ipc.req.pAddr);
+
+		data.ipc.enReqState = REQ_STATE_ACK_PENDING;
+		return 0;
+	case IPC_GET_STATS_HISTORY_EVT:
+		GetStatsHistory(&data, (struct STATS_HISTORY*)data.ipc.req.pAddr);
 
 		data.ipc.enReqState = REQ_STATE_ACK_PENDING;
 		return 0;
 	case FRAMESEQ_EVT:
+	{
 		/* Timestamp the capture of the image. */
-		data.ipc.state.imageTimeStamp = OscSupCycGet();
+		uint32 lastTimeStamp = data.ipc.state.imageTimeStamp;
+		/* The frame is stamped with the trigger of its capture; its
+		 * arrival is later by the exposure and the read out. */
+		data.ipc.state.imageTimeStamp = data.captureTimeStamp;
+		data.receiveTimeStamp = OscSupCycGet();
+		/* Detections are stamped with the belt position of the capture. */
+		data.nBeltPosition = EncoderPosition(&data.pState->encoder);
+		data.ipc.state.nBeltPosition = data.nBeltPosition;
+		data.ipc.state.nEncoderMaxRate = EncoderMaxRate(&data.pState->encoder);
+		/* So is the state of the inputs, for the black-box recorder. */
+		data.gpioIn = ReadGpioInputs();
+		/* Count the frame periods since the last capture, so everything
+		 * derived from the step counter follows the line and not the
+		 * processing speed. */
+		if(data.ipc.state.nStepCounter == 0)
+		{
+			data.nFramesElapsed = 1;
+		}
+		else
+		{
+			int32 dt = OscSupCycToMicroSecs(data.ipc.state.imageTimeStamp - lastTimeStamp);
+			data.nFramesElapsed = (dt + FRAME_PERIOD_US/2)/FRAME_PERIOD_US;
+			if(data.nFramesElapsed < 1)
+			{
+				data.nFramesElapsed = 1;
+			}
+			data.ipc.state.nDroppedFrames += data.nFramesElapsed - 1;
+			data.ipc.state.nLateness = dt - FRAME_PERIOD_US;
+			if(data.ipc.state.nLateness > data.ipc.state.nMaxLateness)
+			{
+				data.ipc.state.nMaxLateness = data.ipc.state.nLateness;
+			}
+		}
 		data.ipc.state.bNewImageReady = TRUE;
 		/* Sleep here for a short while in order not to violate the vertical
 		 * blank time of the camera sensor when triggering a new image
 		 * right after receiving the old one. This can be removed if some
-		 * heavy calculations are done here. */
-		usleep(4000);
+		 * heavy calculations are done here. (An archive replayed instead
+		 * of the camera has no sensor to protect.) */
+		if(!ArchiveIsSource())
+		{
+			usleep(4000);
+		}
 		return 0;
+	}
 	case FRAMEPAR_EVT:
 	{
 		/* we have a new image increase counter: here and only here! */
-		data.ipc.state.nStepCounter++;
-		/* debayer the image first -> to half size*/
-#if NUM_COLORS == 1
-		OscVisDebayerGreyscaleHalfSize( data.pCurRawImg, OSC_CAM_MAX_IMAGE_WIDTH, OSC_CAM_MAX_IMAGE_HEIGHT, ROW_BGBG, data.u8TempImage[SENSORIMG]);
-#else
-		OscVisDebayerHalfSize( data.pCurRawImg, OSC_CAM_MAX_IMAGE_WIDTH, OSC_CAM_MAX_IMAGE_HEIGHT, ROW_RGRG, data.u8TempImage[SENSORIMG]);
+		data.ipc.state.nStepCounter += data.nFramesElapsed;
+#if DEBUG_DUMP_FRAMES
+		/* Skipped frames are dumped too; the writer never blocks. */
+		WrDbgImgUint8Async(data.pCurRawImg, OSC_CAM_MAX_IMAGE_WIDTH, OSC_CAM_MAX_IMAGE_HEIGHT,
+				DEBUG_DUMP_PREFIX, data.ipc.state.nStepCounter, DBG_RAW);
 #endif
-		/* Process the image. */
-		ProcessFrame();
+		/* If the last frame took longer than a frame period this one is
+		 * skipped, so the loop catches up with the line in a controlled
+		 * way; never twice in a row. */
+		if(data.bSkipFrame)
+		{
+			SkipFrame(&data);
+			data.ipc.state.nSkippedFrames++;
+			data.bSkipFrame = FALSE;
+			/* The first frame with a new shutter width has to be
+			 * processed to become the background. */
+			if(data.nExposureSettle > 1)
+			{
+				data.nExposureSettle--;
+			}
+			return 0;
+		}
+
+		ProcessRawFrame(&data);
+		/* Clients watching an image type get every frame of it. */
+		SnapshotPublish();
+		data.ipc.state.nProcessTime = OscSupCycToMicroSecs(OscSupCycGet() - data.ipc.state.imageTimeStamp);
+		/* The next frame is skipped if the processing alone took longer
+		 * than a frame period. */
+		data.bSkipFrame = OscSupCycToMicroSecs(OscSupCycGet() - data.receiveTimeStamp) > FRAME_PERIOD_US;
+
+		/* Let the exposure control choose the shutter width. It meters
+		 * on the background, using the mask just computed for this very
+		 * frame, so objects in the scene neither drive nor stop it. The
+		 * next capture is already running, so a new width is set before
+		 * the one after it. It waits while a new width settles; a replay
+		 * keeps the widths it was recorded with. */
+		if(data.ipc.state.bAutoExposure && data.nExposureSettle == 0 && !ArchiveIsSource())
+		{
+			uint32 shutter = AutoExposure(data.pCurRawImg, data.ipc.state.nShutterWidth, data.ipc.state.nExposureTime * 100);
+			if(shutter != (uint32)data.ipc.state.nShutterWidth)
+			{
+				data.ipc.state.nShutterWidth = shutter;
+				data.nExposureTimeChanged = true;
+			}
+		}
+
+		if(data.nExposureSettle > 0)
+		{
+			data.nExposureSettle--;
+		}
+		/* Save the background for the next start when it is due. */
+		WarmStartUpdate();
 
 		return 0;
 	}
@@ -203,8 +574,10 @@ Msg const *MainState_ShowGray(MainState *me, Msg *msg)
 	{
 	case IPC_GET_NEW_IMG_EVT:
 	{
-		/* Write out the current gray image to the address space of the CGI. */
-		memcpy(data.ipc.req.pAddr, data.u8TempImage[SENSORIMG], sizeof(data.u8TempImage[SENSORIMG]));
+		/* Write out the current gray image to the address space of the CGI
+		 * and mark the regions in the copy only. */
+		ImgCopyInterleaved(&data, SENSORIMG, data.ipc.req.pAddr);
+		OverlayRender(&data, data.ipc.req.pAddr);
 
 		data.ipc.state.bNewImageReady = FALSE;
 
@@ -223,8 +596,9 @@ Msg const *MainState_ShowThreshold(MainState *me, Msg *msg)
 	{
 	case IPC_GET_NEW_IMG_EVT:
 	{
-		/* Write out the image to the address space of the CGI. */
-		memcpy(data.ipc.req.pAddr, data.u8TempImage[THRESHOLD], sizeof(data.u8TempImage[THRESHOLD]));
+		/* Build the image from the mask right in the address space of
+		 * the CGI. */
+		GetThresholdImage(&data, data.ipc.req.pAddr);
 
 		data.ipc.state.bNewImageReady = FALSE;
 
@@ -244,7 +618,7 @@ Msg const *MainState_ShowBackground(MainState *me, Msg *msg)
 	case IPC_GET_NEW_IMG_EVT:
 	{
 		/* Write out the current gray image to the address space of the CGI. */
-		memcpy(data.ipc.req.pAddr, data.u8TempImage[BACKGROUND], sizeof(data.u8TempImage[BACKGROUND]));
+		ImgCopyInterleaved(&data, BACKGROUND, data.ipc.req.pAddr);
 
 		data.ipc.state.bNewImageReady = FALSE;
 
@@ -270,16 +644,41 @@ OscFunction( StateControl)
 	OSC_ERR camErr;
 	MainState mainState;
 	uint8 *pCurRawImg = NULL;
+	const struct ARC_INDEX_ENTRY *pEntry;
 
 	/* Setup main state machine */
 	MainStateConstruct(&mainState);
 	HsmOnStart((Hsm *)&mainState);
 
+#if defined(OSC_HOST)
+	/* The band threads wait until a frame is split among them; more are
+	 * started when SET_BAND_THREADS asks for them. */
+	OscCall( BandInit, data.ipc.state.nBandThreads);
+#endif
+
+	/* The black-box recorder writes its recordings in the background. */
+	OscCall( RecorderInit);
+	/* So is the background saved for a warm start. */
+	OscCall( WarmStartInit);
+	/* The belt encoder is sampled by a thread of its own as well. */
+	OscCall( EncoderStart, &data.pState->encoder);
+
+	/* The other lanes start with the parameters set up by the start. */
+	OscCall( StartLanes);
+
 	OscSimInitialize();
 
 	/* Prologue: initial acquisition setup */
-	OscCall( OscCamSetupCapture, OSC_CAM_MULTI_BUFFER);
-	OscCall( OscGpioTriggerImage);
+	if(!ArchiveIsSource())
+	{
+		/* The first frame is taken with the shutter width set up by
+		 * the start, so a restored background is valid for it. */
+		OscCamSetShutterWidth(data.ipc.state.nShutterWidth);
+		data.nExposureTimeChanged = false;
+		OscCall( OscCamSetupCapture, OSC_CAM_MULTI_BUFFER);
+		data.captureTimeStamp = OscSupCycGet();
+		OscCall( OscGpioTriggerImage);
+	}
 
 	/* Body: infinite acquisition loop */
 	while (TRUE)
@@ -291,7 +690,29 @@ OscFunction( StateControl)
 		{
 			OscCall( HandleIpcRequests, &mainState);
 
-			camErr = OscCamReadPicture(OSC_CAM_MULTI_BUFFER, &pCurRawImg, 0, 4);
+			/* An archive replaces the camera; its frames are processed
+			 * straight from the mapping when they are due. */
+			if(ArchiveIsSource())
+			{
+				camErr = ArchiveReadPicture(&pCurRawImg, &pEntry);
+				if(camErr == SUCCESS)
+				{
+					/* Stamped when due, so the step counter follows the
+					 * recorded timing. The frame was taken with the
+					 * recorded shutter width; a change rebases like one
+					 * of the camera. */
+					data.captureTimeStamp = OscSupCycGet();
+					if(pEntry->nShutterWidth != 0 && pEntry->nShutterWidth != (uint32)data.ipc.state.nShutterWidth)
+					{
+						data.ipc.state.nShutterWidth = pEntry->nShutterWidth;
+						data.nExposureSettle = 1;
+					}
+				}
+			}
+			else
+			{
+				camErr = OscCamReadPicture(OSC_CAM_MULTI_BUFFER, &pCurRawImg, 0, 4);
+			}
 			if( camErr == -ETIMEOUT)
 			{
 				OscCall( HandleIpcRequests, &mainState);
@@ -313,13 +734,20 @@ OscFunction( StateControl)
 		/* set new shutter speed */
 		if(data.nExposureTimeChanged)
 		{
-			OscCamSetShutterWidth(data.ipc.state.nExposureTime * 100);
+			OscCamSetShutterWidth(data.ipc.state.nShutterWidth);
 			data.nExposureTimeChanged = false;
+			/* the frame after the next capture is the first one taken
+			 * with the new width */
+			data.nExposureSettle = 2;
 		}
 
 		/* Prepare next capture */
-		OscCall( OscCamSetupCapture, OSC_CAM_MULTI_BUFFER);
-		OscCall( OscGpioTriggerImage);
+		if(!ArchiveIsSource())
+		{
+			OscCall( OscCamSetupCapture, OSC_CAM_MULTI_BUFFER);
+			data.captureTimeStamp = OscSupCycGet();
+			OscCall( OscGpioTriggerImage);
+		}
 
 		/* Process frame by state engine. Parallel with next capture */
 		ThrowEvent(&mainState, FRAMEPAR_EVT);
@@ -0,0 +1,206 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file morph.c
+ * @brief Cleanup of the binary foreground mask before and during
+ * labeling.
+ *
+ * Bit i of word w of a packed row holds the pixel in column 32*w + i.
+ * The 3x3 operators are separable into a horizontal pass, which uses
+ * shifts with the carry from the neighbouring words, and a vertical pass
+ * combining three rows word by word.
+ *
+ * Packing and unpacking move four pixels at a time: a multiplication
+ * gathers the low bits of four bytes into a nibble or spreads a nibble
+ * over four bytes, as no two partial products overlap.
+ */
+
+#include "morph.h"
+#include "lanestate.h"
+#include <string.h>
+
+/*! @brief Moves bit 0 of byte i of a word to bit 28 + i. */
+#define MORPH_GATHER 0x10204080u
+/*! @brief Moves bit i of a nibble to bit 0 of byte i. */
+#define MORPH_SPREAD 0x00204081u
+/*! @brief Bit 0 of each byte of a word. */
+#define MORPH_BYTE_LSBS 0x01010101u
+
+/*********************************************************************//*!
+ * @brief Four bytes of a mask, byte i in bits 8*i ... 8*i + 7.
+ *//*********************************************************************/
+static inline uint32 LoadBytes(const uint8 *pMask)
+{
+	uint32 bytes;
+
+	memcpy(&bytes, pMask, sizeof(bytes));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	bytes = __builtin_bswap32(bytes);
+#endif
+	return bytes;
+}
+
+/*********************************************************************//*!
+ * @brief Store four bytes of a mask, byte i from bits 8*i ... 8*i + 7.
+ *//*********************************************************************/
+static inline void StoreBytes(uint8 *pMask, uint32 bytes)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	bytes = __builtin_bswap32(bytes);
+#endif
+	memcpy(pMask, &bytes, sizeof(bytes));
+}
+
+/*********************************************************************//*!
+ * @brief Pack a byte mask into words.
+ *//*********************************************************************/
+static void Pack(const uint8 *pMask, uint16 width, uint16 height, PACKED_MASK out)
+{
+	const uint16 nWords = (width + 31)/32;
+	uint16 y, x;
+
+	for (y = 0; y < height; y++)
+	{
+		uint32 *pOut = out[y];
+
+		memset(pOut, 0, nWords*sizeof(uint32));
+		for (x = 0; x + 4 <= width; x += 4)
+		{
+			const uint32 nibble = ((LoadBytes(pMask + x) & MORPH_BYTE_LSBS)*MORPH_GATHER) >> 28;
+			pOut[x/32] |= nibble << (x % 32);
+		}
+		for (; x < width; x++)
+		{
+			pOut[x/32] |= (uint32)(pMask[x] & 1) << (x % 32);
+		}
+		pMask += width;
+	}
+}
+
+/*********************************************************************//*!
+ * @brief Unpack words into a byte mask.
+ *//*********************************************************************/
+static void Unpack(PACKED_MASK in, uint16 width, uint16 height, uint8 *pMask)
+{
+	uint16 y, x;
+
+	for (y = 0; y < height; y++)
+	{
+		const uint32 *pIn = in[y];
+
+		for (x = 0; x + 4 <= width; x += 4)
+		{
+			const uint32 nibble = (pIn[x/32] >> (x % 32)) & 0xf;
+			StoreBytes(pMask + x, (nibble*MORPH_SPREAD) & MORPH_BYTE_LSBS);
+		}
+		for (; x < width; x++)
+		{
+			pMask[x] = (pIn[x/32] >> (x % 32)) & 1;
+		}
+		pMask += width;
+	}
+}
+
+/*********************************************************************//*!
+ * @brief 3x3 erosion (bDilate false) or dilation (bDilate true); temp
+ * holds the result of the horizontal pass.
+ *//*********************************************************************/
+static void Morph3x3(PACKED_MASK in, PACKED_MASK out, PACKED_MASK temp, uint16 width, uint16 height, bool bDilate)
+{
+	const uint16 nWords = (width + 31)/32;
+	/* Valid bits of the last word of a row. */
+	const uint32 lastMask = (width % 32) ? ((1UL << (width % 32)) - 1) : 0xffffffffUL;
+	uint16 y, w;
+
+	/* Horizontal pass. */
+	for (y = 0; y < height; y++)
+	{
+		const uint32 *pIn = in[y];
+		uint32 *pOut = temp[y];
+		for (w = 0; w < nWords; w++)
+		{
+			const uint32 cur = pIn[w];
+			/* Neighbour to the left and to the right moved onto each bit. */
+			const uint32 left = (cur << 1) | (w > 0 ? pIn[w - 1] >> 31 : 0);
+			const uint32 right = (cur >> 1) | (w + 1 < nWords ? pIn[w + 1] << 31 : 0);
+			pOut[w] = bDilate ? (cur | left | right) : (cur & left & right);
+		}
+		pOut[nWords - 1] &= lastMask;
+	}
+
+	/* Vertical pass. */
+	for (y = 0; y < height; y++)
+	{
+		for (w = 0; w < nWords; w++)
+		{
+			const uint32 above = y > 0 ? temp[y - 1][w] : 0;
+			const uint32 below = y + 1 < height ? temp[y + 1][w] : 0;
+			out[y][w] = bDilate ? (above | temp[y][w] | below) : (above & temp[y][w] & below);
+		}
+	}
+}
+
+const uint32 *CleanupMask(struct TEMPLATE *pData, uint8 *pMask, uint16 width, uint16 height, enum EnMorphOp enOp)
+{
+	struct MORPH_BUFFERS *pBuf = &pData->pState->morph;
+	/* The packed mask holding the final result. */
+	uint32 (*pFinal)[MORPH_MAX_WORDS] = pBuf->result;
+
+	if (enOp == MORPH_NONE)
+		return NULL;
+
+	Pack(pMask, width, height, pBuf->packed);
+	switch (enOp)
+	{
+	case MORPH_ERODE:
+		Morph3x3(pBuf->packed, pBuf->result, pBuf->temp, width, height, FALSE);
+		break;
+	case MORPH_DILATE:
+		Morph3x3(pBuf->packed, pBuf->result, pBuf->temp, width, height, TRUE);
+		break;
+	case MORPH_OPEN:
+		Morph3x3(pBuf->packed, pBuf->result, pBuf->temp, width, height, FALSE);
+		Morph3x3(pBuf->result, pBuf->packed, pBuf->temp, width, height, TRUE);
+		pFinal = pBuf->packed;
+		break;
+	case MORPH_CLOSE:
+		Morph3x3(pBuf->packed, pBuf->result, pBuf->temp, width, height, TRUE);
+		Morph3x3(pBuf->result, pBuf->packed, pBuf->temp, width, height, FALSE);
+		pFinal = pBuf->packed;
+		break;
+	default:
+		return NULL;
+	}
+	Unpack(pFinal, width, height, pMask);
+	return pFinal[0];
+}
+
+uint16 FilterRegionsByArea(struct OSC_VIS_REGIONS *regions, uint32 minArea)
+{
+	uint16 o, nKept = 0;
+
+	if (minArea <= 1)
+		return regions->noOfObjects;
+
+	for (o = 0; o < regions->noOfObjects; o++)
+	{
+		const struct OSC_VIS_REGIONS_RUN *pRun = regions->objects[o].root;
+		uint32 area = 0;
+
+		while (pRun != NULL && area < minArea)
+		{
+			area += pRun->endColumn - pRun->startColumn;
+			pRun = pRun->next;
+		}
+		if (area >= minArea)
+		{
+			if (nKept != o)
+				regions->objects[nKept] = regions->objects[o];
+			nKept++;
+		}
+	}
+	regions->noOfObjects = nKept;
+	return nKept;
+}
@@ -0,0 +1,66 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file morph.h
+ * @brief Cleanup of the binary foreground mask before and during
+ * labeling.
+ */
+#ifndef MORPH_H_
+#define MORPH_H_
+
+#include "template.h"
+
+/*! @brief Maximum number of words of a packed row. */
+#define MORPH_MAX_WORDS ((OSC_CAM_MAX_IMAGE_WIDTH/2 + 31)/32)
+/*! @brief Maximum number of rows of a packed mask. */
+#define MORPH_MAX_ROWS (OSC_CAM_MAX_IMAGE_HEIGHT/2)
+
+/*! @brief A packed binary mask. */
+typedef uint32 PACKED_MASK[MORPH_MAX_ROWS][MORPH_MAX_WORDS];
+
+/*! @brief The packed masks CleanupMask() works in; one set per lane. */
+struct MORPH_BUFFERS
+{
+	/*! @brief The packed mask and the result of the last pass. */
+	PACKED_MASK packed, result;
+	/*! @brief Intermediate result between horizontal and vertical pass. */
+	PACKED_MASK temp;
+};
+
+/*********************************************************************//*!
+ * @brief Apply a 3x3 morphological operator to a binary mask in place.
+ *
+ * The mask is packed into 32 bit words, so each operation handles 32
+ * pixels at once, and unpacked again for the other users of the mask.
+ * Pixels outside of the image count as background.
+ *
+ * @param pData The data object of the lane.
+ * @param pMask Binary mask (values 0 and 1) of at most half the camera
+ * resolution.
+ * @param width Width of the mask.
+ * @param height Height of the mask.
+ * @param enOp The operator to apply; MORPH_NONE leaves the mask as is.
+ * @return The result packed, row y starting at word y*MORPH_MAX_WORDS;
+ * the bits beyond width are 0. Valid until the next call; NULL for
+ * MORPH_NONE.
+ *//*********************************************************************/
+const uint32 *CleanupMask(struct TEMPLATE *pData, uint8 *pMask, uint16 width, uint16 height, enum EnMorphOp enOp);
+
+/*********************************************************************//*!
+ * @brief Remove all regions smaller than the given area.
+ *
+ * Has to be called between OscVisLabelBinary() and
+ * OscVisGetRegionProperties(), so no properties are computed for the
+ * removed regions. The area of a region is only summed up over its runs
+ * until the minimum is reached.
+ *
+ * @param regions The labeled regions; the kept ones are compacted to the
+ * front of the object table.
+ * @param minArea Minimal number of pixels of a region.
+ * @return The number of regions kept.
+ *//*********************************************************************/
+uint16 FilterRegionsByArea(struct OSC_VIS_REGIONS *regions, uint32 minArea);
+
+#endif /*MORPH_H_*/
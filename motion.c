@@ -0,0 +1,98 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file motion.c
+ * @brief Cheap check of the raw image for motion against the raw image of
+ * the last empty frame.
+ */
+
+#include "motion.h"
+#include "lanestate.h"
+
+uint8 MotionSampleStep(struct TEMPLATE *pData)
+{
+	const uint32 minArea = pData->ipc.state.nMinArea > 0 ? pData->ipc.state.nMinArea : 0;
+	/* a pixel of the detection image is this many Bayer cells wide */
+	uint32 side = 1 << (pData->ipc.state.nDetectLevel - 1);
+	uint32 step;
+
+	while ((side + 1)*(side + 1) <= minArea)
+	{
+		side++;
+	}
+	step = side/MOTION_MIN_SIDE;
+	if (step < MOTION_MIN_STEP)
+	{
+		step = MOTION_MIN_STEP;
+	}
+	else if (step > MOTION_MAX_STEP)
+	{
+		step = MOTION_MAX_STEP;
+	}
+	return step;
+}
+
+void MotionSetReference(struct TEMPLATE *pData, const uint8 *pRaw)
+{
+	struct MOTION_REFERENCE *pReference = &pData->pState->motion;
+	const uint16 width = OSC_CAM_MAX_IMAGE_WIDTH;
+	const uint8 step = MotionSampleStep(pData);
+	uint16 *pRef = pReference->samples;
+	uint16 x, y;
+
+	for (y = 0; y + 1 < OSC_CAM_MAX_IMAGE_HEIGHT; y += 2*step)
+	{
+		const uint8 *pRow0 = &pRaw[(uint32)y*width];
+		const uint8 *pRow1 = pRow0 + width;
+
+		for (x = 0; x + 1 < width; x += 2*step)
+		{
+			*pRef++ = pRow0[x] + pRow0[x + 1] + pRow1[x] + pRow1[x + 1];
+		}
+	}
+	pReference->step = step;
+	pReference->bValid = TRUE;
+}
+
+bool MotionDetected(struct TEMPLATE *pData, const uint8 *pRaw, uint8 threshold)
+{
+	const struct MOTION_REFERENCE *pReference = &pData->pState->motion;
+	const uint16 width = OSC_CAM_MAX_IMAGE_WIDTH;
+	/* the samples are sums of four pixels */
+	const int16 limit = 4*threshold;
+	const uint8 step = MotionSampleStep(pData);
+	const uint16 *pRef = pReference->samples;
+	uint16 x, y, nChanged = 0;
+
+	/* A reference sampled at another step (nMinArea or the detection
+	 * level changed) cannot be compared. */
+	if (!pReference->bValid || pReference->step != step)
+	{
+		return TRUE;
+	}
+
+	for (y = 0; y + 1 < OSC_CAM_MAX_IMAGE_HEIGHT; y += 2*step)
+	{
+		const uint8 *pRow0 = &pRaw[(uint32)y*width];
+		const uint8 *pRow1 = pRow0 + width;
+
+		for (x = 0; x + 1 < width; x += 2*step)
+		{
+			const int16 sum = pRow0[x] + pRow0[x + 1] + pRow1[x] + pRow1[x + 1];
+			const int16 diff = sum - (int16)*pRef++;
+
+			if (diff > limit || diff < -limit)
+			{
+				/* An object usually covers many samples; stop at the first
+				 * ones. */
+				if (++nChanged >= MOTION_MIN_SAMPLES)
+				{
+					return TRUE;
+				}
+			}
+		}
+	}
+	return FALSE;
+}
@@ -0,0 +1,90 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file motion.h
+ * @brief Cheap check of the raw image for motion against the raw image of
+ * the last empty frame, so idle frames of the belt need not be debayered.
+ *
+ * Every lane has a reference of its own (c.f. lanestate.h).
+ */
+#ifndef MOTION_H_
+#define MOTION_H_
+
+#include "template.h"
+
+/*! @brief Set to zero to process every frame. */
+#define MOTION_GATING 1
+/*! @brief Number of changed samples that count as motion; a single one
+ * is taken for sensor noise. */
+#define MOTION_MIN_SAMPLES 2
+/*! @brief Side of the square of samples MOTION_MIN_SAMPLES fit into
+ * (ceil(sqrt(MOTION_MIN_SAMPLES))). */
+#define MOTION_MIN_SIDE 2
+/*! @brief Smallest distance in Bayer cells between two samples, so the
+ * check stays sparse whatever nMinArea is (4: about 5600 samples per
+ * frame, the cost with the defaults). */
+#define MOTION_MIN_STEP 4
+/*! @brief Largest distance in Bayer cells between two samples (8: about
+ * 1400 samples per frame). */
+#define MOTION_MAX_STEP 8
+
+/*! @brief Samples in a row of the raw image at the finest step. */
+#define MOTION_SAMPLES_X ((OSC_CAM_MAX_IMAGE_WIDTH/2 + MOTION_MIN_STEP - 1)/MOTION_MIN_STEP)
+/*! @brief Rows of samples at the finest step. */
+#define MOTION_SAMPLES_Y ((OSC_CAM_MAX_IMAGE_HEIGHT/2 + MOTION_MIN_STEP - 1)/MOTION_MIN_STEP)
+
+/*! @brief The samples of the raw image of the last empty frame. */
+struct MOTION_REFERENCE
+{
+	/*! @brief Sums of the 2x2 cells of the reference. */
+	uint16 samples[MOTION_SAMPLES_X*MOTION_SAMPLES_Y];
+	/*! @brief Distance of the samples in Bayer cells. */
+	uint8 step;
+	/*! @brief Whether samples holds an image. */
+	bool bValid;
+};
+
+/*********************************************************************//*!
+ * @brief Distance of the samples in Bayer cells.
+ *
+ * Chosen so that the smallest region kept covers a square of at least
+ * MOTION_MIN_SIDE x MOTION_MIN_SIDE samples, and thus MOTION_MIN_SAMPLES
+ * of them: the side of a square of nMinArea pixels of SENSORIMG (one
+ * Bayer cell each), but at least the size of a pixel of the detection
+ * level, divided by MOTION_MIN_SIDE. Elongated regions of that area may
+ * still fall between the samples, and so may regions smaller than a
+ * square of MOTION_MIN_STEP*MOTION_MIN_SIDE cells, which the step does
+ * not go below.
+ *
+ * @param pData The data object of the lane.
+ * @return The step, MOTION_MIN_STEP ... MOTION_MAX_STEP.
+ *//*********************************************************************/
+uint8 MotionSampleStep(struct TEMPLATE *pData);
+
+/*********************************************************************//*!
+ * @brief Take the samples of a raw image as the reference.
+ *
+ * @param pData The data object of the lane.
+ * @param pRaw The raw image.
+ *//*********************************************************************/
+void MotionSetReference(struct TEMPLATE *pData, const uint8 *pRaw);
+
+/*********************************************************************//*!
+ * @brief Compare a raw image with the reference.
+ *
+ * Every MotionSampleStep()-th 2x2 Bayer cell in each direction is
+ * compared by the mean of its four pixels, so the Bayer order does not
+ * matter.
+ *
+ * @param pData The data object of the lane.
+ * @param pRaw The raw image.
+ * @param threshold Difference of a sample that counts as a change (as
+ * nThreshold of the change detection).
+ * @return TRUE if at least MOTION_MIN_SAMPLES samples changed or no
+ * reference is set with the current step.
+ *//*********************************************************************/
+bool MotionDetected(struct TEMPLATE *pData, const uint8 *pRaw, uint8 threshold);
+
+#endif /*MOTION_H_*/
@@ -0,0 +1,118 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file overlay.c
+ * @brief Markings of the processed frame drawn into the copy of
+ * SENSORIMG handed to the web interface.
+ */
+
+#include "overlay.h"
+#include "lanestate.h"
+#include "kernels.h"
+#include <string.h>
+
+/*! @brief Width of SENSORIMG. */
+#define OVERLAY_WIDTH (OSC_CAM_MAX_IMAGE_WIDTH/2)
+/*! @brief Height of SENSORIMG. */
+#define OVERLAY_HEIGHT (OSC_CAM_MAX_IMAGE_HEIGHT/2)
+
+void OverlayClear(struct TEMPLATE *pData)
+{
+	pData->pState->overlay.nItems = 0;
+}
+
+/*********************************************************************//*!
+ * @brief Append an item of the given type, NULL if the list is full.
+ *//*********************************************************************/
+static struct OVERLAY_ITEM *OverlayAdd(struct TEMPLATE *pData, enum EnOverlayType type, const uint8 col[3])
+{
+	struct OVERLAY_LIST *pList = &pData->pState->overlay;
+	struct OVERLAY_ITEM *pItem;
+
+	if (pList->nItems >= MAX_OVERLAY_ITEMS)
+	{
+		return NULL;
+	}
+	pItem = &pList->items[pList->nItems++];
+	pItem->type = type;
+	memcpy(pItem->col, col, sizeof(pItem->col));
+	return pItem;
+}
+
+void OverlayAddBox(struct TEMPLATE *pData, uint16 left, uint16 top, uint16 right, uint16 bottom, const uint8 col[3])
+{
+	struct OVERLAY_ITEM *pItem = OverlayAdd(pData, OVERLAY_BOX, col);
+
+	if (pItem != NULL)
+	{
+		pItem->left = left;
+		pItem->top = top;
+		pItem->right = right < OVERLAY_WIDTH ? right : OVERLAY_WIDTH;
+		pItem->bottom = bottom < OVERLAY_HEIGHT ? bottom : OVERLAY_HEIGHT;
+	}
+}
+
+void OverlayAddRuns(struct TEMPLATE *pData, const struct OSC_VIS_REGIONS_RUN *pRuns, uint8 shift, const uint8 col[3])
+{
+	struct OVERLAY_ITEM *pItem = OverlayAdd(pData, OVERLAY_RUNS, col);
+
+	if (pItem != NULL)
+	{
+		pItem->pRuns = pRuns;
+		pItem->shift = shift;
+	}
+}
+
+/*********************************************************************//*!
+ * @brief Set a pixel of the interleaved copy.
+ *//*********************************************************************/
+static void OverlayPixel(uint8 *pImg, uint16 x, uint16 y, const uint8 col[3])
+{
+	memcpy(&pImg[((uint32)y*OVERLAY_WIDTH + x)*NUM_COLORS], col, NUM_COLORS);
+}
+
+/*********************************************************************//*!
+ * @brief Draw the outline of a rectangle.
+ *//*********************************************************************/
+static void OverlayBox(uint8 *pImg, const struct OVERLAY_ITEM *pItem)
+{
+	uint16 i;
+
+	if (pItem->left >= pItem->right || pItem->top >= pItem->bottom)
+	{
+		return;
+	}
+	for (i = pItem->left; i < pItem->right; i++)
+	{
+		OverlayPixel(pImg, i, pItem->top, pItem->col);
+		OverlayPixel(pImg, i, pItem->bottom - 1, pItem->col);
+	}
+	for (i = pItem->top; i < pItem->bottom; i++)
+	{
+		OverlayPixel(pImg, pItem->left, i, pItem->col);
+		OverlayPixel(pImg, pItem->right - 1, i, pItem->col);
+	}
+}
+
+void OverlayRender(struct TEMPLATE *pData, uint8 *pImg)
+{
+	const struct OVERLAY_LIST *pList = &pData->pState->overlay;
+	uint16 k;
+
+	for (k = 0; k < pList->nItems; k++)
+	{
+		const struct OVERLAY_ITEM *pItem = &pList->items[k];
+
+		switch (pItem->type)
+		{
+		case OVERLAY_BOX:
+			OverlayBox(pImg, pItem);
+			break;
+		case OVERLAY_RUNS:
+			PaintRuns(pImg, pItem->pRuns, pItem->shift, pItem->col);
+			break;
+		}
+	}
+}
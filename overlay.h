@@ -0,0 +1,90 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file overlay.h
+ * @brief Markings of the processed frame kept as a list of items and
+ * drawn only into the copy of SENSORIMG handed to the web interface.
+ *
+ * SENSORIMG itself is never drawn into, so the colour statistics and a
+ * new background always see the camera's pixels. Every lane has a list
+ * of its own (c.f. lanestate.h), which holds until the next frame is
+ * processed; the runs of a region are referenced, not copied, and stay
+ * valid as long as the regions they belong to.
+ */
+#ifndef OVERLAY_H_
+#define OVERLAY_H_
+
+#include "template.h"
+
+/*! @brief Largest number of items of a frame; further ones are
+ * dropped. */
+#define MAX_OVERLAY_ITEMS 64
+
+/*! @brief Kinds of items. */
+enum EnOverlayType
+{
+	OVERLAY_BOX,
+	OVERLAY_RUNS
+};
+
+/*! @brief An item of the list. */
+struct OVERLAY_ITEM
+{
+	enum EnOverlayType type;
+	/*! @brief The colour, blue, green, red. */
+	uint8 col[3];
+	/*! @brief The rectangle of OVERLAY_BOX, right and bottom exclusive. */
+	uint16 left, top, right, bottom;
+	/*! @brief The runs of OVERLAY_RUNS and their scale. */
+	const struct OSC_VIS_REGIONS_RUN *pRuns;
+	uint8 shift;
+};
+
+/*! @brief The items of the frame. */
+struct OVERLAY_LIST
+{
+	struct OVERLAY_ITEM items[MAX_OVERLAY_ITEMS];
+	/*! @brief Number of valid entries in items. */
+	uint16 nItems;
+};
+
+/*********************************************************************//*!
+ * @brief Drop the items of the last frame.
+ *
+ * @param pData The data object of the lane.
+ *//*********************************************************************/
+void OverlayClear(struct TEMPLATE *pData);
+
+/*********************************************************************//*!
+ * @brief Mark a rectangle by its outline.
+ *
+ * @param pData The data object of the lane.
+ * @param left Left column in pixels of SENSORIMG.
+ * @param top Top row.
+ * @param right Column after the rectangle.
+ * @param bottom Row after the rectangle.
+ * @param col The colour, blue, green, red.
+ *//*********************************************************************/
+void OverlayAddBox(struct TEMPLATE *pData, uint16 left, uint16 top, uint16 right, uint16 bottom, const uint8 col[3]);
+
+/*********************************************************************//*!
+ * @brief Fill the runs of a region.
+ *
+ * @param pData The data object of the lane.
+ * @param pRuns The first run of the region.
+ * @param shift log2 of the ratio between SENSORIMG and the labeled image.
+ * @param col The colour, blue, green, red.
+ *//*********************************************************************/
+void OverlayAddRuns(struct TEMPLATE *pData, const struct OSC_VIS_REGIONS_RUN *pRuns, uint8 shift, const uint8 col[3]);
+
+/*********************************************************************//*!
+ * @brief Draw the items in the order they were added.
+ *
+ * @param pData The data object of the lane.
+ * @param pImg A copy of SENSORIMG as written by ImgCopyInterleaved().
+ *//*********************************************************************/
+void OverlayRender(struct TEMPLATE *pData, uint8 *pImg);
+
+#endif /*OVERLAY_H_*/
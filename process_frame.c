@@ -9,6 +9,19 @@
 
 /* Definitions specific to this application. Also includes the Oscar main header file. */
 #include "template.h"
+#include "colorhist.h"
+#include "pyramid.h"
+#include "morph.h"
+#include "integral.h"
+#include "kernels.h"
+#include "band.h"
+#include "recorder.h"
+#include "encoder.h"
+#include "stats.h"
+#include "motion.h"
+#include "debayer.h"
+#include "overlay.h"
+#include "lanestate.h"
 #include <string.h>
 #include <stdlib.h>
 
@@ -19,27 +32,23 @@ typedef struct {
         uint8 blue, green, red;
 } s_color;
 
-long framestep = 0;
-long colorcounter[3] = {0,0,0};
-long stp = 0;
-int BiggestArea = 0;
-int RegionNumber = 0;
-int coloravarage[3] = {0,0,0};
-#define sizetimebuffer 10
-int timestamp[sizetimebuffer] = {0,0,0,0,0,0,0,0,0,0};
-int gpiotimer = 0;
-int framediff = 0;
-
 //local function definitions
-void ChangeDetection();
-void DetectRegions();
-void DrawBoundingBox(struct OSC_PICTURE *picIn, struct OSC_VIS_REGIONS *regions, s_color color);
-void DrawRegion(struct OSC_PICTURE *picIn, struct OSC_VIS_REGIONS *regions, s_color color);
-void toggle(struct OSC_VIS_REGIONS *regions);
-void MaxArea(struct OSC_VIS_REGIONS *regions);
-void Activated();
-void Decisions();
-void ControlGPIO(struct OSC_PICTURE *picIn, struct OSC_VIS_REGIONS *regions);
+uint8 FrameBands(struct TEMPLATE *pData);
+int StepReached(struct TEMPLATE *pData, unsigned int step);
+int PositionReached(struct TEMPLATE *pData, unsigned int position);
+int IntegralImagesReady(struct TEMPLATE *pData);
+void RoiStatistics(struct TEMPLATE *pData);
+void DetectRegions(struct TEMPLATE *pData, int width, int height);
+void DrawBoundingBox(struct TEMPLATE *pData, struct OSC_VIS_REGIONS *regions, s_color color);
+void DrawRegion(struct TEMPLATE *pData, struct OSC_VIS_REGIONS *regions, s_color color);
+void toggle(struct TEMPLATE *pData, struct OSC_VIS_REGIONS *regions);
+void MaxArea(struct TEMPLATE *pData, struct OSC_VIS_REGIONS *regions);
+void Activated(struct TEMPLATE *pData, struct OSC_PICTURE *picIn, struct OSC_VIS_REGIONS *regions, s_color color);
+void Decisions(struct TEMPLATE *pData);
+void MeasureRegionColor(struct TEMPLATE *pData, const struct OSC_VIS_REGIONS_OBJECT *pObject, struct REGION_COLOR *pColor);
+void RecordFrame(struct TEMPLATE *pData, int processed);
+void CountFrame(struct TEMPLATE *pData, int width, int height);
+void ControlGPIO(struct TEMPLATE *pData, struct OSC_PICTURE *picIn, struct OSC_VIS_REGIONS *regions);
 
 //width of SENSORIMG (the original camera image is reduced by a factor of 2)
 const int nc = OSC_CAM_MAX_IMAGE_WIDTH/2;
@@ -48,20 +57,13 @@ const int nr = OSC_CAM_MAX_IMAGE_HEIGHT/2;
 //total number of pixel of images (the number of bytes is 3 times larger due to the
 //three color planes)
 const int siz = (OSC_CAM_MAX_IMAGE_WIDTH/2)*(OSC_CAM_MAX_IMAGE_HEIGHT/2);
-//we require these structures to use Oscar functions
-//c.f.-> file:///home/oscar/leanXcam/oscar/documentation/html/structOSC__PICTURE.html
-struct OSC_PICTURE Pic1, Pic2;
-//c.f. -> file:///home/oscar/leanXcam/oscar/documentation/html/structOSC__VIS__REGIONS.html
-struct OSC_VIS_REGIONS ImgRegions;//these contain the foreground objects
-//keeps track of digital output status
-int outputIO;
-
 /*********************************************************************//*!
  * @brief this function is only executed at start up
  * put all initialization stuff in here
  *
  *//*********************************************************************/
-void InitProcess() {
+void InitProcess(struct TEMPLATE *pData) {
+	struct LANE_STATE *pState = pData->pState;
 	//set polarity of digital output (required?)
 	OscGpioSetupPolarity(GPIO_OUT1, FALSE);
 	OscGpioSetupPolarity(GPIO_OUT2, FALSE);
@@ -69,110 +71,292 @@ void InitProcess() {
 	OscGpioWrite(GPIO_OUT1, FALSE);
 	OscGpioWrite(GPIO_OUT2, FALSE);
 	//set initial status of IO
-	outputIO = 1;
+	pState->outputIO = 1;
+	//prepare the colour binning tables
+	ColorHistInit();
+}
+
+OSC_ERR LaneStateInit(struct TEMPLATE *pData) {
+	//all of the state starts out as zero
+	pData->pState = calloc(1, sizeof(struct LANE_STATE));
+	if(pData->pState == NULL) {
+		OscLog(ERROR, "%s: cannot allocate the state of lane %d!\n", __func__, pData->nLane);
+		return -EOUT_OF_MEMORY;
+	}
+	//but the ejection queue, which starts out free
+	for(int m = 0; m < sizetimebuffer; m++) {
+		pData->pState->timestamp[m] = TIMESTAMP_EMPTY;
+	}
+	return SUCCESS;
+}
+
+void FlushEjections(struct TEMPLATE *pData) {
+	struct LANE_STATE *pState = pData->pState;
+	for(int m = 0; m < sizetimebuffer; m++) {
+		if(pState->timestamp[m] != TIMESTAMP_EMPTY) {
+			StatsEjection(pData, TRUE);
+			pState->timestamp[m] = TIMESTAMP_EMPTY;
+		}
+	}
 }
 
 
 /*********************************************************************//*!
  * @brief this function is executed for each image processing step
- * the camera image is in the image buffer: data.u8TempImage[SENSORIMG]
+ * the camera image is in the image buffer: ImgData(pData, SENSORIMG)
  * it has nr = 240 number of rows and nc = 376 number of columns and
  * each pixel is represented by three bytes corresponding to the color
  * planes blue, green and red (in this ordering)
- * the buffer data.u8TempImage[] contains three more images
- * (c.f. template.h line 57ff); two of them, referenced by the ENUM values
- * BACKGROUND and THRESHOLD are - in addition to the image SENSORIMG -
- * displayed on the web interface
+ * the buffer pool pData->imgPool contains more images (c.f. enum IMG_TYPE
+ * in template.h); BACKGROUND is - in addition to the image SENSORIMG -
+ * displayed on the web interface, and so is THRESHOLD, which is built
+ * from the mask only when it is fetched (c.f. GetThresholdImage())
  *//*********************************************************************/
-void ProcessFrame() {
+void ProcessFrame(struct TEMPLATE *pData) {
+	struct LANE_STATE *pState = pData->pState;
 	//this color is used for drawing the rectangles in the image
 	s_color color = {255, 0, 0};
 
+	//the markings of the last frame are dropped (c.f. overlay.h)
+	OverlayClear(pData);
+	//the summed-area tables are built again when they are queried
+	pState->integralValid = 0;
+
+	//the pyramid level detection runs on
+	const int level = pData->ipc.state.nDetectLevel;
+	//whether there is a background to compare this frame with
+	int detect = 1;
+	//width and height of the detection images
+	const int dnc = OSC_CAM_MAX_IMAGE_WIDTH >> level;
+	const int dnr = OSC_CAM_MAX_IMAGE_HEIGHT >> level;
+
+	//on coarser levels the detection image is built directly from the raw image
+	if(level > 1) {
+		BuildPyramidLevel(pData->pCurRawImg, OSC_CAM_MAX_IMAGE_WIDTH, OSC_CAM_MAX_IMAGE_HEIGHT, level, ImgData(pData, DETECTIMG));
+	}
+
 	//step counter, is increased after each step
-	if(data.ipc.state.nStepCounter == 1) {
+	//(a change of the detection level or of the shutter width requires a new background as well)
+	if(StepReached(pData, 1) || pState->detectShift != level - 1 || pData->nExposureSettle == 1) {
 
 		//this is the first time we have valid image data
 		//here we put routines that require image data and are only executed once at the beginning
+		pState->detectShift = level - 1;
+		ImgSetGeometry(pData, PROCESSFRAME0, dnc, dnr);
+		if(pState->detectShift > 0) {
+			ImgSetGeometry(pData, DETECTIMG, dnc, dnr);
+			ImgSetGeometry(pData, DETECTBACKGROUND, dnc, dnr);
+		}
 
+		//there is no mask to show until the next frame
+		pState->maskValid = 0;
 
-		//set frame-buffer THRESHOLD to zero
-		memset(data.u8TempImage[THRESHOLD], 0, sizeof(data.u8TempImage[THRESHOLD]));
+		//a background restored from the last run is used right away (c.f. warmstart.h)
+		if(pData->bWarmBackground) {
+			pData->bWarmBackground = FALSE;
+		} else {
+			//current image frame becomes BACKGROUND with the next frame
+			pData->bRebaseBackground = TRUE;
+			pState->sceneEmpty = 0;
 
-		//save current image frame in BACKGROUND
-		memcpy(data.u8TempImage[BACKGROUND], data.u8TempImage[SENSORIMG], sizeof(data.u8TempImage[BACKGROUND]));
-	} else {
+			RecordFrame(pData, 0);
+			StatsFrameUnmeasured(pData);
+			detect = 0;
+		}
+	}
+	if(detect) {
 		//this is done for all following processing steps
 
 		//uncomment the following line to see an example for log-output on the console (for further info c.f. chapter 8.3. of leanXcam user doc)
 		//OscLog(INFO, "%s: currently running ProcessFrame for step counter %d\n", __func__, data.ipc.state.nStepCounter);
 
-		//call function change detection
-		ChangeDetection();
-
+		//call function change detection (on the pyramid level if one is selected)
+		if(pState->detectShift > 0) {
+			ChangeDetection(pData, ImgData(pData, DETECTIMG), ImgData(pData, DETECTBACKGROUND), dnc, dnr);
+		} else {
+#if LAZY_COLORS
+			ChangeDetectionGrey(pData, ImgData(pData, LUMAIMG), ImgData(pData, LUMABACKGROUND), nc, nr);
+#elif PLANAR_COLORS
+			ChangeDetectionPlanar(pData, ImgData(pData, SENSORIMG), ImgData(pData, BACKGROUND), nc, nr);
+#else
+			ChangeDetection(pData, ImgData(pData, SENSORIMG), ImgData(pData, BACKGROUND), nc, nr);
+#endif
+		}
+		//remove sensor noise from the mask before labeling
+		pState->pPackedMask = CleanupMask(pData, ImgData(pData, PROCESSFRAME0), dnc, dnr, pData->ipc.state.nMorphOp);
+		pState->maskValid = 1;
 
+		//box statistics in constant time (only while someone asks for them)
+		RoiStatistics(pData);
 
 		//call function for region detection
-		DetectRegions();
-		//DrawRegion(&Pic2, &ImgRegions, color);
-
-		//save current image frame in BACKGROUND (before we draw the rectangles)
-		if((data.ipc.state.nStepCounter==100)) { //each 100th pic captured, will be compared with BACKROUND.
-			memcpy(data.u8TempImage[BACKGROUND], data.u8TempImage[SENSORIMG], sizeof(data.u8TempImage[BACKGROUND]));
+		DetectRegions(pData, dnc, dnr);
+
+		//something is in the scene (reported with the lane statistics)
+		pData->bForeground = pState->ImgRegions.noOfObjects > 0;
+		//production statistics of the frame
+		CountFrame(pData, dnc, dnr);
+
+		//the colour statistics are gathered only for the region being classified
+		//(c.f. Activated()), the others stay empty
+		pState->nRegionColors = pState->ImgRegions.noOfObjects < MAX_REGION_COLORS ? pState->ImgRegions.noOfObjects : MAX_REGION_COLORS;
+		memset(pState->RegionColors, 0, pState->nRegionColors*sizeof(struct REGION_COLOR));
+		//DrawRegion(&ImgRegions, color);
+
+		//save current image frame in BACKGROUND (the buffers of the two roles
+		//are swapped with the next frame); a background restored from the last run is kept
+		if(StepReached(pData, 100) && !pData->bWarmStarted) { //each 100th pic captured, will be compared with BACKROUND.
+			pData->bRebaseBackground = TRUE;
 		}
 
-		//draw regions directly to the image (the image content is changed!)
-		//DrawBoundingBox(&Pic2, &ImgRegions, color);
+		//mark the regions on the web interface (SENSORIMG is not changed)
+		//DrawBoundingBox(&ImgRegions, color);
 
-		MaxArea(&ImgRegions);
+		MaxArea(pData, &pState->ImgRegions);
 
 		//Activated();
 
-		ControlGPIO(&Pic2, &ImgRegions);
+		ControlGPIO(pData, &pState->Pic2, &pState->ImgRegions);
 
 		/*
-		if(!(data.ipc.state.nStepCounter%50)) {
-			toggle(&ImgRegions);
+		if(!(pData->ipc.state.nStepCounter%50)) {
+			toggle(pData, &pState->ImgRegions);
 		}
 		*/
 
 
+		//the following frames are compared with this one as long as it stays empty
+		pState->sceneEmpty = pState->ImgRegions.noOfObjects == 0;
+		if(pState->sceneEmpty) {
+			MotionSetReference(pData, pData->pCurRawImg);
+		}
+
+		//keep the raw frame and its detections for the black-box recorder
+		RecordFrame(pData, 1);
+	}
+}
+
+/*********************************************************************//*!
+ * @brief calculate the difference of the current image (SENSORIMG or
+ * DETECTIMG) and the last image (BACKGROUND or DETECTBACKGROUND) and
+ * compare with threshold value
+ * if difference is large a 1 is written to the binary image PROCESSFRAME0
+ * which has the same width and height as the compared images
+ *//*********************************************************************/
+void ChangeDetection(struct TEMPLATE *pData, const uint8 *pImg, const uint8 *pBg, int width, int height) {
+	//split among the band threads if asked for
+	if(FrameBands(pData) > 1) {
+		ChangeDetectionBanded(pImg, pBg, width, height, FALSE, FrameBands(pData), ImgData(pData, PROCESSFRAME0));
+	}
+	//one flat loop over all pixels
+	else {
+		ChangeDetectionRows(pImg, pBg, width, height, FALSE, 0, height, NUM_COLORS*pData->ipc.state.nThreshold, ImgData(pData, PROCESSFRAME0));
 	}
 }
 
 /*********************************************************************//*!
- * @brief calculate the difference of the current image (SENSORIMG) and
- * the last image (BACKGROUND) and compare with threshold value
- * if difference is large set THRESHOLD image to 255 (only blue - plane)
- * in addition a binary image is written to PROCESSFRAME0
+ * @brief change detection for any image size
  *//*********************************************************************/
-void ChangeDetection() {
+void ChangeDetectionGeneric(struct TEMPLATE *pData, const uint8 *pImg, const uint8 *pBg, int width, int height) {
 	int row, col, cpl;
+	const int size = width*height;
+	uint8 *pMask = ImgData(pData, PROCESSFRAME0);
 	//loop over the rows
-	for(row = 0; row < siz; row += nc) {
+	for(row = 0; row < size; row += width) {
 		//loop over the columns
-		for(col = 0; col < nc; col++) {
+		for(col = 0; col < width; col++) {
 			int16 Dif = 0;
 			//loop over the color planes (blue - green - red) and sum up the difference
 			for(cpl = 0; cpl < NUM_COLORS; cpl++) {
-				Dif += abs((int16) data.u8TempImage[SENSORIMG][(row+col)*NUM_COLORS+cpl]-
-												(int16) data.u8TempImage[BACKGROUND][(row+col)*NUM_COLORS+cpl]);
+				Dif += abs((int16) pImg[(row+col)*NUM_COLORS+cpl]-
+												(int16) pBg[(row+col)*NUM_COLORS+cpl]);
 			}
 			//if the difference is larger than threshold value (can be changed on web interface)
-			if(Dif > NUM_COLORS*data.ipc.state.nThreshold) {
+			if(Dif > NUM_COLORS*pData->ipc.state.nThreshold) {
 				//set pixel value to 1 in PROCESSFRAME0 image (we use only the first third of the image buffer)
-				data.u8TempImage[PROCESSFRAME0][(row+col)] = 1;
-				//set pixel value to 255 in THRESHOLD image (only the blue plane)
-				data.u8TempImage[THRESHOLD][(row+col)*NUM_COLORS] = 255;
+				pMask[(row+col)] = 1;
 			} else {
 				//set values to zero
-				data.u8TempImage[PROCESSFRAME0][(row+col)] = 0;
-				data.u8TempImage[THRESHOLD][(row+col)*NUM_COLORS] = 0;
+				pMask[(row+col)] = 0;
 			}
 		}
 	}
 }
 
+/*********************************************************************//*!
+ * @brief same as ChangeDetection() for planar images: the loop runs over
+ * the pixels and reads each color plane with unit stride
+ *//*********************************************************************/
+void ChangeDetectionPlanar(struct TEMPLATE *pData, const uint8 *pImg, const uint8 *pBg, int width, int height) {
+	if(FrameBands(pData) > 1) {
+		ChangeDetectionBanded(pImg, pBg, width, height, TRUE, FrameBands(pData), ImgData(pData, PROCESSFRAME0));
+	}
+	else {
+		ChangeDetectionRows(pImg, pBg, width, height, TRUE, 0, height, NUM_COLORS*pData->ipc.state.nThreshold, ImgData(pData, PROCESSFRAME0));
+	}
+}
+
+/*********************************************************************//*!
+ * @brief planar change detection for any image size
+ *//*********************************************************************/
+void ChangeDetectionPlanarGeneric(struct TEMPLATE *pData, const uint8 *pImg, const uint8 *pBg, int width, int height) {
+	int i, cpl;
+	const int size = width*height;
+	uint8 *pMask = ImgData(pData, PROCESSFRAME0);
+	for(i = 0; i < size; i++) {
+		int16 Dif = 0;
+		for(cpl = 0; cpl < NUM_COLORS; cpl++) {
+			Dif += abs((int16) pImg[cpl*size+i] - (int16) pBg[cpl*size+i]);
+		}
+		pMask[i] = Dif > NUM_COLORS*pData->ipc.state.nThreshold;
+	}
+}
+
+void ChangeDetectionGrey(struct TEMPLATE *pData, const uint8 *pImg, const uint8 *pBg, int width, int height) {
+	int i;
+	const int size = width*height;
+	uint8 *pMask = ImgData(pData, PROCESSFRAME0);
+	for(i = 0; i < size; i++) {
+		pMask[i] = abs((int16) pImg[i] - (int16) pBg[i]) > pData->ipc.state.nThreshold;
+	}
+}
 
+/*********************************************************************//*!
+ * @brief build the summed-area tables of the frame the first time a box
+ * is queried, in one pass over SENSORIMG and the (cleaned up) mask
+ *
+ * @return whether box sums of the frame can be queried
+ *//*********************************************************************/
+int IntegralImagesReady(struct TEMPLATE *pData) {
+	struct LANE_STATE *pState = pData->pState;
+	if(!pState->maskValid || !pData->bColorImage) {
+		return 0;
+	}
+	if(!pState->integralValid) {
+		BuildIntegralImages(pData, ImgData(pData, SENSORIMG), ImgData(pData, PROCESSFRAME0), pState->detectShift);
+		pState->integralValid = 1;
+	}
+	return 1;
+}
+
+/*********************************************************************//*!
+ * @brief build the integral images of the frame and evaluate the region
+ * of interest selected on the web interface; nothing is done while no
+ * region of interest is set
+ *//*********************************************************************/
+void RoiStatistics(struct TEMPLATE *pData) {
+	struct INTEGRAL_SUM roiSum;
+	int cpl;
+
+	if(pData->ipc.state.roi.width == 0 || pData->ipc.state.roi.height == 0 || !IntegralImagesReady(pData)) {
+		return;
+	}
+	IntegralBoxSum(pData, &pData->ipc.state.roi, &roiSum);
+	pData->ipc.state.nRoiForeground = roiSum.fg;
+	for(cpl = 0; cpl < NUM_COLORS; cpl++) {
+		pData->ipc.state.nRoiMean[cpl] = roiSum.fg ? roiSum.sum[cpl]/roiSum.fg : 0;
+	}
+}
 
 /*********************************************************************//*!
  * @brief do a region labeling and property extraction using directly
@@ -180,75 +364,61 @@ void ChangeDetection() {
  * be wrapped to the OSC_PICTURE structure
  * results are easily accessible through the structure OSC_VIS_REGIONS
  *//*********************************************************************/
-void DetectRegions() {
+void DetectRegions(struct TEMPLATE *pData, int width, int height) {
+	struct LANE_STATE *pState = pData->pState;
 	//wrap image PROCESSFRAME0 in picture struct
 	//because the image MUST be binary (i.e. values of 0 and 1)
 	//we use the extra frame PROCESSFRAME0;
-	Pic1.data = data.u8TempImage[PROCESSFRAME0];
-	Pic1.width = nc;
-	Pic1.height = nr;
-	Pic1.type = OSC_PICTURE_BINARY;
+	pState->Pic1.data = ImgData(pData, PROCESSFRAME0);
+	pState->Pic1.width = width;
+	pState->Pic1.height = height;
+	pState->Pic1.type = OSC_PICTURE_BINARY;
 
 	//now do region labeling and feature extraction
-	OscVisLabelBinary( &Pic1, &ImgRegions);
-	OscVisGetRegionProperties( &ImgRegions);
+	//(regions below the minimal area are dropped before their properties are computed)
+	if(FrameBands(pData) > 1) {
+		if(LabelBinaryBanded( &pState->Pic1, &pState->ImgRegions, FrameBands(pData), pState->pPackedMask) != SUCCESS) {
+			OscLog(WARN, "%s: too many regions!\n", __func__);
+		}
+	} else {
+		OscVisLabelBinary( &pState->Pic1, &pState->ImgRegions);
+	}
+	FilterRegionsByArea( &pState->ImgRegions, pData->ipc.state.nMinArea >> (2*pState->detectShift));
+	OscVisGetRegionProperties( &pState->ImgRegions);
 
 	//PrintObjectProperties(&ImgRegions); //Ausgabe der detektierten Objekte in Konsole unten; AREA: ca. 3500 Pixel (Änderung)
 
 	//also wrap SENSORIMG to an OSC_VIS_PICTURE structure
-	//because we use it in DrawBoundingBoxColor()
-	Pic2.data = data.u8TempImage[SENSORIMG];
-	Pic2.width = nc;
-	Pic2.height = nr;
-	Pic2.type = OSC_PICTURE_BGR_24;
+	//because the colour statistics read it
+	pState->Pic2.data = ImgData(pData, SENSORIMG);
+	pState->Pic2.width = nc;
+	pState->Pic2.height = nr;
+	pState->Pic2.type = OSC_PICTURE_BGR_24;
 }
 
 /*********************************************************************//*!
- * @brief draw a bounding box around all regions found in the given
- * OSC_VIS_REGION structure with the given color
+ * @brief mark a bounding box around all regions found in the given
+ * OSC_VIS_REGION structure with the given color (c.f. overlay.h)
  *
  *//*********************************************************************/
-void DrawBoundingBox(struct OSC_PICTURE *picIn, struct OSC_VIS_REGIONS *regions, s_color color) {
-        uint16 i, o, cpl;
-        uint8 *pImg = (uint8*)picIn->data;
-        const uint16 width = picIn->width;
+void DrawBoundingBox(struct TEMPLATE *pData, struct OSC_VIS_REGIONS *regions, s_color color) {
+	struct LANE_STATE *pState = pData->pState;
+        uint16 o;
         uint8 col[3] = {color.blue, color.green, color. red};
         for(o = 0; o < regions->noOfObjects; o++) {
-                /* Draw the horizontal lines. */
-                for (i = regions->objects[o].bboxLeft; i < regions->objects[o].bboxRight; i += 1) {
-                	for(cpl = 0; cpl < NUM_COLORS; cpl++) {
-                        pImg[(width * regions->objects[o].bboxTop + i) * NUM_COLORS + cpl] = col[cpl];
-                        pImg[(width * (regions->objects[o].bboxBottom - 1) + i) * NUM_COLORS + cpl] = col[cpl];
-                	}
-                }
-
-                /* Draw the vertical lines. */
-                for (i = regions->objects[o].bboxTop; i < regions->objects[o].bboxBottom-1; i += 1) {
-                	for(cpl = 0; cpl < NUM_COLORS; cpl++) {
-                        pImg[(width * i + regions->objects[o].bboxLeft) * NUM_COLORS + cpl] = col[cpl];
-                        pImg[(width * i + regions->objects[o].bboxRight) * NUM_COLORS + cpl] = col[cpl];
-                	}
-                }
+                //the box is scaled up from the detection level
+                OverlayAddBox(pData, regions->objects[o].bboxLeft << pState->detectShift, regions->objects[o].bboxTop << pState->detectShift,
+                        regions->objects[o].bboxRight << pState->detectShift, regions->objects[o].bboxBottom << pState->detectShift, col);
         }
 }
 
-void DrawRegion(struct OSC_PICTURE *picIn, struct OSC_VIS_REGIONS *regions, s_color color) {
-        uint16 o, cpl;
-        uint8 *pImg = (uint8*)picIn->data;
-        const uint16 width = picIn->width;
+void DrawRegion(struct TEMPLATE *pData, struct OSC_VIS_REGIONS *regions, s_color color) {
+	struct LANE_STATE *pState = pData->pState;
+        uint16 o;
         //uint8 col[3] = {color.blue, color.green, color. red};
         uint8 col[2][3] = {{255,0,0},{0,255,0}};
         for(o = 0; o < regions->noOfObjects; o++) {
-        	 struct OSC_VIS_REGIONS_RUN* CurrentRun = regions->objects[o].root;
-                // Draw the horizontal lines. */
-        	 do {
-                for (uint16 c = CurrentRun->startColumn; c < CurrentRun->endColumn; c += 1) {
-                	for(cpl = 0; cpl < NUM_COLORS; cpl++) {
-                		pImg[(width * CurrentRun->row + c)* NUM_COLORS + cpl] = col[o%2][cpl];
-                	}
-                }
-                CurrentRun = CurrentRun->next;
-        	 } while (CurrentRun != 0);
+                OverlayAddRuns(pData, regions->objects[o].root, pState->detectShift, col[o%2]);
         }
 }
 
@@ -256,15 +426,16 @@ void DrawRegion(struct OSC_PICTURE *picIn, struct OSC_VIS_REGIONS *regions, s_co
  * @brief Toggle digital output status
  *
  *//*********************************************************************/
-void toggle(struct OSC_VIS_REGIONS *regions)
+void toggle(struct TEMPLATE *pData, struct OSC_VIS_REGIONS *regions)
 {
+	struct LANE_STATE *pState = pData->pState;
     OSC_ERR err = SUCCESS;
-    if(outputIO == 1){
+    if(pState->outputIO == 1){
 	  err = OscGpioWrite(GPIO_OUT1, FALSE);
-	  outputIO = 0;
+	  pState->outputIO = 0;
     }else{
 	  err = OscGpioWrite(GPIO_OUT1, TRUE);
-	  outputIO = 1;
+	  pState->outputIO = 1;
     }
 	if (err != SUCCESS) {
 	  fprintf(stderr, "%s: ERROR: GPIO write error! (%d)\n", __func__, err);
@@ -273,18 +444,19 @@ void toggle(struct OSC_VIS_REGIONS *regions)
 	return;
 }
 /*
-void toggle(struct OSC_VIS_REGIONS *regions)
+void toggle(struct TEMPLATE *pData, struct OSC_VIS_REGIONS *regions)
 {
+	struct LANE_STATE *pState = pData->pState;
     OSC_ERR err = SUCCESS;
     if(regions->noOfObjects>0){
 	  err = OscGpioWrite(GPIO_OUT1, TRUE);
 	  err = OscGpioWrite(GPIO_OUT2, TRUE);
-	  outputIO = 0;
+	  pState->outputIO = 0;
     }
     else{
 	  err = OscGpioWrite(GPIO_OUT1, FALSE);
 	  err = OscGpioWrite(GPIO_OUT2, FALSE);
-	  outputIO = 1;
+	  pState->outputIO = 1;
     }
 	if (err != SUCCESS){
 	  fprintf(stderr, "%s: ERROR: GPIO write error! (%d)\n", __func__, err);
@@ -293,7 +465,10 @@ void toggle(struct OSC_VIS_REGIONS *regions)
 }
 */
 
-void MaxArea(struct OSC_VIS_REGIONS *regions){
+void MaxArea(struct TEMPLATE *pData, struct OSC_VIS_REGIONS *regions){
+	struct LANE_STATE *pState = pData->pState;
+	//colour used to mark the activated object
+	s_color color = {0, 0, 255};
 	int temp = 0;
 	int numbertemp = 0;
 	for (int i = 0; i < regions->noOfObjects; i++){
@@ -302,94 +477,103 @@ void MaxArea(struct OSC_VIS_REGIONS *regions){
 			numbertemp = i;
 		}
 	}
+	//areas are compared in pixels of SENSORIMG
+	temp <<= 2*pState->detectShift;
 	printf("Biggest Area: %d\n", temp);
 
 	//RegionNumber und BiggestArea weitergeben (erst jetzt in externe Variable geschrieben):
-	BiggestArea = temp;
-	RegionNumber = numbertemp;
+	pState->BiggestArea = temp;
+	pState->RegionNumber = numbertemp;
 	//Hier wird bei genuegender Groesse der Aktiviert-Modus aktiviert.
-	if (BiggestArea >= 3000 || framediff ==5){
-		Activated(&Pic2, &ImgRegions);
+	//(the decision 5 steps after the activation is reached even if frames are dropped)
+	if (pState->BiggestArea >= 3000 || (pState->framestep > 0 && StepReached(pData, pState->framestep + 5))){
+		Activated(pData, &pState->Pic2, &pState->ImgRegions, color);
 	}
 }
 
 
-void Activated(struct OSC_PICTURE *picIn, struct OSC_VIS_REGIONS *regions, s_color color)
+void Activated(struct TEMPLATE *pData, struct OSC_PICTURE *picIn, struct OSC_VIS_REGIONS *regions, s_color color)
 {
+	struct LANE_STATE *pState = pData->pState;
 
 	//Differenz Zeitstempel und aktuelle Zeit bzw. Frame
-	framediff = data.ipc.state.nStepCounter-framestep;
+	pState->framediff = pData->ipc.state.nStepCounter-pState->framestep;
 
-	if(framediff > 20){
-		framestep = data.ipc.state.nStepCounter;
-		memset (colorcounter, 0, sizeof (colorcounter));
-		stp = 0;
+	if(pState->framediff > 20){
+		pState->framestep = pData->ipc.state.nStepCounter;
+		memset (pState->colorcounter, 0, sizeof (pState->colorcounter));
+		memset (pState->colorhist, 0, sizeof (pState->colorhist));
+		pState->stp = 0;
 	}
 
-	if(framediff < 5){
-		uint8 *pImg = (uint8*)picIn->data;
-		const uint16 width = picIn->width;
+	if(pState->framediff < 5 && pState->RegionNumber < pState->nRegionColors){
 		uint8 col[3] = {color.blue, color.green, color. red};
 		//uint8 col[2][3] = {{255,0,0},{0,255,0}};
-		struct OSC_VIS_REGIONS_RUN* CurrentRun = regions->objects[RegionNumber].root;
-		do {
-			for (uint16 c = CurrentRun->startColumn; c < CurrentRun->endColumn; c += 1) {
-				for(uint16 cpl = 0; cpl < NUM_COLORS; cpl++) {
-
-					//count color values
-					colorcounter[cpl] = colorcounter[cpl] + pImg[(width * CurrentRun->row + c)* NUM_COLORS + cpl];
-					stp++;
-					pImg[(width * CurrentRun->row + c)* NUM_COLORS + cpl] = col[cpl];
-				}
-			}
-			CurrentRun = CurrentRun->next;
-		} while (CurrentRun != 0);
+
+		//only this region's pixels are read for its colour statistics
+		MeasureRegionColor(pData, &regions->objects[pState->RegionNumber], &pState->RegionColors[pState->RegionNumber]);
+
+		//count color values
+		for(uint16 cpl = 0; cpl < NUM_COLORS; cpl++) {
+			pState->colorcounter[cpl] += pState->RegionColors[pState->RegionNumber].sum[cpl];
+		}
+		pState->stp += pState->RegionColors[pState->RegionNumber].nPixels*NUM_COLORS;
+		for(int k = 0; k < HIST_NUM_BINS; k++) {
+			pState->colorhist[k] += pState->RegionColors[pState->RegionNumber].hist[k];
+		}
+
+		//mark the object on the web interface (runs are scaled up from the detection level)
+		OverlayAddRuns(pData, regions->objects[pState->RegionNumber].root, pState->detectShift, col);
 	}
 
 /*
 	printf("Der colorcounter betraegt: ");
 	for(int k = 0; k < 3; k++){
-	printf("%d ", colorcounter[k]);
+	printf("%d ", pState->colorcounter[k]);
 	}
 */
 
 
 
-	if(framediff == 5){
+	if(StepReached(pData, pState->framestep + 5)){
 
-		memset (coloravarage, 0, sizeof (coloravarage));
-		stp = stp/3;
+		memset (pState->coloravarage, 0, sizeof (pState->coloravarage));
+		pState->stp = pState->stp/3;
 
 		printf("\n");
 		printf("Die 20-er Durchschnittsfarbe ist:");
 		printf("\n");
 		for(int coln = 0; coln < NUM_COLORS; coln++){
-			if (stp > 0){
-				coloravarage[coln] = colorcounter[coln]/stp;
+			if (pState->stp > 0){
+				pState->coloravarage[coln] = pState->colorcounter[coln]/pState->stp;
 			}
-			printf("%d ", coloravarage[coln]); //Ausgabe in Konsole
+			printf("%d ", pState->coloravarage[coln]); //Ausgabe in Konsole
 		}
 		// Hier wird dann die decisions-Funktion aufgerufen.
-		Decisions();
+		Decisions(pData);
 	}
 }
 
 
-void Decisions(){
+void Decisions(struct TEMPLATE *pData){
+	struct LANE_STATE *pState = pData->pState;
 
-	int white[6] = {100,200,100,200,100,200};
-	int red [6] = {50,150,50,150,50,150};
 	int color = 0;
 	int size = 0;
 
+	//classify the object by its colour histogram; unlike the mean colour this is
+	//robust against highlights
+	enum EnObjectClass objClass = ClassifyHistogram(pState->colorhist);
+	pData->ipc.state.nObjectClass = objClass;
+	StatsObject(pData, objClass);
 
-	if (white[0] < coloravarage[0] && white[1] > coloravarage[0]  && white[3] < coloravarage[1] && white[4] > coloravarage[1]  && white[5] < coloravarage[2] && white[6] > coloravarage[2])
+	if (objClass == OBJ_CLASS_WHITE)
 	{
 		//Gummibaerchen ist weiss
 		color = 1;
 	}
 
-	if (red[0] < coloravarage[0] && red[1] > coloravarage[0]  && red[3] < coloravarage[1] && red[4] > coloravarage[1]  && red[5] < coloravarage[2] && red[6] > coloravarage[2])
+	if (objClass == OBJ_CLASS_RED)
 	{
 		//Gummibarrchen ist rot
 		color = 1;
@@ -398,7 +582,7 @@ void Decisions(){
 	//Test: color ist immer = 1
 	color = 1;
 
-	if (BiggestArea > 1500/* && BiggestArea < 3000*/)
+	if (pState->BiggestArea > 1500/* && BiggestArea < 3000*/)
 	{
 		size=1;
 	}
@@ -408,44 +592,199 @@ void Decisions(){
 		OSC_ERR err = SUCCESS;
 		//Turn on GPIO
 		err = OscGpioWrite(GPIO_OUT1, TRUE);
-		outputIO = 1;
+		pState->outputIO = 1;
 */
 
 		//Zeitstempel setzen auf erste Null-Position im Array timestamp
+		int queued = 0;
 		for(int m = 0; m < sizetimebuffer; m++){
-			if(timestamp[m] == 0){
-				timestamp[m] = data.ipc.state.nStepCounter;
+			if(pState->timestamp[m] == TIMESTAMP_EMPTY){
+				//(with an encoder the belt position of the capture)
+				pState->timestamp[m] = pData->ipc.state.nEjectDistance > 0 ? pData->nBeltPosition : pData->ipc.state.nStepCounter;
 				m = sizetimebuffer;
+				queued = 1;
 			}
 		}
+		//all ejections pending, this one is lost
+		if(!queued) StatsEjection(pData, TRUE);
+
+		//the black-box recorder keeps the frames around the decision
+		pState->decisionTaken = 1;
+		if(pData->nLane == 0) RecorderTrigger();
 	}
 }
 
-void ControlGPIO(struct OSC_PICTURE *picIn, struct OSC_VIS_REGIONS *regions){
+/*********************************************************************//*!
+ * @brief gather the colour statistics of a region; without a debayered
+ * SENSORIMG its bounding box is debayered first (c.f. LAZY_COLORS)
+ *//*********************************************************************/
+void MeasureRegionColor(struct TEMPLATE *pData, const struct OSC_VIS_REGIONS_OBJECT *pObject, struct REGION_COLOR *pColor) {
+	struct LANE_STATE *pState = pData->pState;
+	if(!pData->bColorImage) {
+		struct IMG_RECT box;
+
+		//the box in pixels of SENSORIMG, the right and bottom border included
+		box.xPos = pObject->bboxLeft << pState->detectShift;
+		box.yPos = pObject->bboxTop << pState->detectShift;
+		box.width = (pObject->bboxRight - pObject->bboxLeft + 1) << pState->detectShift;
+		box.height = (pObject->bboxBottom - pObject->bboxTop + 1) << pState->detectShift;
+		DebayerHalfSizeRect(pData->pCurRawImg, OSC_CAM_MAX_IMAGE_WIDTH, OSC_CAM_MAX_IMAGE_HEIGHT, CAM_BAYER_ORDER, camGains, &box, ImgData(pData, SENSORIMG));
+	}
+
+	AccumulateRegionColor(&pState->Pic2, pObject, pState->detectShift, pColor);
+}
+
+/*********************************************************************//*!
+ * @brief number of bands the frame is split into; the band threads are
+ * only used by the camera lane
+ *//*********************************************************************/
+uint8 FrameBands(struct TEMPLATE *pData) {
+	return pData->nLane == 0 ? pData->ipc.state.nBandThreads : 1;
+}
+
+/*********************************************************************//*!
+ * @brief true if the step counter reached the given step with the current
+ * frame; the counter advances by more than one when frames are dropped
+ *//*********************************************************************/
+int StepReached(struct TEMPLATE *pData, unsigned int step) {
+	return pData->ipc.state.nStepCounter >= step && pData->ipc.state.nStepCounter - pData->nFramesElapsed < step;
+}
+
+/*********************************************************************//*!
+ * @brief true if the belt has reached the given encoder position (or is
+ * past it); several positions may be reached within one frame
+ *//*********************************************************************/
+int PositionReached(struct TEMPLATE *pData, unsigned int position) {
+	return (int)(EncoderPosition(&pData->pState->encoder) - position) >= 0;
+}
+
+/*********************************************************************//*!
+ * @brief count the regions and the foreground pixels of the frame for the
+ * production statistics (c.f. stats.h)
+ *//*********************************************************************/
+void CountFrame(struct TEMPLATE *pData, int width, int height) {
+	struct LANE_STATE *pState = pData->pState;
+	uint32 foreground = 0;
+	int o;
+
+	for(o = 0; o < pState->ImgRegions.noOfObjects; o++) {
+		foreground += pState->ImgRegions.objects[o].area;
+	}
+	StatsFrame(pData, pState->ImgRegions.noOfObjects, foreground, width*height);
+}
+
+int IdleFrame(struct TEMPLATE *pData) {
+	struct LANE_STATE *pState = pData->pState;
+	const int level = pData->ipc.state.nDetectLevel;
+
+	//only a frame following an empty one is checked; the background and
+	//the detection setup must not be about to change
+	if(!MOTION_GATING || !pState->sceneEmpty || pData->bRebaseBackground ||
+			pData->nExposureSettle > 0 || pState->detectShift != level - 1) {
+		return 0;
+	}
+	if(MotionDetected(pData, pData->pCurRawImg, pData->ipc.state.nThreshold)) {
+		return 0;
+	}
+
+	//the regions of the last frame (none) stay valid
+	CountFrame(pData, OSC_CAM_MAX_IMAGE_WIDTH >> level, OSC_CAM_MAX_IMAGE_HEIGHT >> level);
+	ControlGPIO(pData, &pState->Pic2, &pState->ImgRegions);
+	RecordFrame(pData, 1);
+	return 1;
+}
+
+void SkipFrame(struct TEMPLATE *pData) {
+	struct LANE_STATE *pState = pData->pState;
+	//no new regions, only the output timing moves on
+	ControlGPIO(pData, &pState->Pic2, &pState->ImgRegions);
+	//the frame counts as received nevertheless
+	StatsFrameUnmeasured(pData);
+	//the raw frame is recorded nevertheless
+	RecordFrame(pData, 0);
+}
+
+/*********************************************************************//*!
+ * @brief hand the raw frame of the camera and its detections to the
+ * black-box recorder (c.f. recorder.h)
+ *
+ * @param processed whether ImgRegions belong to this frame
+ *//*********************************************************************/
+void RecordFrame(struct TEMPLATE *pData, int processed) {
+	struct LANE_STATE *pState = pData->pState;
+	struct REC_FRAME_HEADER header;
+	int o;
+
+	//only the camera lane is recorded
+	if(pData->nLane != 0) {
+		return;
+	}
+
+	header.nStepCounter = pData->ipc.state.nStepCounter;
+	header.nTimeMicroSecs = OscSupCycToMicroSecs(pData->ipc.state.imageTimeStamp);
+	header.nShutterWidth = pData->ipc.state.nShutterWidth;
+	header.bProcessed = processed;
+	header.bDecision = pState->decisionTaken;
+	header.nObjectClass = pData->ipc.state.nObjectClass;
+	header.nDetections = 0;
+	header.gpioIn = pData->gpioIn;
+	memset(header.reserved, 0, sizeof(header.reserved));
+	if(processed) {
+		header.nDetections = pState->ImgRegions.noOfObjects < 255 ? pState->ImgRegions.noOfObjects : 255;
+		//bounding boxes in raw pixels (SENSORIMG has half the resolution), the right and bottom border included
+		for(o = 0; o < pState->ImgRegions.noOfObjects && o < REC_MAX_DETECTIONS; o++) {
+			struct IMG_RECT *pRect = &header.detections[o];
+			pRect->xPos = pState->ImgRegions.objects[o].bboxLeft << (pState->detectShift + 1);
+			pRect->yPos = pState->ImgRegions.objects[o].bboxTop << (pState->detectShift + 1);
+			pRect->width = (pState->ImgRegions.objects[o].bboxRight - pState->ImgRegions.objects[o].bboxLeft + 1) << (pState->detectShift + 1);
+			pRect->height = (pState->ImgRegions.objects[o].bboxBottom - pState->ImgRegions.objects[o].bboxTop + 1) << (pState->detectShift + 1);
+		}
+	}
+	pState->decisionTaken = 0;
+
+	RecorderAddFrame(pData->pCurRawImg, &header);
+}
+
+void ControlGPIO(struct TEMPLATE *pData, struct OSC_PICTURE *picIn, struct OSC_VIS_REGIONS *regions){
+	struct LANE_STATE *pState = pData->pState;
 	//Zeitstempelanalyse:
 
 	//Hier kann eingestellt werden, wie viele Frames vergehen nach dem Entscheiden und dem Handeln, also Ausgang einschalten
-	if (data.ipc.state.nStepCounter-timestamp[0] == 20){
+	//(with an encoder the ejector sits nEjectDistance pulses down the belt instead; the line may
+	//run at any speed then)
+	int ejectDue = 0;
+	if (pState->timestamp[0] == TIMESTAMP_EMPTY) {
+		//nothing pending
+	} else if (pData->ipc.state.nEjectDistance > 0) {
+		ejectDue = PositionReached(pData, pState->timestamp[0] + pData->ipc.state.nEjectDistance);
+	} else {
+		ejectDue = StepReached(pData, pState->timestamp[0] + 20);
+	}
+	if (ejectDue){
+		StatsEjection(pData, FALSE);
 		//Hier kann eingestellt werden wie lange der Ausgang eingeschaltet bleibt
-		gpiotimer += 10;
+		pState->gpiotimer += 10;
 		//Hier wird der abgearbeitete Zeitstempel verworfen und die restlichen rutschen eins nach oben
-		memmove (&timestamp[0], &timestamp[1], sizeof(timestamp) - sizeof(*timestamp));
-		timestamp[sizetimebuffer-1] = 0;
+		memmove (&pState->timestamp[0], &pState->timestamp[1], sizeof(pState->timestamp) - sizeof(*pState->timestamp));
+		pState->timestamp[sizetimebuffer-1] = TIMESTAMP_EMPTY;
 	}
 
 
 //GPIOS ansteuern
+//(only the camera lane owns the outputs, the other lanes just keep the state)
 
 	OSC_ERR err = SUCCESS;
-	if(gpiotimer > 0){
+	if(pState->gpiotimer > 0){
 		//Turn on GPIO
-		err = OscGpioWrite(GPIO_OUT1, TRUE);
-		  outputIO = 1;
-		  gpiotimer--;
+		if(pData->nLane == 0) err = OscGpioWrite(GPIO_OUT1, TRUE);
+		  pState->outputIO = 1;
+		  //the timer runs in frames of the line, dropped ones included
+		  pState->gpiotimer -= pData->nFramesElapsed;
+		  if(pState->gpiotimer < 0) pState->gpiotimer = 0;
 	}else{
 		//Turn off GPIO
-		err = OscGpioWrite(GPIO_OUT1, FALSE);
-		outputIO = 0;l
+		if(pData->nLane == 0) err = OscGpioWrite(GPIO_OUT1, FALSE);
+		pState->outputIO = 0;
 	}
 	if (err != SUCCESS) {
 		fprintf(stderr, "%s: ERROR: GPIO write error! (%d)\n", __func__, err);
@@ -453,15 +792,84 @@ void ControlGPIO(struct OSC_PICTURE *picIn, struct OSC_VIS_REGIONS *regions){
 
 	printf("\n");
 	for(int k = 0; k < sizetimebuffer; k++){
-		printf("%d ", timestamp[k]);
+		printf("%d ", pState->timestamp[k]);
 	}
 	printf("\n");
 	printf("Aktueller Schritt:");
-	printf("%d", data.ipc.state.nStepCounter);
+	printf("%d", pData->ipc.state.nStepCounter);
 	printf("\n");
 	printf("GPIO-Timer:");
-	printf("%d", gpiotimer);
+	printf("%d", pState->gpiotimer);
 	printf("\n");
 
 }
 
+
+/*********************************************************************//*!
+ * @brief write the THRESHOLD image for the web interface: 255 in the
+ * blue plane where the binary image PROCESSFRAME0 is set, 0 elsewhere;
+ * a mask of a coarser detection level is scaled up to the size of
+ * SENSORIMG
+ *//*********************************************************************/
+void GetThresholdImage(struct TEMPLATE *pData, uint8 *pDst)
+{
+	struct LANE_STATE *pState = pData->pState;
+	const int dnc = nc >> pState->detectShift;
+	int row, col;
+
+	memset(pDst, 0, NUM_COLORS*siz);
+	if(!pState->maskValid) {
+		return;
+	}
+	for(row = 0; row < nr; row++) {
+		const uint8 *pMask = &ImgData(pData, PROCESSFRAME0)[(row >> pState->detectShift)*dnc];
+		uint8 *pThr = &pDst[row*nc*NUM_COLORS];
+		for(col = 0; col < nc; col++) {
+			pThr[col*NUM_COLORS] = pMask[col >> pState->detectShift] ? 255 : 0;
+		}
+	}
+}
+
+const uint8 *GetForegroundMask(struct TEMPLATE *pData, uint8 *pShift) {
+	struct LANE_STATE *pState = pData->pState;
+	//the mask is on the detection level, half the raw size or coarser
+	*pShift = pState->detectShift + 1;
+	return pState->maskValid ? ImgData(pData, PROCESSFRAME0) : NULL;
+}
+
+/*********************************************************************//*!
+ * @brief fill in the answer to the GET_REGION_COLORS request
+ *//*********************************************************************/
+void GetRegionColors(struct TEMPLATE *pData, struct REGION_COLORS *pColors)
+{
+	struct LANE_STATE *pState = pData->pState;
+	//the bounding boxes of all regions are summed up in constant time each
+	const int bBoxSums = IntegralImagesReady(pData);
+	uint16 o, cpl;
+
+	pColors->nStepCounter = pData->ipc.state.nStepCounter;
+	pColors->nRegions = pState->nRegionColors < IPC_MAX_REGIONS ? pState->nRegionColors : IPC_MAX_REGIONS;
+	for(o = 0; o < pColors->nRegions; o++) {
+		struct REGION_COLOR_INFO *pInfo = &pColors->regions[o];
+		//bounding boxes are reported in pixels of SENSORIMG, the right and bottom border included
+		pInfo->bbox.xPos = pState->ImgRegions.objects[o].bboxLeft << pState->detectShift;
+		pInfo->bbox.yPos = pState->ImgRegions.objects[o].bboxTop << pState->detectShift;
+		pInfo->bbox.width = (pState->ImgRegions.objects[o].bboxRight - pState->ImgRegions.objects[o].bboxLeft + 1) << pState->detectShift;
+		pInfo->bbox.height = (pState->ImgRegions.objects[o].bboxBottom - pState->ImgRegions.objects[o].bboxTop + 1) << pState->detectShift;
+		//(in pixels of SENSORIMG, also for regions whose colours were not measured)
+		pInfo->area = pState->ImgRegions.objects[o].area << 2*pState->detectShift;
+
+		memset(pInfo->mean, 0, sizeof(pInfo->mean));
+		pInfo->fgPermille = 0;
+		if(bBoxSums) {
+			struct INTEGRAL_SUM boxSum;
+			IntegralBoxSum(pData, &pInfo->bbox, &boxSum);
+			for(cpl = 0; cpl < NUM_COLORS; cpl++) {
+				pInfo->mean[cpl] = boxSum.fg ? boxSum.sum[cpl]/boxSum.fg : 0;
+			}
+			pInfo->fgPermille = (uint32)boxSum.fg*1000/((uint32)pInfo->bbox.width*pInfo->bbox.height);
+		}
+	}
+	HistToPermille(pState->colorhist, pColors->lastObjectHist);
+	pColors->lastObjectClass = pData->ipc.state.nObjectClass;
+}
@@ -0,0 +1,68 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file pyramid.c
+ * @brief Builds reduced resolution images directly from the raw Bayer
+ * frame for detection.
+ */
+
+#include "pyramid.h"
+#include <string.h>
+
+#if MAX_DETECT_LEVEL > 4
+#error "The block sums of BuildPyramidLevel() would overflow."
+#endif
+
+void BuildPyramidLevel(const uint8 *pRaw, uint16 width, uint16 height, uint8 level, uint8 *pOut)
+{
+	/* Raw pixels per output pixel in each direction. */
+	const uint16 f = 1 << level;
+	const uint16 outWidth = width >> level, outHeight = height >> level;
+	/* log2 of the number of Bayer cells per block. */
+	const uint8 cellShift = 2*(level - 1);
+	/* Sums of blue, green and red over the blocks of one output row. */
+	uint16 acc[3*OSC_CAM_MAX_IMAGE_WIDTH/4];
+	uint16 x, y, r, c;
+
+	for (y = 0; y < outHeight; y++)
+	{
+		memset(acc, 0, 3*outWidth*sizeof(uint16));
+		for (r = 0; r < f; r += 2)
+		{
+			/* R G R G ... followed by G B G B ... */
+			const uint8 *pRG = pRaw + (y*f + r)*width;
+			const uint8 *pGB = pRG + width;
+			uint16 *pAcc = acc;
+
+			for (x = 0; x < outWidth; x++)
+			{
+				uint16 sumB = 0, sumG = 0, sumR = 0;
+				for (c = 0; c < f; c += 2)
+				{
+					sumR += pRG[0];
+					sumG += pRG[1] + pGB[0];
+					sumB += pGB[1];
+					pRG += 2;
+					pGB += 2;
+				}
+				pAcc[0] += sumB;
+				pAcc[1] += sumG;
+				pAcc[2] += sumR;
+				pAcc += 3;
+			}
+		}
+
+		for (x = 0; x < outWidth; x++)
+		{
+#if NUM_COLORS == 1
+			*pOut++ = (acc[3*x] + acc[3*x + 1] + acc[3*x + 2]) >> (cellShift + 2);
+#else
+			*pOut++ = acc[3*x] >> cellShift;
+			*pOut++ = acc[3*x + 1] >> (cellShift + 1);
+			*pOut++ = acc[3*x + 2] >> cellShift;
+#endif
+		}
+	}
+}
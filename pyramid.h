@@ -0,0 +1,31 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file pyramid.h
+ * @brief Builds reduced resolution images directly from the raw Bayer
+ * frame for detection.
+ */
+#ifndef PYRAMID_H_
+#define PYRAMID_H_
+
+#include "template.h"
+
+/*********************************************************************//*!
+ * @brief Build one level of the image pyramid from the raw Bayer image.
+ *
+ * Every output pixel is the average of all Bayer cells in a block of
+ * 2^level x 2^level raw pixels, which also suppresses sensor noise. Level
+ * 1 would correspond to the half size debayering. The output has the
+ * same pixel format as SENSORIMG (NUM_COLORS interleaved planes).
+ *
+ * @param pRaw The raw image with ROW_RGRG Bayer order.
+ * @param width Width of the raw image.
+ * @param height Height of the raw image.
+ * @param level Pyramid level, 2 ... MAX_DETECT_LEVEL.
+ * @param pOut Output image of (width >> level) x (height >> level) pixels.
+ *//*********************************************************************/
+void BuildPyramidLevel(const uint8 *pRaw, uint16 width, uint16 height, uint8 level, uint8 *pOut);
+
+#endif /*PYRAMID_H_*/
@@ -0,0 +1,203 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file recorder.c
+ * @brief Black-box recorder keeping the last raw frames of the camera
+ * together with their detections.
+ */
+
+#include "recorder.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+/*! @brief Size of a raw frame in bytes. */
+#define RAW_FRAME_SIZE (OSC_CAM_MAX_IMAGE_WIDTH*OSC_CAM_MAX_IMAGE_HEIGHT)
+
+/*! @brief What the recorder is doing. */
+enum EnRecState
+{
+	REC_RECORDING,
+	REC_POST_TRIGGER,
+	REC_WRITING
+};
+
+/*! @brief A frame of the ring. */
+struct REC_SLOT
+{
+	struct REC_FRAME_HEADER header;
+	uint8 raw[RAW_FRAME_SIZE];
+};
+
+/*! @brief The ring, allocated once for the lifetime of the application. */
+static struct REC_SLOT ring[REC_RING_FRAMES];
+
+/*! @brief State of the recorder, shared with the writer thread. */
+static struct
+{
+	/*! @brief Protects all members. */
+	pthread_mutex_t mutex;
+	/*! @brief Signals the writer that a recording is ready. */
+	pthread_cond_t cond;
+	/*! @brief The writer thread. */
+	pthread_t thread;
+	/*! @brief Whether the writer thread runs. */
+	bool bStarted;
+	enum EnRecState enState;
+	/*! @brief Frames added so far; the next one goes to slot
+	 * nAdded % REC_RING_FRAMES. */
+	uint32 nAdded;
+	/*! @brief Number of the triggering frame (c.f. nAdded). */
+	uint32 nTrigger;
+	/*! @brief Frames still to be added before the recording is written. */
+	uint32 nPostLeft;
+	/*! @brief Number of recordings written. */
+	uint32 nWritten;
+	/*! @brief Number of triggers ignored because of a pending recording. */
+	uint32 nMissed;
+} rec = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+/*********************************************************************//*!
+ * @brief Write the frames nFirst ... nLast (c.f. rec.nAdded) to a file.
+ *//*********************************************************************/
+static OSC_ERR WriteRecording(uint32 nFirst, uint32 nLast, uint32 nTrigger, uint32 seq)
+{
+	char strFile[64];
+	struct REC_FILE_HEADER header;
+	FILE *pFile;
+	uint32 n;
+	OSC_ERR err = SUCCESS;
+
+	sprintf(strFile, "%s%05u.rec", REC_FILE_PREFIX, (unsigned int)seq);
+	pFile = fopen(strFile, "wb");
+	if (pFile == NULL)
+	{
+		OscLog(ERROR, "%s: Unable to open %s!\n", __func__, strFile);
+		return -EUNABLE_TO_OPEN_FILE;
+	}
+
+	header.magic = REC_MAGIC;
+	header.width = OSC_CAM_MAX_IMAGE_WIDTH;
+	header.height = OSC_CAM_MAX_IMAGE_HEIGHT;
+	header.nFrames = nLast - nFirst + 1;
+	header.nTriggerFrame = nTrigger - nFirst;
+	if (fwrite(&header, sizeof(header), 1, pFile) != 1)
+	{
+		err = -EFILE_ERROR;
+	}
+	for (n = nFirst; n <= nLast && err == SUCCESS; n++)
+	{
+		struct REC_SLOT *pSlot = &ring[n % REC_RING_FRAMES];
+		if (fwrite(&pSlot->header, sizeof(pSlot->header), 1, pFile) != 1 ||
+				fwrite(pSlot->raw, RAW_FRAME_SIZE, 1, pFile) != 1)
+		{
+			err = -EFILE_ERROR;
+		}
+	}
+	if (fclose(pFile) != 0 && err == SUCCESS)
+	{
+		err = -EFILE_ERROR;
+	}
+	if (err != SUCCESS)
+	{
+		OscLog(ERROR, "%s: Error writing %s!\n", __func__, strFile);
+	}
+	return err;
+}
+
+/*********************************************************************//*!
+ * @brief The writer thread; the slots of a recording are not touched by
+ * the frame loop until it is written.
+ *//*********************************************************************/
+static void *RecorderMain(void *pArg)
+{
+	uint32 nFirst, nLast, nTrigger, seq;
+
+	pthread_mutex_lock(&rec.mutex);
+	for (;;)
+	{
+		while (rec.enState != REC_WRITING)
+		{
+			pthread_cond_wait(&rec.cond, &rec.mutex);
+		}
+		nLast = rec.nAdded - 1;
+		nTrigger = rec.nTrigger;
+		nFirst = nTrigger > REC_PRE_FRAMES ? nTrigger - REC_PRE_FRAMES : 0;
+		/* The oldest recording is replaced. */
+		seq = rec.nWritten % REC_MAX_FILES;
+		pthread_mutex_unlock(&rec.mutex);
+
+		WriteRecording(nFirst, nLast, nTrigger, seq);
+
+		pthread_mutex_lock(&rec.mutex);
+		rec.nWritten++;
+		rec.enState = REC_RECORDING;
+	}
+	return NULL;
+}
+
+OSC_ERR RecorderInit()
+{
+	if (pthread_create(&rec.thread, NULL, RecorderMain, NULL) != 0)
+	{
+		OscLog(ERROR, "%s: Unable to start the writer!\n", __func__);
+		return -EDEVICE;
+	}
+	rec.bStarted = TRUE;
+	return SUCCESS;
+}
+
+void RecorderAddFrame(const uint8 *pRaw, const struct REC_FRAME_HEADER *pHeader)
+{
+	struct REC_SLOT *pSlot;
+
+	pthread_mutex_lock(&rec.mutex);
+	if (!rec.bStarted || rec.enState == REC_WRITING)
+	{
+		pthread_mutex_unlock(&rec.mutex);
+		return;
+	}
+	pSlot = &ring[rec.nAdded % REC_RING_FRAMES];
+	pthread_mutex_unlock(&rec.mutex);
+
+	/* Only the frame loop adds frames and the writer does not read the
+	 * ring before it is told to, so the copy needs no lock. */
+	pSlot->header = *pHeader;
+	memcpy(pSlot->raw, pRaw, RAW_FRAME_SIZE);
+
+	pthread_mutex_lock(&rec.mutex);
+	rec.nAdded++;
+	if (rec.enState == REC_POST_TRIGGER && --rec.nPostLeft == 0)
+	{
+		rec.enState = REC_WRITING;
+		pthread_cond_signal(&rec.cond);
+	}
+	pthread_mutex_unlock(&rec.mutex);
+}
+
+void RecorderTrigger()
+{
+	pthread_mutex_lock(&rec.mutex);
+	if (!rec.bStarted || rec.enState != REC_RECORDING)
+	{
+		rec.nMissed++;
+	}
+	else
+	{
+		rec.enState = REC_POST_TRIGGER;
+		rec.nTrigger = rec.nAdded;
+		rec.nPostLeft = 1 + REC_POST_FRAMES;
+	}
+	pthread_mutex_unlock(&rec.mutex);
+}
+
+void RecorderGetState(struct APPLICATION_STATE *pState)
+{
+	pthread_mutex_lock(&rec.mutex);
+	pState->nRecordings = rec.nWritten;
+	pState->nRecordingsMissed = rec.nMissed;
+	pState->bRecorderBusy = rec.enState != REC_RECORDING;
+	pthread_mutex_unlock(&rec.mutex);
+}
@@ -0,0 +1,117 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file recorder.h
+ * @brief Black-box recorder keeping the last raw frames of the camera
+ * together with their detections.
+ *
+ * The frames are copied into a ring allocated at start-up. A trigger (a
+ * decision or a request of the web interface) lets the recorder go on
+ * for REC_POST_FRAMES frames; the REC_PRE_FRAMES frames before the
+ * trigger, the triggering one and the ones after it are then written to
+ * a file by a thread of its own. Recording pauses until the file is
+ * written, triggers in the meantime are counted as missed. Only the last
+ * REC_MAX_FILES recordings are kept, the oldest one is overwritten.
+ *
+ * A recording consists of a struct REC_FILE_HEADER followed by the
+ * frames, each a struct REC_FRAME_HEADER and width*height raw bytes.
+ */
+#ifndef RECORDER_H_
+#define RECORDER_H_
+
+#include "template.h"
+
+/*! @brief Frames kept before the triggering one. */
+#define REC_PRE_FRAMES 10
+/*! @brief Frames recorded after the triggering one. */
+#define REC_POST_FRAMES 5
+/*! @brief Number of frames of the ring. */
+#define REC_RING_FRAMES (REC_PRE_FRAMES + 1 + REC_POST_FRAMES)
+/*! @brief Detections kept per frame. */
+#define REC_MAX_DETECTIONS 8
+/*! @brief The recordings are named after this prefix and a sequence
+ * number. */
+#define REC_FILE_PREFIX "/tmp/blackbox"
+/*! @brief Number of recordings kept; the sequence numbers wrap around
+ * after it. /tmp is in RAM on the target and a recording of
+ * REC_RING_FRAMES raw frames takes about 5.8 MB. */
+#define REC_MAX_FILES 3
+/*! @brief Identifies a recording. */
+#define REC_MAGIC 0x43524242 /* "BBRC" */
+
+/*! @brief Header of a recording. */
+struct REC_FILE_HEADER
+{
+	/*! @brief REC_MAGIC. */
+	uint32 magic;
+	/*! @brief Width of the raw frames. */
+	uint16 width;
+	/*! @brief Height of the raw frames. */
+	uint16 height;
+	/*! @brief Number of frames of the recording. */
+	uint16 nFrames;
+	/*! @brief Index of the triggering frame. */
+	uint16 nTriggerFrame;
+};
+
+/*! @brief Header of a recorded frame. */
+struct REC_FRAME_HEADER
+{
+	/*! @brief The step counter of the frame. */
+	uint32 nStepCounter;
+	/*! @brief Time of the capture in micro seconds (wraps around). */
+	uint32 nTimeMicroSecs;
+	/*! @brief Shutter width the frame was taken with in micro seconds. */
+	uint32 nShutterWidth;
+	/*! @brief Whether the frame was processed (not skipped). */
+	uint8 bProcessed;
+	/*! @brief Whether a decision was taken in the frame. */
+	uint8 bDecision;
+	/*! @brief Colour class of the last object a decision was taken for. */
+	uint8 nObjectClass;
+	/*! @brief Number of regions found; only the first REC_MAX_DETECTIONS
+	 * are kept. */
+	uint8 nDetections;
+	/*! @brief State of the GPIO inputs at the capture, bit n for input
+	 * n + 1. */
+	uint8 gpioIn;
+	/*! @brief Reserved, zero. */
+	uint8 reserved[3];
+	/*! @brief Bounding boxes of the regions in raw pixels. */
+	struct IMG_RECT detections[REC_MAX_DETECTIONS];
+};
+
+/*********************************************************************//*!
+ * @brief Start the thread writing the recordings.
+ *
+ * @return SUCCESS or an appropriate error code.
+ *//*********************************************************************/
+OSC_ERR RecorderInit();
+
+/*********************************************************************//*!
+ * @brief Add the current raw frame of the camera to the ring.
+ *
+ * Does nothing while a recording is written.
+ *
+ * @param pRaw The raw frame.
+ * @param pHeader Step counter, time stamp and detections of the frame.
+ *//*********************************************************************/
+void RecorderAddFrame(const uint8 *pRaw, const struct REC_FRAME_HEADER *pHeader);
+
+/*********************************************************************//*!
+ * @brief Write a recording around the next frame added.
+ *
+ * Counted as missed if a recording is pending already.
+ *//*********************************************************************/
+void RecorderTrigger();
+
+/*********************************************************************//*!
+ * @brief Copy the counters of the recorder to the application state.
+ *
+ * @param pState The state to update.
+ *//*********************************************************************/
+void RecorderGetState(struct APPLICATION_STATE *pState);
+
+#endif /*RECORDER_H_*/
@@ -0,0 +1,147 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file snapshot.c
+ * @brief Ring of the images last sent to the web interface.
+ */
+
+#include "snapshot.h"
+#include "overlay.h"
+#include <string.h>
+
+/*! @brief The images; nSeq is 0 for an empty entry. */
+static struct SNAPSHOT ring[SNAPSHOT_RING_SIZE];
+/*! @brief The entry replaced next. */
+static uint8 nNextEntry = 0;
+/*! @brief The last frame an image type was asked for at, 0 for never;
+ * indexed by the image types that can be fetched. */
+static uint32 nAskedSeq[SNAPSHOT_NUM_TYPES];
+/*! @brief The last frame SnapshotPublish() rendered. */
+static uint32 nPublishedSeq = 0;
+
+/*********************************************************************//*!
+ * @brief Render an image type of the last processed frame as the live
+ * image is sent.
+ *//*********************************************************************/
+static void SnapshotRender(enum IMG_TYPE type, uint8 *pDst)
+{
+	switch (type)
+	{
+	case SENSORIMG:
+		ImgCopyInterleaved(&data, SENSORIMG, pDst);
+		OverlayRender(&data, pDst);
+		break;
+	case THRESHOLD:
+		GetThresholdImage(&data, pDst);
+		break;
+	default:
+		ImgCopyInterleaved(&data, type, pDst);
+		break;
+	}
+}
+
+/*********************************************************************//*!
+ * @brief The entry holding an image type of a frame, NULL if there is
+ * none.
+ *//*********************************************************************/
+static struct SNAPSHOT *SnapshotFind(uint32 type, uint32 seq)
+{
+	uint8 i;
+
+	for (i = 0; i < SNAPSHOT_RING_SIZE; i++)
+	{
+		if (ring[i].nSeq != 0 && ring[i].nImageType == type && (ring[i].nSeq & SNAPSHOT_SEQ_MASK) == seq)
+		{
+			return &ring[i];
+		}
+	}
+	return NULL;
+}
+
+/*********************************************************************//*!
+ * @brief Render an image type of the last processed frame into the entry
+ * replaced next.
+ *//*********************************************************************/
+static struct SNAPSHOT *SnapshotStore(uint32 type)
+{
+	struct SNAPSHOT *pEntry = &ring[nNextEntry];
+
+	nNextEntry = (nNextEntry + 1) % SNAPSHOT_RING_SIZE;
+	pEntry->nSeq = data.ipc.state.nFrameSeq;
+	pEntry->nImageType = type;
+	pEntry->nStepCounter = data.nFrameStepCounter;
+	pEntry->imageTimeStamp = data.frameTimeStamp;
+	SnapshotRender(type, pEntry->data);
+	return pEntry;
+}
+
+OSC_ERR SnapshotGet(uint32 paramId, struct SNAPSHOT *pSnapshot)
+{
+	const uint32 type = SNAPSHOT_PARAM_TYPE(paramId);
+	const uint32 seq = SNAPSHOT_PARAM_SEQ(paramId);
+	const uint32 lastSeq = data.ipc.state.nFrameSeq;
+	struct SNAPSHOT *pEntry;
+
+	if (type != SENSORIMG && type != BACKGROUND && type != THRESHOLD)
+	{
+		return -EINVALID_PARAMETER;
+	}
+	if (lastSeq == 0)
+	{
+		return -ENO_MSG_AVAIL;
+	}
+	nAskedSeq[type] = lastSeq;
+
+	pEntry = SnapshotFind(type, seq != 0 ? seq : lastSeq & SNAPSHOT_SEQ_MASK);
+	if (pEntry == NULL)
+	{
+		if (seq != 0 && seq != (lastSeq & SNAPSHOT_SEQ_MASK))
+		{
+			/* The frame asked for is gone; another one is not passed
+			 * off as it. */
+			return -ENO_MSG_AVAIL;
+		}
+		pEntry = SnapshotStore(type);
+	}
+
+	memcpy(pSnapshot, pEntry, sizeof(struct SNAPSHOT));
+	return SUCCESS;
+}
+
+void SnapshotPublish(void)
+{
+	const uint32 lastSeq = data.ipc.state.nFrameSeq;
+	bool bWatched = FALSE;
+	uint32 type;
+
+	/* A frame skipped by the motion gating shows nothing new (c.f.
+	 * IdleFrame()). */
+	if (lastSeq == nPublishedSeq)
+	{
+		return;
+	}
+	nPublishedSeq = lastSeq;
+
+	for (type = SENSORIMG; type <= THRESHOLD; type++)
+	{
+		if (nAskedSeq[type] == 0 || lastSeq - nAskedSeq[type] >= SNAPSHOT_ACTIVE_FRAMES)
+		{
+			continue;
+		}
+		bWatched = TRUE;
+		/* Without its colours (c.f. LAZY_COLORS) the live image is left
+		 * to be rendered when it is asked for. */
+		if (type == SENSORIMG && !data.bColorImage)
+		{
+			continue;
+		}
+		SnapshotStore(type);
+	}
+	/* The next frame is debayered in full for the clients. */
+	if (bWatched)
+	{
+		data.bPreviewWanted = TRUE;
+	}
+}
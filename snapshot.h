@@ -0,0 +1,55 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file snapshot.h
+ * @brief Ring of the images last sent to the web interface, so clients
+ * can fetch any image type of a recent frame without switching the state
+ * of the application.
+ *
+ * While clients fetch an image type, each new frame of it is rendered
+ * into the ring as soon as the frame is processed (SnapshotPublish()),
+ * so the frames of the last SNAPSHOT_RING_SIZE/3 steps can be named by
+ * their sequence number. Image types nobody looks at cost nothing. The
+ * ring belongs to the camera lane, which serves the IPC requests.
+ */
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+#include "template.h"
+
+/*! @brief Number of images kept: two frames of each of the three image
+ * types that can be fetched. */
+#define SNAPSHOT_RING_SIZE 6
+/*! @brief Number of frames an image type is rendered at publish time
+ * after it was last asked for. */
+#define SNAPSHOT_ACTIVE_FRAMES 50
+
+/*********************************************************************//*!
+ * @brief Answer a GET_SNAPSHOT request.
+ *
+ * The image of the frame named by the request, or of the last processed
+ * frame for sequence number 0, is taken from the ring. The last frame is
+ * rendered into it if it is not there yet, replacing the oldest image.
+ * The image type counts as watched from now on (c.f. SnapshotPublish()).
+ *
+ * @param paramId The parameter ID of the request (c.f.
+ * SNAPSHOT_PARAM_ID()).
+ * @param pSnapshot Receives the answer.
+ * @return SUCCESS, -EINVALID_PARAMETER for an image type that cannot be
+ * shown or -ENO_MSG_AVAIL before the first frame is processed and for a
+ * frame that is no longer kept.
+ *//*********************************************************************/
+OSC_ERR SnapshotGet(uint32 paramId, struct SNAPSHOT *pSnapshot);
+
+/*********************************************************************//*!
+ * @brief Render the frame just processed into the ring for each image
+ * type asked for within the last SNAPSHOT_ACTIVE_FRAMES frames.
+ *
+ * To be called by the camera lane after each frame; a frame that did not
+ * advance nFrameSeq (an idle one) is not rendered again.
+ *//*********************************************************************/
+void SnapshotPublish(void);
+
+#endif /*SNAPSHOT_H_*/
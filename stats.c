@@ -0,0 +1,123 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file stats.c
+ * @brief Production counters aggregated per second of the line into a
+ * ring of the last STATS_HISTORY_SECONDS seconds.
+ */
+
+#include "stats.h"
+#include "lanestate.h"
+#include <string.h>
+
+/*! @brief Frames of the line per second. */
+#define STATS_FRAMES_PER_SECOND CAM_FRAME_RATE
+
+/*********************************************************************//*!
+ * @brief The entry of the current second; seconds without frames in
+ * between are entered as zeros.
+ *//*********************************************************************/
+static struct STATS_SECOND *StatsNow(struct TEMPLATE *pData)
+{
+	struct STATS_COUNTERS *pStats = &pData->pState->stats;
+	uint32 nSecond = pData->ipc.state.nStepCounter/STATS_FRAMES_PER_SECOND;
+	uint32 nGap;
+
+	if (pStats->nValid == 0)
+	{
+		memset(&pStats->seconds[0], 0, sizeof(pStats->seconds[0]));
+		pStats->seconds[0].nSecond = nSecond;
+		pStats->nNewest = 0;
+		pStats->nValid = 1;
+		return &pStats->seconds[0];
+	}
+
+	nGap = nSecond - pStats->seconds[pStats->nNewest].nSecond;
+	if (nGap > STATS_HISTORY_SECONDS)
+	{
+		/* Only the last ones of a long gap are kept. */
+		nGap = STATS_HISTORY_SECONDS;
+	}
+	while (nGap-- > 0)
+	{
+		pStats->nNewest = (pStats->nNewest + 1) % STATS_HISTORY_SECONDS;
+		memset(&pStats->seconds[pStats->nNewest], 0, sizeof(pStats->seconds[pStats->nNewest]));
+		pStats->seconds[pStats->nNewest].nSecond = nSecond - nGap;
+		if (pStats->nValid < STATS_HISTORY_SECONDS)
+		{
+			pStats->nValid++;
+		}
+	}
+	return &pStats->seconds[pStats->nNewest];
+}
+
+void StatsFrameUnmeasured(struct TEMPLATE *pData)
+{
+	struct STATS_COUNTERS *pStats = &pData->pState->stats;
+
+	StatsNow(pData)->nFrames++;
+	pStats->total.nFrames++;
+}
+
+void StatsFrame(struct TEMPLATE *pData, uint32 nRegions, uint32 nForeground, uint32 nPixels)
+{
+	struct STATS_COUNTERS *pStats = &pData->pState->stats;
+	struct STATS_SECOND *pNow = StatsNow(pData);
+	uint32 nPermille = nPixels > 0 ? nForeground*1000/nPixels : 0;
+
+	pNow->nFrames++;
+	pNow->nFramesMeasured++;
+	pNow->nRegions += nRegions;
+	pNow->nForegroundPermille += nPermille;
+	pStats->total.nFrames++;
+	pStats->total.nFramesMeasured++;
+	pStats->total.nRegions += nRegions;
+	pStats->total.nForegroundPermille += nPermille;
+}
+
+void StatsObject(struct TEMPLATE *pData, enum EnObjectClass objClass)
+{
+	struct STATS_COUNTERS *pStats = &pData->pState->stats;
+
+	StatsNow(pData)->nObjects[objClass]++;
+	pStats->total.nObjects[objClass]++;
+}
+
+void StatsEjection(struct TEMPLATE *pData, bool bDropped)
+{
+	struct STATS_COUNTERS *pStats = &pData->pState->stats;
+	struct STATS_SECOND *pNow = StatsNow(pData);
+
+	if (bDropped)
+	{
+		pNow->nEjectionsDropped++;
+		pStats->total.nEjectionsDropped++;
+	}
+	else
+	{
+		pNow->nEjections++;
+		pStats->total.nEjections++;
+	}
+}
+
+void GetStatsHistory(struct TEMPLATE *pData, struct STATS_HISTORY *pHistory)
+{
+	struct STATS_COUNTERS *pStats = &pData->pState->stats;
+	uint32 i, nOldest;
+
+	/* The ring moves on with the line even without events. */
+	if (pStats->nValid > 0)
+	{
+		StatsNow(pData);
+	}
+	pStats->total.nSecond = pData->ipc.state.nStepCounter/STATS_FRAMES_PER_SECOND;
+	pHistory->total = pStats->total;
+	pHistory->nSeconds = pStats->nValid;
+	nOldest = (pStats->nNewest + STATS_HISTORY_SECONDS + 1 - pStats->nValid) % STATS_HISTORY_SECONDS;
+	for (i = 0; i < pStats->nValid; i++)
+	{
+		pHistory->seconds[i] = pStats->seconds[(nOldest + i) % STATS_HISTORY_SECONDS];
+	}
+}
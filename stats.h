@@ -0,0 +1,66 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file stats.h
+ * @brief Production counters aggregated per second of the line into a
+ * ring of the last STATS_HISTORY_SECONDS seconds.
+ *
+ * Seconds are counted in frames of the line (c.f. FRAME_PERIOD_US), so
+ * they follow the step counter like everything else. Every lane has
+ * counters of its own (c.f. lanestate.h); the web interface sees those
+ * of the camera.
+ */
+#ifndef STATS_H_
+#define STATS_H_
+
+#include "template.h"
+
+/*! @brief The counters of a lane. */
+struct STATS_COUNTERS
+{
+	/*! @brief Totals since the start. */
+	struct STATS_SECOND total;
+	/*! @brief The ring of seconds; seconds[nNewest] is being counted. */
+	struct STATS_SECOND seconds[STATS_HISTORY_SECONDS];
+	/*! @brief Index of the current second in seconds. */
+	uint32 nNewest;
+	/*! @brief Number of valid entries in seconds. */
+	uint32 nValid;
+};
+
+/*********************************************************************//*!
+ * @brief Count a frame that is not measured: a skipped one or one that
+ * becomes the background.
+ *
+ * @param pData The data object of the lane.
+ *//*********************************************************************/
+void StatsFrameUnmeasured(struct TEMPLATE *pData);
+
+/*********************************************************************//*!
+ * @brief Count a processed or idle frame.
+ *
+ * @param pData The data object of the lane.
+ * @param nRegions Regions found in the frame.
+ * @param nForeground Foreground pixels of the frame.
+ * @param nPixels Pixels of the frame.
+ *//*********************************************************************/
+void StatsFrame(struct TEMPLATE *pData, uint32 nRegions, uint32 nForeground, uint32 nPixels);
+
+/*********************************************************************//*!
+ * @brief Count a classified object.
+ *//*********************************************************************/
+void StatsObject(struct TEMPLATE *pData, enum EnObjectClass objClass);
+
+/*********************************************************************//*!
+ * @brief Count an ejection fired or dropped.
+ *//*********************************************************************/
+void StatsEjection(struct TEMPLATE *pData, bool bDropped);
+
+/*********************************************************************//*!
+ * @brief Copy the totals and the ring, oldest second first.
+ *//*********************************************************************/
+void GetStatsHistory(struct TEMPLATE *pData, struct STATS_HISTORY *pHistory);
+
+#endif /*STATS_H_*/
@@ -25,6 +25,67 @@
 /*! @brief The file name of the test image on the host. */
 #define TEST_IMAGE_FN "test.bmp"
 
+/*! @brief Frame rate the camera is triggered at by the line in frames
+ * per second. */
+#define CAM_FRAME_RATE 50
+/*! @brief Nominal time between two frames of the line in micro seconds;
+ * a frame captured later than that counts the missed frames as dropped. */
+#define FRAME_PERIOD_US (1000000/CAM_FRAME_RATE)
+
+/*! @brief Most threads a frame can be split among (host only). */
+#define MAX_BAND_THREADS 8
+/*! @brief Threads a frame is split among after start-up; 1 processes
+ * the frame in the main thread with OscVisLabelBinary(). */
+#define DEFAULT_BAND_THREADS 1
+
+/*! @brief set to one to store the colour images SENSORIMG and BACKGROUND
+ * planar (all blue values, then all green, then all red) instead of
+ * interleaved; they are converted to interleaved BGR only when sent to
+ * the web interface */
+#define PLANAR_COLORS 0
+
+/*! @brief Bayer order of the raw images of the camera. */
+#define CAM_BAYER_ORDER ROW_RGRG
+
+/*! @brief White balance gains of blue, green and red applied while
+ * debayering, 256 is 1.0 (c.f. DebayerHalfSize()); with all at 1.0 the
+ * framework debayers where it is as fast. */
+#define CAM_GAIN_BLUE 256
+#define CAM_GAIN_GREEN 256
+#define CAM_GAIN_RED 256
+
+/*! @brief set to one to detect on a half size luminance image and debayer
+ * the colours only where they are measured (the bounding box of the
+ * activated object); SENSORIMG is debayered in full only while the web
+ * interface shows it or a region of interest is set */
+#define LAZY_COLORS 0
+
+/*! @brief set to one to append every raw frame captured to
+ * DEBUG_DUMP_PREFIX.raw by the background writer of debug.h; frames the
+ * writer cannot take in time are dropped, not waited for */
+#define DEBUG_DUMP_FRAMES 0
+/*! @brief File (without suffix) the raw frames are dumped to. */
+#define DEBUG_DUMP_PREFIX "/tmp/frames"
+
+/*! @brief Pyramid level change detection and labeling run on after
+ * start-up (1: half size SENSORIMG, 2: quarter, 3: eighth size). */
+#define DEFAULT_DETECT_LEVEL 1
+/*! @brief Coarsest supported detection level. */
+#define MAX_DETECT_LEVEL 3
+
+/*! @brief Whether the shutter is controlled automatically after
+ * start-up. */
+#define DEFAULT_AUTO_EXPOSURE FALSE
+
+/*! @brief Operator cleaning up the foreground mask after start-up. */
+#define DEFAULT_MORPH_OP MORPH_NONE
+/*! @brief Minimal region area (half size pixels) after start-up; 0 keeps
+ * all regions. */
+#define DEFAULT_MIN_AREA 0
+/*! @brief Encoder pulses from the camera to the ejector after start-up;
+ * 0 times the ejection in frames. */
+#define DEFAULT_EJECT_DISTANCE 0
+
 
 /*------------------- Main data object and members ------------------*/
 
@@ -60,9 +121,111 @@ enum IMG_TYPE
  	BACKGROUND,
  	THRESHOLD,
  	PROCESSFRAME0,
+ 	DETECTIMG,
+ 	DETECTBACKGROUND,
+ 	LUMAIMG,
+ 	LUMABACKGROUND,
  	MAX_NUM_IMG
 };
 
+/*! @brief The pixel formats of the images in the buffer pool. */
+enum EnImgFormat
+{
+	/*! @brief Three interleaved planes in the order blue, green, red. */
+	IMG_FORMAT_BGR24,
+	/*! @brief Three planes blue, green, red one after the other. */
+	IMG_FORMAT_BGR24_PLANAR,
+	/*! @brief One plane of 8 bit values. */
+	IMG_FORMAT_GREY8,
+	/*! @brief One plane of values 0 and 1. */
+	IMG_FORMAT_BINARY
+};
+
+#if NUM_COLORS == 1
+/*! @brief Format of the images debayered from the camera. */
+#define IMG_FORMAT_COLOR IMG_FORMAT_GREY8
+/*! @brief Format of the pyramid levels used for detection. */
+#define IMG_FORMAT_PYRAMID IMG_FORMAT_GREY8
+#else
+#if PLANAR_COLORS
+/*! @brief Format of the images debayered from the camera. */
+#define IMG_FORMAT_COLOR IMG_FORMAT_BGR24_PLANAR
+#else
+/*! @brief Format of the images debayered from the camera. */
+#define IMG_FORMAT_COLOR IMG_FORMAT_BGR24
+#endif
+/*! @brief Format of the pyramid levels used for detection; always
+ * interleaved as written by BuildPyramidLevel(). */
+#define IMG_FORMAT_PYRAMID IMG_FORMAT_BGR24
+#endif
+
+#if LAZY_COLORS && NUM_COLORS == 1
+#error "LAZY_COLORS needs colour images (NUM_COLORS 3)"
+#endif
+
+#if PLANAR_COLORS
+/*! @brief Index of colour plane cpl of pixel i in a colour image of nPix
+ * pixels. */
+#define COLOR_INDEX(i, cpl, nPix) ((cpl)*(nPix) + (i))
+#else
+/*! @brief Index of colour plane cpl of pixel i in a colour image of nPix
+ * pixels. */
+#define COLOR_INDEX(i, cpl, nPix) ((i)*NUM_COLORS + (cpl))
+#endif
+
+/*! @brief Describes an image buffer of the pool. */
+struct IMG_DESC
+{
+	/*! @brief The first pixel of the image. */
+	uint8 *pData;
+	/*! @brief Width of the image in pixels. */
+	uint16 width;
+	/*! @brief Height of the image in pixels. */
+	uint16 height;
+	/*! @brief Distance between two rows of a plane in bytes. */
+	uint16 stride;
+	/*! @brief Number of planes. */
+	uint8 nPlanes;
+	/*! @brief The pixel format. */
+	enum EnImgFormat format;
+	/*! @brief Number of bytes reserved for the buffer. */
+	uint32 capacity;
+};
+
+/*! @brief Bytes of a colour image of half the camera resolution. */
+#define IMG_SIZE_HALF_COLOR (NUM_COLORS*(OSC_CAM_MAX_IMAGE_WIDTH/2)*(OSC_CAM_MAX_IMAGE_HEIGHT/2))
+/*! @brief Bytes of a one plane image of half the camera resolution. */
+#define IMG_SIZE_HALF_MASK ((OSC_CAM_MAX_IMAGE_WIDTH/2)*(OSC_CAM_MAX_IMAGE_HEIGHT/2))
+/*! @brief Bytes of a colour image of a quarter of the camera resolution. */
+#define IMG_SIZE_QUARTER_COLOR (NUM_COLORS*(OSC_CAM_MAX_IMAGE_WIDTH/4)*(OSC_CAM_MAX_IMAGE_HEIGHT/4))
+#if LAZY_COLORS
+/*! @brief Bytes of the two luminance images (c.f. LAZY_COLORS). */
+#define IMG_SIZE_LUMA (2*IMG_SIZE_HALF_MASK)
+#else
+/*! @brief Bytes of the two luminance images (c.f. LAZY_COLORS). */
+#define IMG_SIZE_LUMA 0
+#endif
+/*! @brief Alignment of the buffers in the pool. */
+#define IMG_ALIGN 32
+/*! @brief Size of the memory the pool buffers are taken from: SENSORIMG
+ * and BACKGROUND in colour, the mask and the two detection images of
+ * pyramid level 2 or coarser, and the luminance images. THRESHOLD has no
+ * buffer (c.f. GetThresholdImage()). */
+#define IMG_ARENA_SIZE (2*IMG_SIZE_HALF_COLOR + IMG_SIZE_HALF_MASK + 2*IMG_SIZE_QUARTER_COLOR + IMG_SIZE_LUMA + MAX_NUM_IMG*IMG_ALIGN)
+
+/*! @brief The image buffers and their assignment to the image roles. */
+struct IMG_POOL
+{
+	/*! @brief The memory all buffers are taken from. */
+	uint8 u8Arena[IMG_ARENA_SIZE] __attribute__((aligned(IMG_ALIGN)));
+	/*! @brief The buffers in the pool. */
+	struct IMG_DESC buffers[MAX_NUM_IMG];
+	/*! @brief Index of the buffer holding the image of each role. */
+	uint8 role[MAX_NUM_IMG];
+};
+
+/*! @brief State of the processing modules of a lane (c.f. lanestate.h). */
+struct LANE_STATE;
 
 /*! @brief The structure storing all important variables of the application.
  * */
@@ -70,10 +233,53 @@ struct TEMPLATE
 {
 	/*! @brief The frame buffers for the frame capture device driver.*/
 	uint8 u8FrameBuffers[NR_FRAME_BUFFERS][OSC_CAM_MAX_IMAGE_HEIGHT*OSC_CAM_MAX_IMAGE_WIDTH];
-	/*! @brief A buffer to hold the temporary image. */
-	uint8 u8TempImage[MAX_NUM_IMG][NUM_COLORS*OSC_CAM_MAX_IMAGE_WIDTH/2*OSC_CAM_MAX_IMAGE_HEIGHT/2];
+	/*! @brief The buffers of the images used for processing. */
+	struct IMG_POOL imgPool;
+	/*! @brief The current SENSORIMG becomes the background with the next
+	 * frame. */
+	bool bRebaseBackground;
+	/*! @brief BACKGROUND (and the detection backgrounds) were restored
+	 * from the last run and are used from the first frame (c.f.
+	 * warmstart.h). */
+	bool bWarmBackground;
+	/*! @brief The lane started with a background of the last run, which
+	 * is not replaced once the first frames are in (c.f. ProcessFrame()). */
+	bool bWarmStarted;
 	/* indicates that the shutter time changed */
 	bool nExposureTimeChanged;
+	/*! @brief Frames until the first image taken with a new shutter width
+	 * is processed; counts down from 2 when the width is changed. */
+	uint8 nExposureSettle;
+	/*! @brief Regions were found in the last processed frame. */
+	bool bForeground;
+	/*! @brief Frame periods since the previous capture; nStepCounter
+	 * advances by this amount. */
+	unsigned int nFramesElapsed;
+	/*! @brief Processing of the current frame is skipped because the
+	 * previous one took longer than a frame period. */
+	bool bSkipFrame;
+	/*! @brief SENSORIMG of the current frame is debayered in full (always
+	 * unless LAZY_COLORS). */
+	bool bColorImage;
+	/*! @brief The web interface fetched a live image; the next frame is
+	 * debayered in full (c.f. LAZY_COLORS). */
+	bool bPreviewWanted;
+	/*! @brief Cycle counter at the trigger of the capture in progress;
+	 * becomes ipc.state.imageTimeStamp when the frame arrives. */
+	uint32 captureTimeStamp;
+	/*! @brief Cycle counter at the arrival of the current frame. */
+	uint32 receiveTimeStamp;
+	/*! @brief Step counter and capture time stamp of the frame
+	 * ipc.state.nFrameSeq (c.f. snapshot.h). */
+	uint32 nFrameStepCounter, frameTimeStamp;
+	/*! @brief Index of the lane this data belongs to; 0 is the camera. */
+	uint8 nLane;
+	/*! @brief Belt position (encoder pulses) at the capture of the current
+	 * frame; 0 in lanes other than the camera. */
+	uint32 nBeltPosition;
+	/*! @brief State of the GPIO inputs at the capture of the current
+	 * frame, bit n for input n + 1. */
+	uint8 gpioIn;
 	/* the threshold used for processing purposes */
 	int nThreshold;
 	/*! @brief Handle to the framework instance. */
@@ -90,9 +296,13 @@ struct TEMPLATE
 	uint8* pCurRawImg;
 	/*! @brief All data necessary for IPC. */
 	struct IPC_DATA ipc;
-
+	/*! @brief State of the processing of this lane (c.f. LaneStateInit()). */
+	struct LANE_STATE *pState;
 };
 
+/*! @brief The main data object of the camera lane. The processing shared
+ * with the other lanes (c.f. lanes.h) gets the data object of its lane
+ * passed as pData instead. */
 extern struct TEMPLATE data;
 
 /*-------------------------- Functions --------------------------------*/
@@ -143,14 +353,100 @@ OSC_ERR AckIpcRequests();
  *//*********************************************************************/
 void IpcSendImage(fract16 *f16Image, uint32 nPixels);
 
+/*********************************************************************//*!
+ * @brief Lay out the image buffers in the pool.
+ *
+ * Every role gets a buffer of the format and maximum size it is used
+ * with.
+ *
+ * @param pData The data object of the lane.
+ * @return SUCCESS or an appropriate error code.
+ *//*********************************************************************/
+OSC_ERR ImgPoolInit(struct TEMPLATE *pData);
+
+/*********************************************************************//*!
+ * @brief Get the descriptor of the buffer currently holding an image.
+ *
+ * @param pData The data object of the lane.
+ * @param role The image.
+ * @return Pointer to the descriptor.
+ *//*********************************************************************/
+static inline struct IMG_DESC *ImgDesc(struct TEMPLATE *pData, enum IMG_TYPE role)
+{
+	return &pData->imgPool.buffers[pData->imgPool.role[role]];
+}
+
+/*********************************************************************//*!
+ * @brief Get the pixel data of an image.
+ *
+ * @param pData The data object of the lane.
+ * @param role The image.
+ * @return Pointer to the first pixel.
+ *//*********************************************************************/
+static inline uint8 *ImgData(struct TEMPLATE *pData, enum IMG_TYPE role)
+{
+	return ImgDesc(pData, role)->pData;
+}
+
+/*********************************************************************//*!
+ * @brief Get the number of bytes of an image.
+ *
+ * @param pData The data object of the lane.
+ * @param role The image.
+ * @return Size of the image in its current geometry.
+ *//*********************************************************************/
+static inline uint32 ImgSize(struct TEMPLATE *pData, enum IMG_TYPE role)
+{
+	const struct IMG_DESC *pDesc = ImgDesc(pData, role);
+	if (pDesc->format == IMG_FORMAT_BGR24_PLANAR)
+		return (uint32)pDesc->stride*pDesc->height*pDesc->nPlanes;
+	return (uint32)pDesc->stride*pDesc->height;
+}
+
+/*********************************************************************//*!
+ * @brief Change width and height of an image within its buffer.
+ *
+ * @param pData The data object of the lane.
+ * @param role The image.
+ * @param width The new width.
+ * @param height The new height.
+ * @return SUCCESS or -EBUFFER_TOO_SMALL.
+ *//*********************************************************************/
+OSC_ERR ImgSetGeometry(struct TEMPLATE *pData, enum IMG_TYPE role, uint16 width, uint16 height);
+
+/*********************************************************************//*!
+ * @brief Copy an image to a buffer in the format of the web interface.
+ *
+ * Planar colour images are interleaved on the fly, all other formats
+ * are copied as they are.
+ *
+ * @param pData The data object of the lane.
+ * @param role The image.
+ * @param pDst Destination of ImgSize(pData, role) bytes.
+ *//*********************************************************************/
+void ImgCopyInterleaved(struct TEMPLATE *pData, enum IMG_TYPE role, uint8 *pDst);
+
+/*********************************************************************//*!
+ * @brief Exchange the buffers of two images of the same format.
+ *
+ * This is how an image takes over the role of another one, e.g. the
+ * current frame becomes the background, without copying any pixels.
+ *
+ * @param pData The data object of the lane.
+ * @param roleA The first image.
+ * @param roleB The second image.
+ *//*********************************************************************/
+void ImgSwapRoles(struct TEMPLATE *pData, enum IMG_TYPE roleA, enum IMG_TYPE roleB);
+
 /*********************************************************************//*!
  * @brief initialize processing .
  *
  * here all initialization required for the function ProcessFrame() can
  * be done
  *
+ * @param pData The data object of the camera lane.
  *//*********************************************************************/
-void InitProcess();
+void InitProcess(struct TEMPLATE *pData);
 
 /*********************************************************************//*!
  * @brief Process a newly captured frame.
@@ -159,7 +455,121 @@ void InitProcess();
  * image and writing the result to the result image buffer. This should
  * be the starting point where you add your code.
  * 
+ * @param pData The data object of the lane.
+ *//*********************************************************************/
+void ProcessFrame(struct TEMPLATE *pData);
+
+/*********************************************************************//*!
+ * @brief Debayer the raw image pData->pCurRawImg and process it.
+ *
+ * Takes over a background marked in the last step first. Used by the
+ * camera and by all other lanes.
+ *
+ * @param pData The data object of the lane.
+ *//*********************************************************************/
+void ProcessRawFrame(struct TEMPLATE *pData);
+
+/*********************************************************************//*!
+ * @brief Handle a frame without motion after an empty frame instead of
+ * processing it (c.f. motion.h).
+ *
+ * Nothing is debayered or detected; the step based logic and the digital
+ * outputs advance as for a processed frame.
+ *
+ * @param pData The data object of the lane.
+ * @return 1 if the frame was handled, 0 if it has to be processed.
+ *//*********************************************************************/
+int IdleFrame(struct TEMPLATE *pData);
+
+/*********************************************************************//*!
+ * @brief Advance the time based logic for a frame that is not
+ * processed.
+ *
+ * Keeps the digital outputs on schedule while the loop catches up.
+ *
+ * @param pData The data object of the lane.
+ *//*********************************************************************/
+void SkipFrame(struct TEMPLATE *pData);
+
+/*********************************************************************//*!
+ * @brief Change detection between two interleaved images.
+ *
+ * Writes the binary result to PROCESSFRAME0.
+ *
+ * @param pData The data object of the lane.
+ * @param pImg The current image.
+ * @param pBg The background image.
+ * @param width Width of the images.
+ * @param height Height of the images.
+ *//*********************************************************************/
+void ChangeDetection(struct TEMPLATE *pData, const uint8 *pImg, const uint8 *pBg, int width, int height);
+
+/*********************************************************************//*!
+ * @brief ChangeDetection() as a loop over rows and columns; the
+ * reference the flat kernel is measured against (c.f. bench.c).
+ *//*********************************************************************/
+void ChangeDetectionGeneric(struct TEMPLATE *pData, const uint8 *pImg, const uint8 *pBg, int width, int height);
+
+/*********************************************************************//*!
+ * @brief Change detection between two planar images.
+ *
+ * Same as ChangeDetection() but every plane is read with unit stride.
+ *
+ * @param pData The data object of the lane.
+ * @param pImg The current image.
+ * @param pBg The background image.
+ * @param width Width of the images.
+ * @param height Height of the images.
+ *//*********************************************************************/
+void ChangeDetectionPlanar(struct TEMPLATE *pData, const uint8 *pImg, const uint8 *pBg, int width, int height);
+
+/*********************************************************************//*!
+ * @brief ChangeDetectionPlanar() without the kernel; the reference it
+ * is measured against (c.f. bench.c).
+ *//*********************************************************************/
+void ChangeDetectionPlanarGeneric(struct TEMPLATE *pData, const uint8 *pImg, const uint8 *pBg, int width, int height);
+
+/*********************************************************************//*!
+ * @brief Change detection between two luminance images (c.f.
+ * LAZY_COLORS).
+ *
+ * A pixel counts as changed like a colour pixel whose planes all differ
+ * by the same amount.
+ *//*********************************************************************/
+void ChangeDetectionGrey(struct TEMPLATE *pData, const uint8 *pImg, const uint8 *pBg, int width, int height);
+
+/*********************************************************************//*!
+ * @brief Run the benchmarks of the processing kernels and log the
+ * results.
+ *//*********************************************************************/
+void RunBenchmarks();
+
+/*********************************************************************//*!
+ * @brief Fill in the colour statistics of the regions found in the
+ * last processed frame.
+ *
+ * @param pData The data object of the lane.
+ * @param pColors The answer of the GET_REGION_COLORS request.
+ *//*********************************************************************/
+void GetRegionColors(struct TEMPLATE *pData, struct REGION_COLORS *pColors);
+
+/*********************************************************************//*!
+ * @brief Write the THRESHOLD image of the last processed frame; it is
+ * built from the mask only when it is asked for.
+ *
+ * @param pData The data object of the lane.
+ * @param pDst Receives the image in the format of ImgCopyInterleaved().
+ *//*********************************************************************/
+void GetThresholdImage(struct TEMPLATE *pData, uint8 *pDst);
+
+/*********************************************************************//*!
+ * @brief Get the foreground mask of the last processed frame.
+ *
+ * @param pData The data object of the lane.
+ * @param pShift Receives log2 of the resolution ratio between the raw
+ * image and the mask.
+ * @return The binary mask, NULL before the first mask is built.
  *//*********************************************************************/
-void ProcessFrame();
+const uint8 *GetForegroundMask(struct TEMPLATE *pData, uint8 *pShift);
 
 #endif /*TEMPLATE_H_*/
@@ -21,12 +21,47 @@ enum EnIpcParamIds
 	GET_NEW_IMG,
 	SET_IMAGE_TYPE,
 	SET_EXPOSURE_TIME,
-	SET_THRESHOLD
+	SET_THRESHOLD,
+	GET_REGION_COLORS,
+	SET_DETECT_LEVEL,
+	SET_MORPH_OP,
+	SET_MIN_AREA,
+	SET_ROI,
+	SET_AUTO_EXPOSURE,
+	GET_LANE_STATS,
+	SET_BAND_THREADS,
+	TRIGGER_RECORDING,
+	SET_EJECT_DISTANCE,
+	GET_STATS_HISTORY,
+	WAIT_NEW_FRAME,
+	GET_SNAPSHOT
 };
 
+/*! @brief The bits of a parameter ID naming the request; GET_SNAPSHOT
+ * carries its arguments in the others (c.f. SNAPSHOT_PARAM_ID()). */
+#define IPC_PARAM_MASK 0xff
+/*! @brief Bits of the frame sequence number in a GET_SNAPSHOT request. */
+#define SNAPSHOT_SEQ_MASK 0xfffff
+/*! @brief Parameter ID of a GET_SNAPSHOT request for an image type (enum
+ * IMG_TYPE) of the frame with the given sequence number (c.f. nFrameSeq);
+ * 0 asks for the last processed frame. */
+#define SNAPSHOT_PARAM_ID(type, seq) (GET_SNAPSHOT | (((uint32)(type) & 0xf) << 8) | (((uint32)(seq) & SNAPSHOT_SEQ_MASK) << 12))
+/*! @brief The image type of a GET_SNAPSHOT parameter ID. */
+#define SNAPSHOT_PARAM_TYPE(id) (((id) >> 8) & 0xf)
+/*! @brief The sequence number of a GET_SNAPSHOT parameter ID. */
+#define SNAPSHOT_PARAM_SEQ(id) ((id) >> 12)
+/*! @brief Number of image types there are snapshots of: the first ones
+ * of enum IMG_TYPE, SENSORIMG, BACKGROUND and THRESHOLD. */
+#define SNAPSHOT_NUM_TYPES 3
+
 /*! @brief The path of the unix domain socket used for IPC between the application and its user interface. */
 #define USER_INTERFACE_SOCKET_PATH "/tmp/IPCSocket.sock"
 
+/*! @brief Longest time in milli seconds the CGI waits for a new frame
+ * after WAIT_NEW_FRAME; longer waits are cut to it. Well below the 2 s
+ * the web interface waits for an answer. */
+#define MAX_WAIT_NEW_FRAME_MS 500
+
 /*! @brief Describes a rectangular sub-area of an image. */
 struct IMG_RECT
 {
@@ -40,6 +75,129 @@ struct IMG_RECT
 	uint16 yPos;
 };
 
+/*! @brief The morphological operators to clean up the foreground mask
+ * with before labeling. */
+enum EnMorphOp
+{
+	MORPH_NONE,
+	MORPH_ERODE,
+	MORPH_DILATE,
+	MORPH_OPEN,
+	MORPH_CLOSE
+};
+
+/*! @brief Number of hue bins of a region colour histogram. */
+#define HIST_HUE_BINS 12
+/*! @brief Number of chroma levels each hue bin is split into. */
+#define HIST_CHROMA_LEVELS 2
+/*! @brief Number of brightness bins for pixels without significant chroma
+ * (black ... white). */
+#define HIST_ACHROMATIC_BINS 4
+/*! @brief Total number of bins of a region colour histogram. The
+ * achromatic bins come first, followed by the hue bins of each chroma
+ * level. */
+#define HIST_NUM_BINS (HIST_ACHROMATIC_BINS + HIST_CHROMA_LEVELS*HIST_HUE_BINS)
+
+/*! @brief Maximum number of regions reported by GET_REGION_COLORS. */
+#define IPC_MAX_REGIONS 16
+
+/*! @brief The colour classes the decision logic distinguishes. */
+enum EnObjectClass
+{
+	OBJ_CLASS_NONE,
+	OBJ_CLASS_WHITE,
+	OBJ_CLASS_RED,
+	OBJ_CLASS_OTHER
+};
+
+/*! @brief Colour information of one region as seen by the web interface. */
+struct REGION_COLOR_INFO
+{
+	/*! @brief Bounding box of the region, the border pixels included. */
+	struct IMG_RECT bbox;
+	/*! @brief Number of pixels of the region. */
+	uint32 area;
+	/*! @brief Mean colour of the foreground inside the bounding box (from
+	 * the summed-area tables, c.f. integral.h); 0 while SENSORIMG is not
+	 * debayered in full. */
+	int mean[NUM_COLORS];
+	/*! @brief Foreground pixels of the bounding box in per mille. */
+	uint16 fgPermille;
+};
+
+/*! @brief Answer to the GET_REGION_COLORS request. */
+struct REGION_COLORS
+{
+	/*! @brief The step counter of the frame the regions belong to. */
+	unsigned int nStepCounter;
+	/*! @brief Number of valid entries in regions. */
+	unsigned int nRegions;
+	/*! @brief The regions found in the last frame. */
+	struct REGION_COLOR_INFO regions[IPC_MAX_REGIONS];
+	/*! @brief Histogram (per mille) the last decision was based on; only
+	 * the region being classified is measured (c.f. Activated()), so the
+	 * regions carry no histogram of their own. */
+	uint16 lastObjectHist[HIST_NUM_BINS];
+	/*! @brief Class of the last object a decision was taken for. */
+	enum EnObjectClass lastObjectClass;
+};
+
+/*! @brief Seconds kept by the production statistics. */
+#define STATS_HISTORY_SECONDS 60
+
+/*! @brief Production counters of one second of the line (or totals). */
+struct STATS_SECOND
+{
+	/*! @brief Second of the line (step counter / frames per second). */
+	uint32 nSecond;
+	/*! @brief Frames received, skipped and idle ones included. */
+	uint32 nFrames;
+	/*! @brief Objects classified, per enum EnObjectClass. */
+	uint32 nObjects[OBJ_CLASS_OTHER + 1];
+	/*! @brief Ejections fired. */
+	uint32 nEjections;
+	/*! @brief Ejections dropped because the queue of pending ones was
+	 * full. */
+	uint32 nEjectionsDropped;
+	/*! @brief Regions found, summed over the frames. */
+	uint32 nRegions;
+	/*! @brief Foreground pixels in per mille of the frame, summed over
+	 * the frames. */
+	uint32 nForegroundPermille;
+	/*! @brief Frames nRegions and nForegroundPermille are summed over:
+	 * the processed and the idle ones. */
+	uint32 nFramesMeasured;
+};
+
+/*! @brief Answer to GET_STATS_HISTORY. */
+struct STATS_HISTORY
+{
+	/*! @brief Totals since the start. */
+	struct STATS_SECOND total;
+	/*! @brief Number of valid entries in seconds. */
+	uint32 nSeconds;
+	/*! @brief The last seconds, oldest first; the last one is still
+	 * being counted. */
+	struct STATS_SECOND seconds[STATS_HISTORY_SECONDS];
+};
+
+/*! @brief Answer to GET_SNAPSHOT: an image of a processed frame as the
+ * live image is sent (interleaved, half the camera resolution). */
+struct SNAPSHOT
+{
+	/*! @brief Sequence number of the frame; the frame asked for, the last
+	 * processed one if none was named. */
+	uint32 nSeq;
+	/*! @brief The image type (enum IMG_TYPE). */
+	uint32 nImageType;
+	/*! @brief The step counter of the frame. */
+	uint32 nStepCounter;
+	/*! @brief The time stamp of the capture of the frame. */
+	uint32 imageTimeStamp;
+	/*! @brief The image. */
+	uint8 data[NUM_COLORS*(OSC_CAM_MAX_IMAGE_WIDTH/2)*(OSC_CAM_MAX_IMAGE_HEIGHT/2)];
+};
+
 /*! @brief The different modes the application can be in. */
 enum EnAppMode
 {
@@ -47,6 +205,37 @@ enum EnAppMode
 	APP_CAPTURE_ON
 };
 
+/*! @brief Maximum number of lanes besides the camera. */
+#define MAX_LANES 8
+
+/*! @brief Results and performance counters of a lane. */
+struct LANE_STATS
+{
+	/*! @brief Whether the lane is still processing frames. */
+	bool bRunning;
+	/*! @brief Number of frames processed. */
+	uint32 nFrames;
+	/*! @brief Frames processed in the last full second. */
+	uint32 nFramesPerSecond;
+	/*! @brief Processing time of the last frame in micro seconds. */
+	uint32 nProcessTime;
+	/*! @brief Longest processing time of a frame. */
+	uint32 nMaxProcessTime;
+	/*! @brief Regions were found in the last frame. */
+	bool bForeground;
+	/*! @brief Colour class of the last object a decision was taken for. */
+	enum EnObjectClass nObjectClass;
+};
+
+/*! @brief Answer to GET_LANE_STATS. */
+struct LANES_INFO
+{
+	/*! @brief Number of lanes besides the camera. */
+	uint8 nLanes;
+	/*! @brief The lanes 1 ... nLanes. */
+	struct LANE_STATS lanes[MAX_LANES];
+};
+
 /*! @brief Object describing all the state information the web interface needs to know about the application. */
 struct APPLICATION_STATE
 {
@@ -60,10 +249,70 @@ struct APPLICATION_STATE
 	unsigned int nImageType;
 	/*! @brief Shutter time in micro seconds.*/
 	int nExposureTime;
+	/*! @brief Whether the shutter is controlled automatically; nExposureTime
+	 * is the longest shutter time the control may choose then.*/
+	bool bAutoExposure;
+	/*! @brief Shutter width in micro seconds the camera currently uses.*/
+	int nShutterWidth;
+	/*! @brief Brightness percentile measured by the exposure control.*/
+	int nBrightness;
 	/*! @brief cut off value for change detection.*/
 	int nThreshold;
+	/*! @brief Pyramid level detection runs on (1: half size).*/
+	int nDetectLevel;
+	/*! @brief Operator applied to the foreground mask (enum EnMorphOp).*/
+	int nMorphOp;
+	/*! @brief Minimal area of a region in pixels of the half size image.*/
+	int nMinArea;
+	/*! @brief Region of interest in the half size image; statistics are
+	 * gathered for it while its width and height are non-zero.*/
+	struct IMG_RECT roi;
+	/*! @brief Number of foreground pixels in the region of interest.*/
+	unsigned int nRoiForeground;
+	/*! @brief Mean colour of the foreground in the region of interest.*/
+	int nRoiMean[NUM_COLORS];
 	/*! @brief  the step counter */
 	unsigned int nStepCounter;
+	/*! @brief Sequence number of the last processed frame, counting from
+	 * 1 (c.f. GET_SNAPSHOT).*/
+	unsigned int nFrameSeq;
+	/*! @brief Frames of the line that were never captured, because the
+	 * previous capture came too late.*/
+	unsigned int nDroppedFrames;
+	/*! @brief Frames captured but not processed to catch up with the
+	 * line.*/
+	unsigned int nSkippedFrames;
+	/*! @brief Frames without motion that were not debayered.*/
+	unsigned int nIdleFrames;
+	/*! @brief Delay of the last capture after its nominal time in micro
+	 * seconds (negative: early).*/
+	int nLateness;
+	/*! @brief Largest lateness observed.*/
+	int nMaxLateness;
+	/*! @brief Number of lanes besides the camera (c.f. GET_LANE_STATS).*/
+	unsigned int nLanes;
+	/*! @brief Number of threads change detection and labeling of a
+	 * frame are split among.*/
+	int nBandThreads;
+	/*! @brief Time from the capture to the end of the processing of the
+	 * last processed frame in micro seconds.*/
+	unsigned int nProcessTime;
+	/*! @brief Colour class of the last object a decision was taken for. */
+	enum EnObjectClass nObjectClass;
+	/*! @brief Belt position in encoder pulses at the last capture.*/
+	unsigned int nBeltPosition;
+	/*! @brief Most encoder pulses per second that are counted (c.f.
+	 * EncoderMaxRate()); 0 while not known.*/
+	unsigned int nEncoderMaxRate;
+	/*! @brief Encoder pulses from the camera to the ejector; 0: the
+	 * ejection follows the decision after a fixed number of frames.*/
+	unsigned int nEjectDistance;
+	/*! @brief Number of black-box recordings written.*/
+	unsigned int nRecordings;
+	/*! @brief Triggers ignored because a recording was pending.*/
+	unsigned int nRecordingsMissed;
+	/*! @brief Whether a recording is pending (recording paused).*/
+	bool bRecorderBusy;
 };
 
 #endif /*TEMPLATE_IPC_H_*/
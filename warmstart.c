@@ -0,0 +1,360 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file warmstart.c
+ * @brief Warm start of the camera lane from the background and the
+ * parameters of the last run.
+ */
+
+#include "warmstart.h"
+#include "archive.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*! @brief The file a save is written to before it replaces WARM_FILE. */
+#define WARM_TMP_FILE WARM_FILE ".tmp"
+/*! @brief Frame periods between two saves. */
+#define WARM_SAVE_STEPS ((uint32)WARM_SAVE_PERIOD_S*(1000000/FRAME_PERIOD_US))
+/*! @brief Largest number of bytes of the images. */
+#define WARM_MAX_PAYLOAD (IMG_SIZE_HALF_COLOR + IMG_SIZE_QUARTER_COLOR + IMG_SIZE_LUMA/2)
+
+/*! @brief The images saved, in the order of the file. */
+static const enum IMG_TYPE warmImages[3] = { BACKGROUND, DETECTBACKGROUND, LUMABACKGROUND };
+
+/*! @brief A save handed to the writer thread. */
+static struct
+{
+	struct WARM_HEADER header;
+	uint8 payload[WARM_MAX_PAYLOAD];
+} staging;
+
+/*! @brief State of the saves, shared with the writer thread. */
+static struct
+{
+	/*! @brief Protects all members. */
+	pthread_mutex_t mutex;
+	/*! @brief Signals the writer that staging holds a save. */
+	pthread_cond_t cond;
+	/*! @brief The writer thread. */
+	pthread_t thread;
+	/*! @brief Whether the writer thread runs. */
+	bool bStarted;
+	/*! @brief staging is being written; it is not touched by the frame
+	 * loop meanwhile. */
+	bool bBusy;
+	/*! @brief Step counter of the next save. */
+	uint32 nNextStep;
+} warm = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+/*! @brief Start value of the FNV-1a hash. */
+#define WARM_FNV_BASIS 2166136261u
+
+/*********************************************************************//*!
+ * @brief Continue an FNV-1a hash over a buffer.
+ *//*********************************************************************/
+static uint32 WarmHash(uint32 hash, const uint8 *pData, uint32 size)
+{
+	uint32 i;
+
+	for (i = 0; i < size; i++)
+	{
+		hash = (hash ^ pData[i])*16777619u;
+	}
+	return hash;
+}
+
+/*********************************************************************//*!
+ * @brief Total number of bytes of the images of a header.
+ *//*********************************************************************/
+static uint32 WarmPayloadSize(const struct WARM_HEADER *pHeader)
+{
+	return pHeader->imageSize[0] + pHeader->imageSize[1] + pHeader->imageSize[2];
+}
+
+/*********************************************************************//*!
+ * @brief The checksum of a file: the hash of the header, with checksum
+ * taken as 0, and of the images following it.
+ *//*********************************************************************/
+static uint32 WarmChecksum(const struct WARM_HEADER *pHeader, const uint8 *pPayload)
+{
+	struct WARM_HEADER header = *pHeader;
+
+	header.checksum = 0;
+	return WarmHash(WarmHash(WARM_FNV_BASIS, (const uint8*)&header, sizeof(header)), pPayload, WarmPayloadSize(pHeader));
+}
+
+/*********************************************************************//*!
+ * @brief Number of bytes of a saved image for a detection level;
+ * DETECTBACKGROUND is used on coarser levels only.
+ *//*********************************************************************/
+static uint32 WarmImageSize(enum IMG_TYPE type, int level)
+{
+	if (type != DETECTBACKGROUND)
+	{
+		return ImgSize(&data, type);
+	}
+	if (level == 1)
+	{
+		return 0;
+	}
+	return (uint32)ImgDesc(&data, type)->nPlanes*(OSC_CAM_MAX_IMAGE_WIDTH >> level)*(OSC_CAM_MAX_IMAGE_HEIGHT >> level);
+}
+
+/*********************************************************************//*!
+ * @brief Write the save in staging and let it replace WARM_FILE.
+ *//*********************************************************************/
+static OSC_ERR WriteWarmFile()
+{
+	const uint32 size = WarmPayloadSize(&staging.header);
+	FILE *pFile;
+	OSC_ERR err = SUCCESS;
+
+	staging.header.checksum = WarmChecksum(&staging.header, staging.payload);
+
+	pFile = fopen(WARM_TMP_FILE, "wb");
+	if (pFile == NULL)
+	{
+		OscLog(ERROR, "%s: Unable to open %s!\n", __func__, WARM_TMP_FILE);
+		return -EUNABLE_TO_OPEN_FILE;
+	}
+	if (fwrite(&staging.header, sizeof(staging.header), 1, pFile) != 1 ||
+			fwrite(staging.payload, size, 1, pFile) != 1 ||
+			fflush(pFile) != 0 || fsync(fileno(pFile)) != 0)
+	{
+		err = -EFILE_ERROR;
+	}
+	if (fclose(pFile) != 0 && err == SUCCESS)
+	{
+		err = -EFILE_ERROR;
+	}
+	/* The last save is replaced only by a complete one. */
+	if (err == SUCCESS && rename(WARM_TMP_FILE, WARM_FILE) != 0)
+	{
+		err = -EFILE_ERROR;
+	}
+	if (err != SUCCESS)
+	{
+		OscLog(ERROR, "%s: Error writing %s!\n", __func__, WARM_FILE);
+		unlink(WARM_TMP_FILE);
+	}
+	return err;
+}
+
+/*********************************************************************//*!
+ * @brief The writer thread.
+ *//*********************************************************************/
+static void *WarmStartMain(void *pArg)
+{
+	pthread_mutex_lock(&warm.mutex);
+	for (;;)
+	{
+		while (!warm.bBusy)
+		{
+			pthread_cond_wait(&warm.cond, &warm.mutex);
+		}
+		pthread_mutex_unlock(&warm.mutex);
+
+		WriteWarmFile();
+
+		pthread_mutex_lock(&warm.mutex);
+		warm.bBusy = FALSE;
+	}
+	return NULL;
+}
+
+OSC_ERR WarmStartInit()
+{
+	/* A replayed archive must not replace the state of the line. */
+	if (ArchiveIsSource())
+	{
+		return SUCCESS;
+	}
+	warm.nNextStep = WARM_SAVE_STEPS;
+	if (pthread_create(&warm.thread, NULL, WarmStartMain, NULL) != 0)
+	{
+		OscLog(ERROR, "%s: Unable to start the writer!\n", __func__);
+		return -EDEVICE;
+	}
+	warm.bStarted = TRUE;
+	return SUCCESS;
+}
+
+/*********************************************************************//*!
+ * @brief Check a mapped file against this build; its parameters are
+ * checked as the IPC requests setting them do.
+ *//*********************************************************************/
+static OSC_ERR WarmValidate(const uint8 *pMap, size_t size)
+{
+	const struct WARM_HEADER *pHeader = (const struct WARM_HEADER*)pMap;
+	const int level = pHeader->nDetectLevel;
+	int i;
+
+	if (size < sizeof(struct WARM_HEADER) ||
+			pHeader->magic != WARM_MAGIC ||
+			pHeader->version != WARM_VERSION ||
+			pHeader->format != WARM_FORMAT ||
+			pHeader->width != OSC_CAM_MAX_IMAGE_WIDTH ||
+			pHeader->height != OSC_CAM_MAX_IMAGE_HEIGHT)
+	{
+		return -EFILE_PARSING_ERROR;
+	}
+	if (level < 1 || level > MAX_DETECT_LEVEL ||
+			pHeader->nMorphOp < MORPH_NONE || pHeader->nMorphOp > MORPH_CLOSE ||
+			pHeader->nMinArea < 0 || pHeader->nMinArea > IMG_SIZE_HALF_MASK ||
+			pHeader->nThreshold < 0 || pHeader->nThreshold > 255 ||
+			pHeader->nEjectDistance < 0 ||
+			(pHeader->bAutoExposure != FALSE && pHeader->bAutoExposure != TRUE) ||
+			pHeader->nExposureTime < 1 ||
+			pHeader->nShutterWidth < 1 || (int64)pHeader->nShutterWidth > (int64)pHeader->nExposureTime*100)
+	{
+		return -EFILE_PARSING_ERROR;
+	}
+	for (i = 0; i < 3; i++)
+	{
+		const uint32 expected = WarmImageSize(warmImages[i], level);
+		if (pHeader->imageSize[i] != expected || expected > ImgDesc(&data, warmImages[i])->capacity)
+		{
+			return -EFILE_PARSING_ERROR;
+		}
+	}
+	if (size != sizeof(struct WARM_HEADER) + WarmPayloadSize(pHeader) ||
+			WarmChecksum(pHeader, pMap + sizeof(struct WARM_HEADER)) != pHeader->checksum)
+	{
+		return -EFILE_PARSING_ERROR;
+	}
+	return SUCCESS;
+}
+
+OSC_ERR WarmStartLoad()
+{
+	const struct WARM_HEADER *pHeader;
+	const uint8 *pImage;
+	struct stat st;
+	uint8 *pMap;
+	OSC_ERR err;
+	int fd, i;
+
+	if (ArchiveIsSource())
+	{
+		return -EUNABLE_TO_OPEN_FILE;
+	}
+	fd = open(WARM_FILE, O_RDONLY);
+	if (fd < 0)
+	{
+		/* The first start of the application. */
+		return -EUNABLE_TO_OPEN_FILE;
+	}
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct WARM_HEADER))
+	{
+		close(fd);
+		OscLog(WARN, "%s: %s is no warm start file!\n", __func__, WARM_FILE);
+		return -EFILE_PARSING_ERROR;
+	}
+	pMap = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (pMap == MAP_FAILED)
+	{
+		OscLog(ERROR, "%s: Unable to map %s!\n", __func__, WARM_FILE);
+		return -EUNABLE_TO_OPEN_FILE;
+	}
+
+	err = WarmValidate(pMap, st.st_size);
+	if (err != SUCCESS)
+	{
+		munmap(pMap, st.st_size);
+		OscLog(WARN, "%s: %s does not match, starting cold.\n", __func__, WARM_FILE);
+		return err;
+	}
+
+	pHeader = (const struct WARM_HEADER*)pMap;
+	pImage = pMap + sizeof(struct WARM_HEADER);
+	/* DETECTBACKGROUND is set up for the level of the file. */
+	if (pHeader->nDetectLevel > 1)
+	{
+		ImgSetGeometry(&data, DETECTBACKGROUND, OSC_CAM_MAX_IMAGE_WIDTH >> pHeader->nDetectLevel, OSC_CAM_MAX_IMAGE_HEIGHT >> pHeader->nDetectLevel);
+	}
+	for (i = 0; i < 3; i++)
+	{
+		memcpy(ImgData(&data, warmImages[i]), pImage, pHeader->imageSize[i]);
+		pImage += pHeader->imageSize[i];
+	}
+	data.ipc.state.nExposureTime = pHeader->nExposureTime;
+	data.ipc.state.bAutoExposure = pHeader->bAutoExposure;
+	data.ipc.state.nShutterWidth = pHeader->nShutterWidth;
+	data.ipc.state.nThreshold = pHeader->nThreshold;
+	data.ipc.state.nDetectLevel = pHeader->nDetectLevel;
+	data.ipc.state.nMorphOp = pHeader->nMorphOp;
+	data.ipc.state.nMinArea = pHeader->nMinArea;
+	data.ipc.state.nEjectDistance = pHeader->nEjectDistance;
+	data.nExposureTimeChanged = true;
+	data.bWarmBackground = TRUE;
+	data.bWarmStarted = TRUE;
+
+	OscLog(INFO, "%s: Background of step %u restored.\n", __func__, (unsigned int)pHeader->nStepCounter);
+	munmap(pMap, st.st_size);
+	return SUCCESS;
+}
+
+void WarmStartUpdate()
+{
+	const int level = data.ipc.state.nDetectLevel;
+	struct WARM_HEADER *pHeader = &staging.header;
+	uint8 *pImage = staging.payload;
+	int i;
+
+	if (!warm.bStarted || data.ipc.state.nStepCounter < warm.nNextStep)
+	{
+		return;
+	}
+	/* Only a background in use and taken with the current shutter width
+	 * and detection level is worth saving. */
+	if (data.bRebaseBackground || data.nExposureSettle > 0 || data.nExposureTimeChanged ||
+			data.bWarmBackground ||
+			(level > 1 && ImgDesc(&data, DETECTBACKGROUND)->width != (OSC_CAM_MAX_IMAGE_WIDTH >> level)))
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&warm.mutex);
+	if (warm.bBusy)
+	{
+		pthread_mutex_unlock(&warm.mutex);
+		return;
+	}
+	pthread_mutex_unlock(&warm.mutex);
+
+	memset(pHeader, 0, sizeof(struct WARM_HEADER));
+	pHeader->magic = WARM_MAGIC;
+	pHeader->version = WARM_VERSION;
+	pHeader->format = WARM_FORMAT;
+	pHeader->width = OSC_CAM_MAX_IMAGE_WIDTH;
+	pHeader->height = OSC_CAM_MAX_IMAGE_HEIGHT;
+	pHeader->nStepCounter = data.ipc.state.nStepCounter;
+	pHeader->nExposureTime = data.ipc.state.nExposureTime;
+	pHeader->bAutoExposure = data.ipc.state.bAutoExposure;
+	pHeader->nShutterWidth = data.ipc.state.nShutterWidth;
+	pHeader->nThreshold = data.ipc.state.nThreshold;
+	pHeader->nDetectLevel = level;
+	pHeader->nMorphOp = data.ipc.state.nMorphOp;
+	pHeader->nMinArea = data.ipc.state.nMinArea;
+	pHeader->nEjectDistance = data.ipc.state.nEjectDistance;
+	for (i = 0; i < 3; i++)
+	{
+		pHeader->imageSize[i] = WarmImageSize(warmImages[i], level);
+		memcpy(pImage, ImgData(&data, warmImages[i]), pHeader->imageSize[i]);
+		pImage += pHeader->imageSize[i];
+	}
+
+	pthread_mutex_lock(&warm.mutex);
+	warm.bBusy = TRUE;
+	warm.nNextStep = data.ipc.state.nStepCounter + WARM_SAVE_STEPS;
+	pthread_cond_signal(&warm.cond);
+	pthread_mutex_unlock(&warm.mutex);
+}
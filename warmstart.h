@@ -0,0 +1,102 @@
+/* Copying and distribution of this file, with or without modification,
+ * are permitted in any medium without royalty. This file is offered as-is,
+ * without any warranty.
+ */
+
+/*! @file warmstart.h
+ * @brief Warm start of the camera lane from the background and the
+ * parameters of the last run.
+ *
+ * While the line runs, the background images, the shutter width and the
+ * detection parameters are saved every WARM_SAVE_PERIOD_S seconds by a
+ * thread of its own. At start-up a valid file is mapped and restored, so
+ * the first frame is compared with the saved background instead of
+ * becoming the background itself.
+ *
+ * The file consists of a struct WARM_HEADER followed by the images
+ * BACKGROUND, DETECTBACKGROUND and LUMABACKGROUND as they are stored in
+ * the pool. It is written to a temporary file first and renamed, so an
+ * interrupted save leaves the last one intact. A replayed archive
+ * neither reads nor writes it.
+ */
+#ifndef WARMSTART_H_
+#define WARMSTART_H_
+
+#include "template.h"
+
+/*! @brief The file, next to the recordings of the black box (c.f.
+ * REC_FILE_PREFIX), independent of the directory the application is
+ * started from. */
+#define WARM_FILE "/tmp/warmstart.bin"
+/*! @brief Seconds of the line between two saves (each save rewrites the
+ * whole file). */
+#define WARM_SAVE_PERIOD_S 300
+/*! @brief Identifies the file. */
+#define WARM_MAGIC 0x4d524157 /* "WARM" */
+/*! @brief Version of the layout of the file. */
+#define WARM_VERSION 2
+/*! @brief The settings the images are stored with; a file of another
+ * build is not used. */
+#define WARM_FORMAT (NUM_COLORS | (PLANAR_COLORS << 4) | (LAZY_COLORS << 5))
+
+/*! @brief Header of the file. */
+struct WARM_HEADER
+{
+	/*! @brief WARM_MAGIC. */
+	uint32 magic;
+	/*! @brief WARM_VERSION. */
+	uint16 version;
+	/*! @brief WARM_FORMAT. */
+	uint16 format;
+	/*! @brief Width of the raw frames. */
+	uint16 width;
+	/*! @brief Height of the raw frames. */
+	uint16 height;
+	/*! @brief FNV-1a hash of the header, with this member 0, and the
+	 * images. */
+	uint32 checksum;
+	/*! @brief Step counter at the save. */
+	uint32 nStepCounter;
+	/*! @brief Parameters of the application state. */
+	int32 nExposureTime;
+	int32 bAutoExposure;
+	int32 nShutterWidth;
+	int32 nThreshold;
+	int32 nDetectLevel;
+	int32 nMorphOp;
+	int32 nMinArea;
+	int32 nEjectDistance;
+	/*! @brief Bytes of BACKGROUND, DETECTBACKGROUND and LUMABACKGROUND;
+	 * 0 for an image not in use. */
+	uint32 imageSize[3];
+};
+
+/*********************************************************************//*!
+ * @brief Start the thread writing the file.
+ *
+ * @return SUCCESS or an appropriate error code.
+ *//*********************************************************************/
+OSC_ERR WarmStartInit();
+
+/*********************************************************************//*!
+ * @brief Restore the parameters and the background of the camera lane
+ * from the file, if there is a valid one.
+ *
+ * Called once the application state is set up with its defaults.
+ *
+ * @return SUCCESS, -EUNABLE_TO_OPEN_FILE without a file or
+ * -EFILE_PARSING_ERROR for a file that is not valid for this build or
+ * holds parameters out of range; nothing is changed then.
+ *//*********************************************************************/
+OSC_ERR WarmStartLoad();
+
+/*********************************************************************//*!
+ * @brief Hand the state to the writer thread if a save is due.
+ *
+ * Called after each processed frame of the camera lane; a background
+ * about to be replaced or taken with a shutter width not yet settled is
+ * not saved.
+ *//*********************************************************************/
+void WarmStartUpdate();
+
+#endif /*WARMSTART_H_*/